@@ -0,0 +1,186 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+
+/*
+    Sonic Visualiser
+    An audio file viewer and annotation editor.
+    Centre for Digital Music, Queen Mary, University of London.
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation; either version 2 of the
+    License, or (at your option) any later version.  See the file
+    COPYING included with this distribution for more information.
+*/
+
+#include "CacheBudget.h"
+
+#include "Debug.h"
+
+#include "system/System.h"
+
+#include <QMutexLocker>
+
+#include <algorithm>
+#include <chrono>
+
+std::atomic<unsigned long long>
+BudgetedCache::m_clock(0);
+
+CacheBudget *
+CacheBudget::m_instance = new CacheBudget;
+
+CacheBudget *
+CacheBudget::getInstance()
+{
+    return m_instance;
+}
+
+CacheBudget::CacheBudget() :
+    m_limit(0),
+    m_released(0),
+    m_lastCheck(0)
+{
+}
+
+void
+CacheBudget::setLimit(size_t bytes)
+{
+    m_limit = bytes;
+}
+
+size_t
+CacheBudget::getLimit() const
+{
+    return m_limit;
+}
+
+void
+CacheBudget::registerCache(BudgetedCache *cache)
+{
+    QMutexLocker locker(&m_mutex);
+    m_caches.push_back(cache);
+}
+
+void
+CacheBudget::unregisterCache(BudgetedCache *cache)
+{
+    QMutexLocker locker(&m_mutex);
+    m_caches.erase(std::remove(m_caches.begin(), m_caches.end(), cache),
+                   m_caches.end());
+    while (std::find(m_busy.begin(), m_busy.end(), cache) != m_busy.end()) {
+        m_relinquished.wait(&m_mutex);
+    }
+}
+
+bool
+CacheBudget::acquire(BudgetedCache *cache) const
+{
+    QMutexLocker locker(&m_mutex);
+    if (std::find(m_caches.begin(), m_caches.end(), cache) == m_caches.end()) {
+        return false;
+    }
+    m_busy.push_back(cache);
+    return true;
+}
+
+void
+CacheBudget::relinquish(BudgetedCache *cache) const
+{
+    QMutexLocker locker(&m_mutex);
+    m_busy.erase(std::find(m_busy.begin(), m_busy.end(), cache));
+    m_relinquished.wakeAll();
+}
+
+std::vector<BudgetedCache *>
+CacheBudget::getCachesByAge() const
+{
+    // The last-used times go on changing as other threads use the
+    // caches, so sort on a copy of them rather than the live values
+    std::vector<std::pair<unsigned long long, BudgetedCache *>> aged;
+    {
+        QMutexLocker locker(&m_mutex);
+        for (BudgetedCache *cache : m_caches) {
+            aged.push_back({ cache->getLastUsed(), cache });
+        }
+    }
+
+    std::stable_sort(aged.begin(), aged.end(),
+                     [](const std::pair<unsigned long long, BudgetedCache *> &a,
+                        const std::pair<unsigned long long, BudgetedCache *> &b) {
+                         return a.first < b.first;
+                     });
+
+    std::vector<BudgetedCache *> caches;
+    for (const auto &a : aged) caches.push_back(a.second);
+    return caches;
+}
+
+size_t
+CacheBudget::getCacheTotal() const
+{
+    size_t total = 0;
+    for (BudgetedCache *cache : getCachesByAge()) {
+        if (!acquire(cache)) continue;
+        total += cache->getEvictableSize();
+        relinquish(cache);
+    }
+    return total;
+}
+
+size_t
+CacheBudget::release(size_t bytes)
+{
+    size_t released = 0;
+    for (BudgetedCache *cache : getCachesByAge()) {
+        if (released >= bytes) break;
+        if (!acquire(cache)) continue; // unregistered since
+        if (cache->getEvictableSize() > 0) {
+            released += cache->evict(bytes - released);
+        }
+        relinquish(cache);
+    }
+
+    m_released += released;
+
+    SVDEBUG << "CacheBudget::release: asked for " << bytes
+            << " bytes, released " << released << endl;
+
+    return released;
+}
+
+size_t
+CacheBudget::enforce()
+{
+    size_t limit = m_limit;
+    if (limit == 0) return 0;
+
+    size_t used = 0;
+    ssize_t mb = GetProcessMemoryMBUsed();
+    if (mb >= 0) {
+        used = size_t(mb) * 1048576;
+    } else {
+        used = getCacheTotal();
+    }
+
+    if (used <= limit) return 0;
+    return release(used - limit);
+}
+
+void
+CacheBudget::check()
+{
+    if (m_limit == 0) return;
+
+    const long long interval = 1000;
+
+    long long now = std::chrono::duration_cast<std::chrono::milliseconds>
+        (std::chrono::steady_clock::now().time_since_epoch()).count();
+
+    long long last = m_lastCheck;
+    if (now - last < interval) return;
+
+    // Only one thread gets to enforce per interval
+    if (!m_lastCheck.compare_exchange_strong(last, now)) return;
+
+    enforce();
+}
@@ -0,0 +1,162 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+
+/*
+    Sonic Visualiser
+    An audio file viewer and annotation editor.
+    Centre for Digital Music, Queen Mary, University of London.
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation; either version 2 of the
+    License, or (at your option) any later version.  See the file
+    COPYING included with this distribution for more information.
+*/
+
+#ifndef SV_CACHE_BUDGET_H
+#define SV_CACHE_BUDGET_H
+
+#include <QMutex>
+#include <QWaitCondition>
+
+#include <atomic>
+#include <vector>
+#include <cstddef>
+
+/**
+ * A cache that can give memory back when asked, by discarding data
+ * that can be recalculated or by moving it to disc. Register it with
+ * CacheBudget once constructed, and unregister it before destruction.
+ */
+class BudgetedCache
+{
+public:
+    BudgetedCache() : m_lastUsed(0) { }
+    virtual ~BudgetedCache() { }
+
+    /**
+     * Return the number of bytes of memory that evict() could
+     * release.
+     */
+    virtual size_t getEvictableSize() const = 0;
+
+    /**
+     * Release at least the given number of bytes if possible, and
+     * return the number actually released. This is called from
+     * whichever thread is enforcing the budget, so it must take the
+     * same locks as the cache's own accessors.
+     */
+    virtual size_t evict(size_t bytes) = 0;
+
+    /**
+     * Note that the cache has just been used. Caches are asked to
+     * release memory in order from the least recently used.
+     */
+    void markUsed() const {
+        m_lastUsed.store(m_clock.fetch_add(1, std::memory_order_relaxed) + 1,
+                         std::memory_order_relaxed);
+    }
+
+    unsigned long long getLastUsed() const {
+        return m_lastUsed.load(std::memory_order_relaxed);
+    }
+
+private:
+    mutable std::atomic<unsigned long long> m_lastUsed;
+    static std::atomic<unsigned long long> m_clock;
+};
+
+/**
+ * Keeps the memory used by the process within a limit, by asking
+ * registered caches to release memory when it is exceeded. Unlike
+ * StorageAdviser, which advises once at allocation time, this can
+ * reclaim memory from caches that have since fallen out of use.
+ *
+ * Caches are asked in order from the least recently used. Memory is
+ * measured as the process's resident set size, where the system can
+ * tell us that, and otherwise as the total of the registered caches.
+ *
+ * The budget's lock is never held while a cache's own methods are
+ * called, so a cache may call back into the budget from them, and
+ * the methods here may be called with a cache's lock held.
+ *
+ * This class is thread safe.
+ */
+class CacheBudget
+{
+public:
+    static CacheBudget *getInstance();
+
+    /**
+     * Set the limit in bytes. Zero, the default, means no limit.
+     */
+    void setLimit(size_t bytes);
+    size_t getLimit() const;
+
+    void registerCache(BudgetedCache *cache);
+
+    /**
+     * Unregister a cache. If it is being asked to release memory,
+     * wait for it to finish first.
+     */
+    void unregisterCache(BudgetedCache *cache);
+
+    /**
+     * Return the total of getEvictableSize() for all registered
+     * caches.
+     */
+    size_t getCacheTotal() const;
+
+    /**
+     * Ask caches to release at least the given number of bytes, from
+     * the least recently used, and return the number released.
+     */
+    size_t release(size_t bytes);
+
+    /**
+     * If the memory in use exceeds the limit, release the excess, and
+     * return the number of bytes released.
+     */
+    size_t enforce();
+
+    /**
+     * Call enforce() if it has not been called in the last second.
+     * This is cheap otherwise, so caches may call it whenever they
+     * grow. Memory freed by a cache may not leave the resident set at
+     * once, and the interval avoids asking for it again meanwhile.
+     */
+    void check();
+
+    /**
+     * Return the number of bytes released since the program started.
+     */
+    size_t getReleasedTotal() const { return m_released; }
+
+private:
+    CacheBudget();
+
+    mutable QMutex m_mutex;
+    std::vector<BudgetedCache *> m_caches;
+
+    // Caches whose methods are being called outside the lock, once
+    // for each call in progress. unregisterCache waits on
+    // m_relinquished until the cache being removed is not among them
+    mutable std::vector<BudgetedCache *> m_busy;
+    mutable QWaitCondition m_relinquished;
+
+    // Return a snapshot of the registered caches, in order from the
+    // least recently used
+    std::vector<BudgetedCache *> getCachesByAge() const;
+
+    // Mark a cache as busy, returning false if it is no longer
+    // registered. Call relinquish once done with it
+    bool acquire(BudgetedCache *cache) const;
+    void relinquish(BudgetedCache *cache) const;
+
+    std::atomic<size_t> m_limit;
+    std::atomic<size_t> m_released;
+    std::atomic<long long> m_lastCheck; // ms since the clock's epoch
+
+    static CacheBudget *m_instance;
+};
+
+#endif
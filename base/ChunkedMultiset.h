@@ -0,0 +1,421 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+
+/*
+    Sonic Visualiser
+    An audio file viewer and annotation editor.
+    Centre for Digital Music, Queen Mary, University of London.
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation; either version 2 of the
+    License, or (at your option) any later version.  See the file
+    COPYING included with this distribution for more information.
+*/
+
+#ifndef SV_CHUNKED_MULTISET_H
+#define SV_CHUNKED_MULTISET_H
+
+#include <vector>
+#include <iterator>
+#include <algorithm>
+#include <functional>
+#include <cstddef>
+
+/**
+ * A sorted container with the ordering and lookup semantics of
+ * std::multiset, storing its elements in contiguous chunks of up to
+ * chunkSize elements instead of one heap node per element. Iterating
+ * over it or looking up a range touches far fewer cache lines than
+ * with std::multiset, and it takes less memory.
+ *
+ * As with std::multiset, elements are ordered by the comparator and
+ * equivalent elements are kept in order of insertion; elements are
+ * immutable through iterators; and insert, erase, find, lower_bound,
+ * upper_bound and equal_range take logarithmic time, except that
+ * inserting or erasing also moves up to chunkSize elements within a
+ * chunk. Appending an element that sorts at or after the end is the
+ * fast case, taking constant time.
+ *
+ * Unlike std::multiset, inserting or erasing an element invalidates
+ * all iterators. Code that modifies the container while iterating
+ * must use the iterator returned from insert or erase.
+ *
+ * The container also supports lookup by position: nth() returns an
+ * iterator to the element at a given index in order, and rank()
+ * returns the index of the element at an iterator. Both take
+ * logarithmic time, using a table of chunk sizes that insertions and
+ * erasures keep up to date. They only read the table, so like the
+ * other const lookups they may be called concurrently with one
+ * another.
+ */
+template <typename T, typename Compare = std::less<T>,
+          int chunkSize = 512>
+class ChunkedMultiset
+{
+    typedef std::vector<T> Chunk;
+
+public:
+    typedef T key_type;
+    typedef T value_type;
+    typedef Compare key_compare;
+    typedef Compare value_compare;
+    typedef size_t size_type;
+    typedef ptrdiff_t difference_type;
+    typedef const T &reference;
+    typedef const T &const_reference;
+    typedef const T *pointer;
+    typedef const T *const_pointer;
+
+    class const_iterator
+    {
+    public:
+        typedef std::bidirectional_iterator_tag iterator_category;
+        typedef T value_type;
+        typedef ptrdiff_t difference_type;
+        typedef const T *pointer;
+        typedef const T &reference;
+
+        const_iterator() : m_chunks(0), m_chunk(0), m_index(0) { }
+
+        reference operator*() const {
+            return (*m_chunks)[m_chunk][m_index];
+        }
+        pointer operator->() const {
+            return &(*m_chunks)[m_chunk][m_index];
+        }
+
+        const_iterator &operator++() {
+            if (++m_index == (*m_chunks)[m_chunk].size()) {
+                ++m_chunk;
+                m_index = 0;
+            }
+            return *this;
+        }
+        const_iterator operator++(int) {
+            const_iterator i(*this);
+            ++*this;
+            return i;
+        }
+
+        const_iterator &operator--() {
+            if (m_index == 0) {
+                --m_chunk;
+                m_index = (*m_chunks)[m_chunk].size() - 1;
+            } else {
+                --m_index;
+            }
+            return *this;
+        }
+        const_iterator operator--(int) {
+            const_iterator i(*this);
+            --*this;
+            return i;
+        }
+
+        bool operator==(const const_iterator &i) const {
+            return m_chunk == i.m_chunk && m_index == i.m_index;
+        }
+        bool operator!=(const const_iterator &i) const {
+            return !(*this == i);
+        }
+
+    private:
+        friend class ChunkedMultiset;
+        const_iterator(const std::vector<Chunk> *chunks,
+                       size_t chunk, size_t index) :
+            m_chunks(chunks), m_chunk(chunk), m_index(index) { }
+
+        // The end iterator has m_chunk == number of chunks and
+        // m_index == 0; no chunk is ever empty
+        const std::vector<Chunk> *m_chunks;
+        size_t m_chunk;
+        size_t m_index;
+    };
+
+    typedef const_iterator iterator;
+    typedef std::reverse_iterator<const_iterator> const_reverse_iterator;
+    typedef const_reverse_iterator reverse_iterator;
+
+    ChunkedMultiset() : m_size(0), m_counts(1, 0) { }
+
+    template <typename I>
+    ChunkedMultiset(I first, I last) : m_size(0), m_counts(1, 0) {
+        insert(first, last);
+    }
+
+    const_iterator begin() const { return make(0, 0); }
+    const_iterator end() const { return make(m_chunks.size(), 0); }
+    const_iterator cbegin() const { return begin(); }
+    const_iterator cend() const { return end(); }
+    const_reverse_iterator rbegin() const {
+        return const_reverse_iterator(end());
+    }
+    const_reverse_iterator rend() const {
+        return const_reverse_iterator(begin());
+    }
+
+    bool empty() const { return m_size == 0; }
+    size_t size() const { return m_size; }
+
+    void clear() {
+        m_chunks.clear();
+        m_size = 0;
+        m_counts.assign(1, 0);
+    }
+
+    void swap(ChunkedMultiset &other) {
+        m_chunks.swap(other.m_chunks);
+        std::swap(m_size, other.m_size);
+        std::swap(m_compare, other.m_compare);
+        m_counts.swap(other.m_counts);
+    }
+
+    key_compare key_comp() const { return m_compare; }
+    value_compare value_comp() const { return m_compare; }
+
+    /**
+     * Insert a value after any equivalent values already present,
+     * and return an iterator pointing to it.
+     */
+    iterator insert(const T &value) {
+
+        if (m_chunks.empty() || !m_compare(value, m_chunks.back().back())) {
+            // Append, the common case when loading sorted data. Fill
+            // each chunk entirely, as it is unlikely to be split
+            if (m_chunks.empty() || m_chunks.back().size() >= size_t(chunkSize)) {
+                m_chunks.push_back(Chunk());
+                m_chunks.back().reserve(chunkSize);
+                m_chunks.back().push_back(value);
+                appendCount();
+            } else {
+                m_chunks.back().push_back(value);
+                adjustCount(m_chunks.size() - 1, true);
+            }
+            ++m_size;
+            return make(m_chunks.size() - 1, m_chunks.back().size() - 1);
+        }
+
+        size_t c = findChunkUpper(value);
+        Chunk &chunk = m_chunks[c];
+        size_t index = std::upper_bound(chunk.begin(), chunk.end(),
+                                        value, m_compare) - chunk.begin();
+        chunk.insert(chunk.begin() + index, value);
+        ++m_size;
+
+        if (chunk.size() > size_t(chunkSize)) {
+            // Split in half, leaving room in each for more
+            size_t half = chunk.size() / 2;
+            Chunk upper(chunk.begin() + half, chunk.end());
+            chunk.erase(chunk.begin() + half, chunk.end());
+            m_chunks.insert(m_chunks.begin() + c + 1, std::move(upper));
+            rebuildCounts();
+            if (index >= half) {
+                return make(c + 1, index - half);
+            }
+        } else {
+            adjustCount(c, true);
+        }
+
+        return make(c, index);
+    }
+
+    iterator insert(const_iterator, const T &value) {
+        return insert(value);
+    }
+
+    template <typename I>
+    void insert(I first, I last) {
+        for (I i = first; i != last; ++i) insert(*i);
+    }
+
+    /**
+     * Erase the element at the given iterator, and return an iterator
+     * pointing to the element that followed it.
+     */
+    iterator erase(const_iterator i) {
+        Chunk &chunk = m_chunks[i.m_chunk];
+        chunk.erase(chunk.begin() + i.m_index);
+        --m_size;
+        if (chunk.empty()) {
+            m_chunks.erase(m_chunks.begin() + i.m_chunk);
+            rebuildCounts();
+            return make(i.m_chunk, 0);
+        }
+        adjustCount(i.m_chunk, false);
+        if (i.m_index == chunk.size()) {
+            return make(i.m_chunk + 1, 0);
+        }
+        return i;
+    }
+
+    /**
+     * Erase all elements equivalent to the given value, and return
+     * the number erased.
+     */
+    size_t erase(const T &value) {
+        size_t n = 0;
+        const_iterator i = lower_bound(value);
+        while (i != end() && !m_compare(value, *i)) {
+            i = erase(i);
+            ++n;
+        }
+        return n;
+    }
+
+    const_iterator lower_bound(const T &value) const {
+        size_t c = findChunkLower(value);
+        if (c == m_chunks.size()) return end();
+        const Chunk &chunk = m_chunks[c];
+        return make(c, std::lower_bound(chunk.begin(), chunk.end(),
+                                        value, m_compare) - chunk.begin());
+    }
+
+    const_iterator upper_bound(const T &value) const {
+        size_t c = findChunkUpper(value);
+        if (c == m_chunks.size()) return end();
+        const Chunk &chunk = m_chunks[c];
+        return make(c, std::upper_bound(chunk.begin(), chunk.end(),
+                                        value, m_compare) - chunk.begin());
+    }
+
+    std::pair<const_iterator, const_iterator>
+    equal_range(const T &value) const {
+        return std::pair<const_iterator, const_iterator>
+            (lower_bound(value), upper_bound(value));
+    }
+
+    const_iterator find(const T &value) const {
+        const_iterator i = lower_bound(value);
+        if (i != end() && !m_compare(value, *i)) return i;
+        return end();
+    }
+
+    size_t count(const T &value) const {
+        size_t n = 0;
+        for (const_iterator i = lower_bound(value);
+             i != end() && !m_compare(value, *i); ++i) {
+            ++n;
+        }
+        return n;
+    }
+
+    /**
+     * Return an iterator pointing to the element with n elements
+     * before it, or end() if n is not less than size().
+     */
+    const_iterator nth(size_t n) const {
+        if (n >= m_size) return end();
+        // Descend the Fenwick tree to find the last chunk whose
+        // preceding chunks together hold no more than n elements
+        size_t c = 0;
+        size_t step = 1;
+        while (step * 2 <= m_chunks.size()) step *= 2;
+        for (; step > 0; step /= 2) {
+            if (c + step <= m_chunks.size() && m_counts[c + step] <= n) {
+                c += step;
+                n -= m_counts[c];
+            }
+        }
+        return make(c, n);
+    }
+
+    /**
+     * Return the number of elements before the given iterator, which
+     * is size() for end().
+     */
+    size_t rank(const_iterator i) const {
+        if (i.m_chunk >= m_chunks.size()) return m_size;
+        size_t n = i.m_index;
+        for (size_t c = i.m_chunk; c > 0; c &= c - 1) {
+            n += m_counts[c];
+        }
+        return n;
+    }
+
+    /**
+     * Return the number of chunks, for testing and diagnostics.
+     */
+    size_t getChunkCount() const { return m_chunks.size(); }
+
+    /**
+     * Return the number of bytes allocated for the elements and the
+     * table of chunk sizes, not counting the container itself.
+     */
+    size_t getMemoryUsage() const {
+        size_t bytes = m_chunks.capacity() * sizeof(Chunk);
+        for (const Chunk &chunk : m_chunks) {
+            bytes += chunk.capacity() * sizeof(T);
+        }
+        bytes += m_counts.capacity() * sizeof(size_t);
+        return bytes;
+    }
+
+private:
+    const_iterator make(size_t chunk, size_t index) const {
+        return const_iterator(&m_chunks, chunk, index);
+    }
+
+    // Index of the first chunk whose last element is not less than
+    // value, or the number of chunks if there is none
+    size_t findChunkLower(const T &value) const {
+        size_t lo = 0, hi = m_chunks.size();
+        while (lo < hi) {
+            size_t mid = (lo + hi) / 2;
+            if (m_compare(m_chunks[mid].back(), value)) lo = mid + 1;
+            else hi = mid;
+        }
+        return lo;
+    }
+
+    // Index of the first chunk whose last element is greater than
+    // value, or the number of chunks if there is none
+    size_t findChunkUpper(const T &value) const {
+        size_t lo = 0, hi = m_chunks.size();
+        while (lo < hi) {
+            size_t mid = (lo + hi) / 2;
+            if (!m_compare(value, m_chunks[mid].back())) lo = mid + 1;
+            else hi = mid;
+        }
+        return lo;
+    }
+
+    // Fenwick tree of chunk sizes, indexed from 1, used by nth and
+    // rank. It always has one more entry than there are chunks. It
+    // is rebuilt when a chunk is split or removed, which is rare, and
+    // extended in logarithmic time when a chunk is appended
+    void rebuildCounts() {
+        size_t n = m_chunks.size();
+        m_counts.assign(n + 1, 0);
+        for (size_t c = 1; c <= n; ++c) {
+            m_counts[c] += m_chunks[c-1].size();
+            size_t parent = c + (c & (0 - c));
+            if (parent <= n) m_counts[parent] += m_counts[c];
+        }
+    }
+
+    void appendCount() {
+        // The new entry covers the chunks after n - lowbit(n) up to
+        // and including the new one, which are the new chunk plus
+        // the entries that descend from it
+        size_t n = m_chunks.size();
+        size_t count = m_chunks.back().size();
+        for (size_t c = n - 1; c > n - (n & (0 - n)); c &= c - 1) {
+            count += m_counts[c];
+        }
+        m_counts.push_back(count);
+    }
+
+    void adjustCount(size_t chunk, bool increment) {
+        for (size_t c = chunk + 1; c < m_counts.size(); c += (c & (0 - c))) {
+            if (increment) ++m_counts[c];
+            else --m_counts[c];
+        }
+    }
+
+    std::vector<Chunk> m_chunks;
+    size_t m_size;
+    Compare m_compare;
+    std::vector<size_t> m_counts;
+};
+
+#endif
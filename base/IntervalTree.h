@@ -0,0 +1,199 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+
+/*
+    Sonic Visualiser
+    An audio file viewer and annotation editor.
+    Centre for Digital Music, Queen Mary, University of London.
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation; either version 2 of the
+    License, or (at your option) any later version.  See the file
+    COPYING included with this distribution for more information.
+*/
+
+#ifndef SV_INTERVAL_TREE_H
+#define SV_INTERVAL_TREE_H
+
+#include <cstddef>
+
+/**
+ * A collection of closed intervals [start, end], which may overlap or
+ * be duplicated, that can quickly find all intervals overlapping a
+ * given one.
+ *
+ * This is a binary search tree ordered by start and then end, kept
+ * balanced in expectation as a treap, in which each node also records
+ * the greatest end of any interval in its subtree. Insert and erase
+ * take O(log n) time, and visitOverlapping takes O((k + 1) log n) for
+ * k intervals found, however long the intervals are.
+ *
+ * T must be copyable and ordered by operator<.
+ */
+template <typename T>
+class IntervalTree
+{
+public:
+    IntervalTree() : m_root(0), m_size(0), m_seed(1) { }
+    ~IntervalTree() { destroy(m_root); }
+
+    size_t size() const { return m_size; }
+    bool empty() const { return m_size == 0; }
+
+    /**
+     * Return the number of bytes allocated for the intervals, not
+     * counting the tree object itself.
+     */
+    size_t getMemoryUsage() const { return m_size * sizeof(Node); }
+
+    void clear() {
+        destroy(m_root);
+        m_root = 0;
+        m_size = 0;
+    }
+
+    /**
+     * Add the interval [start, end].
+     */
+    void insert(const T &start, const T &end) {
+        m_seed = m_seed * 1103515245u + 12345u;
+        Node *node = new Node(start, end, m_seed);
+        m_root = insert(m_root, node);
+        ++m_size;
+    }
+
+    /**
+     * Remove one interval equal to [start, end], if there is one, and
+     * return true if one was found.
+     */
+    bool erase(const T &start, const T &end) {
+        bool found = false;
+        m_root = erase(m_root, start, end, found);
+        if (found) --m_size;
+        return found;
+    }
+
+    /**
+     * Call f(start, end) for every interval that overlaps [from, to],
+     * i.e. that has start <= to and end >= from, in order of start
+     * and then end.
+     */
+    template <typename F>
+    void visitOverlapping(const T &from, const T &to, F f) const {
+        visit(m_root, from, to, f);
+    }
+
+private:
+    IntervalTree(const IntervalTree &); // not implemented
+    IntervalTree &operator=(const IntervalTree &); // not implemented
+
+    struct Node {
+        Node(const T &s, const T &e, unsigned int p) :
+            start(s), end(e), maxEnd(e), priority(p), left(0), right(0) { }
+        T start;
+        T end;
+        T maxEnd; // greatest end in this subtree
+        unsigned int priority;
+        Node *left;
+        Node *right;
+    };
+
+    Node *m_root;
+    size_t m_size;
+    unsigned int m_seed;
+
+    static bool before(const T &s1, const T &e1, const T &s2, const T &e2) {
+        return s1 < s2 || (!(s2 < s1) && e1 < e2);
+    }
+
+    static void update(Node *n) {
+        n->maxEnd = n->end;
+        if (n->left && n->maxEnd < n->left->maxEnd) {
+            n->maxEnd = n->left->maxEnd;
+        }
+        if (n->right && n->maxEnd < n->right->maxEnd) {
+            n->maxEnd = n->right->maxEnd;
+        }
+    }
+
+    static Node *rotateRight(Node *n) {
+        Node *l = n->left;
+        n->left = l->right;
+        l->right = n;
+        update(n);
+        update(l);
+        return l;
+    }
+
+    static Node *rotateLeft(Node *n) {
+        Node *r = n->right;
+        n->right = r->left;
+        r->left = n;
+        update(n);
+        update(r);
+        return r;
+    }
+
+    static Node *insert(Node *n, Node *x) {
+        if (!n) return x;
+        if (before(x->start, x->end, n->start, n->end)) {
+            n->left = insert(n->left, x);
+            if (n->left->priority > n->priority) return rotateRight(n);
+        } else {
+            n->right = insert(n->right, x);
+            if (n->right->priority > n->priority) return rotateLeft(n);
+        }
+        update(n);
+        return n;
+    }
+
+    // Join two trees, where no interval in a is ordered after any
+    // interval in b
+    static Node *merge(Node *a, Node *b) {
+        if (!a) return b;
+        if (!b) return a;
+        if (a->priority > b->priority) {
+            a->right = merge(a->right, b);
+            update(a);
+            return a;
+        } else {
+            b->left = merge(a, b->left);
+            update(b);
+            return b;
+        }
+    }
+
+    static Node *erase(Node *n, const T &start, const T &end, bool &found) {
+        if (!n) return 0;
+        if (before(start, end, n->start, n->end)) {
+            n->left = erase(n->left, start, end, found);
+        } else if (before(n->start, n->end, start, end)) {
+            n->right = erase(n->right, start, end, found);
+        } else {
+            found = true;
+            Node *m = merge(n->left, n->right);
+            delete n;
+            return m;
+        }
+        update(n);
+        return n;
+    }
+
+    template <typename F>
+    static void visit(const Node *n, const T &from, const T &to, F &f) {
+        if (!n || n->maxEnd < from) return;
+        visit(n->left, from, to, f);
+        if (to < n->start) return; // as does everything to the right
+        if (!(n->end < from)) f(n->start, n->end);
+        visit(n->right, from, to, f);
+    }
+
+    static void destroy(Node *n) {
+        if (!n) return;
+        destroy(n->left);
+        destroy(n->right);
+        delete n;
+    }
+};
+
+#endif
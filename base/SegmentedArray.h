@@ -0,0 +1,152 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+
+/*
+    Sonic Visualiser
+    An audio file viewer and annotation editor.
+    Centre for Digital Music, Queen Mary, University of London.
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation; either version 2 of the
+    License, or (at your option) any later version.  See the file
+    COPYING included with this distribution for more information.
+*/
+
+#ifndef SV_SEGMENTED_ARRAY_H
+#define SV_SEGMENTED_ARRAY_H
+
+#include <atomic>
+#include <new>
+#include <cstddef>
+
+/**
+ * A growable array whose elements never move. It is made of segments
+ * of doubling size, found through a fixed table, so growing it only
+ * ever allocates a new segment and never copies or frees existing
+ * elements.
+ *
+ * This means one thread may append to the array while others read
+ * elements that were already present, without any locking: a reader
+ * that has learned (through some other synchronisation, such as an
+ * atomic counter published with release semantics) that an element
+ * exists may read it at any time, however the array grows meanwhile.
+ * Only one thread may modify the array at a time, and clear() must
+ * not be called while anyone else is reading.
+ *
+ * Element types need not be copyable, so an array of std::atomic
+ * values is possible, for elements that change after publication.
+ */
+template <typename T>
+class SegmentedArray
+{
+public:
+    SegmentedArray() : m_size(0) {
+        for (int i = 0; i < maxSegments; ++i) {
+            m_segments[i].store(0, std::memory_order_relaxed);
+        }
+    }
+
+    ~SegmentedArray() {
+        clear();
+    }
+
+    int size() const { return m_size.load(std::memory_order_acquire); }
+    bool empty() const { return size() == 0; }
+
+    T &operator[](int i) {
+        int offset;
+        int s = locate(i, offset);
+        return m_segments[s].load(std::memory_order_acquire)[offset];
+    }
+
+    const T &operator[](int i) const {
+        int offset;
+        int s = locate(i, offset);
+        return m_segments[s].load(std::memory_order_acquire)[offset];
+    }
+
+    /**
+     * Grow the array to n elements, initialising new elements from
+     * the given value. Does nothing if the array is already as large.
+     */
+    template <typename V>
+    void resize(int n, const V &value) {
+        int from = size();
+        for (int i = from; i < n; ++i) {
+            int offset;
+            int s = locate(i, offset);
+            T *segment = m_segments[s].load(std::memory_order_relaxed);
+            if (!segment) {
+                segment = static_cast<T *>
+                    (::operator new(sizeof(T) * size_t(segmentSize(s))));
+                m_segments[s].store(segment, std::memory_order_release);
+            }
+            new (segment + offset) T(value);
+        }
+        if (n > from) {
+            m_size.store(n, std::memory_order_release);
+        }
+    }
+
+    template <typename V>
+    void push_back(const V &value) {
+        resize(size() + 1, value);
+    }
+
+    void clear() {
+        int n = size();
+        for (int s = 0; s < maxSegments; ++s) {
+            T *segment = m_segments[s].load(std::memory_order_relaxed);
+            if (!segment) continue;
+            int first = segmentStart(s);
+            for (int i = first; i < n && i < first + segmentSize(s); ++i) {
+                segment[i - first].~T();
+            }
+            ::operator delete(segment);
+            m_segments[s].store(0, std::memory_order_relaxed);
+        }
+        m_size.store(0, std::memory_order_release);
+    }
+
+    /**
+     * Return the number of bytes allocated for elements.
+     */
+    size_t getAllocatedSize() const {
+        size_t total = 0;
+        for (int s = 0; s < maxSegments; ++s) {
+            if (m_segments[s].load(std::memory_order_relaxed)) {
+                total += sizeof(T) * size_t(segmentSize(s));
+            }
+        }
+        return total;
+    }
+
+private:
+    SegmentedArray(const SegmentedArray &); // not implemented
+    SegmentedArray &operator=(const SegmentedArray &); // not implemented
+
+    // Segment 0 holds the first 2^firstBits elements; segment s > 0
+    // holds the next 2^(firstBits+s-1)
+    enum { firstBits = 10, maxSegments = 32 - firstBits };
+
+    static int segmentSize(int s) {
+        return s == 0 ? (1 << firstBits) : (1 << (firstBits + s - 1));
+    }
+
+    static int segmentStart(int s) {
+        return s == 0 ? 0 : (1 << (firstBits + s - 1));
+    }
+
+    static int locate(int i, int &offset) {
+        unsigned int u = unsigned(i) >> firstBits;
+        int s = 0;
+        while (u) { ++s; u >>= 1; }
+        offset = i - segmentStart(s);
+        return s;
+    }
+
+    std::atomic<T *> m_segments[maxSegments];
+    std::atomic<int> m_size;
+};
+
+#endif
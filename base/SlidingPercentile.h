@@ -0,0 +1,111 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+
+/*
+    Sonic Visualiser
+    An audio file viewer and annotation editor.
+    Centre for Digital Music, Queen Mary, University of London.
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation; either version 2 of the
+    License, or (at your option) any later version.  See the file
+    COPYING included with this distribution for more information.
+*/
+
+#ifndef SV_SLIDING_PERCENTILE_H
+#define SV_SLIDING_PERCENTILE_H
+
+#include <deque>
+#include <set>
+#include <iterator>
+
+/**
+ * A sliding window of values supporting percentile (e.g. median)
+ * queries in O(log w) time for window size w. Values are pushed at
+ * the back and popped from the front, so the window may grow or
+ * shrink freely between queries, and the requested percentile may
+ * also change from one query to the next.
+ *
+ * This is a pair of ordered multisets split at the rank of the most
+ * recently requested percentile: all values in the lower set compare
+ * less than or equal to all values in the upper set, and a query
+ * moves values across the split until the lower set has the right
+ * size. As long as the rank changes little between queries (as when
+ * sliding along a spectrum) this costs only a few O(log w) moves per
+ * query, in place of sorting the whole window every time.
+ */
+template <typename T>
+class SlidingPercentile
+{
+public:
+    SlidingPercentile() { }
+
+    int size() const { return int(m_values.size()); }
+    bool empty() const { return m_values.empty(); }
+
+    void clear() {
+        m_values.clear();
+        m_lower.clear();
+        m_upper.clear();
+    }
+
+    /**
+     * Add a value at the back of the window.
+     */
+    void push(T value) {
+        m_values.push_back(value);
+        if (!m_lower.empty() && value < *m_lower.rbegin()) {
+            m_lower.insert(value);
+        } else {
+            m_upper.insert(value);
+        }
+    }
+
+    /**
+     * Remove the value at the front of the window (the least
+     * recently pushed one). The window must not be empty.
+     */
+    void pop() {
+        T value = m_values.front();
+        m_values.pop_front();
+        // Equal values are interchangeable, so it doesn't matter
+        // which set we remove one from if both contain it
+        auto i = m_lower.find(value);
+        if (i != m_lower.end()) {
+            m_lower.erase(i);
+        } else {
+            m_upper.erase(m_upper.find(value));
+        }
+    }
+
+    /**
+     * Return the value found at index int(size() * percentile) (0 <=
+     * percentile <= 1) in a sorted copy of the window. For a
+     * percentile of 1.0 the greatest value is returned. The window
+     * must not be empty.
+     */
+    T get(float percentile) {
+        int n = size();
+        int rank = int(float(n) * percentile);
+        if (rank >= n) rank = n - 1;
+        if (rank < 0) rank = 0;
+        while (int(m_lower.size()) > rank) {
+            auto i = std::prev(m_lower.end());
+            m_upper.insert(*i);
+            m_lower.erase(i);
+        }
+        while (int(m_lower.size()) < rank) {
+            auto i = m_upper.begin();
+            m_lower.insert(*i);
+            m_upper.erase(i);
+        }
+        return *m_upper.begin();
+    }
+
+private:
+    std::deque<T> m_values;
+    std::multiset<T> m_lower;
+    std::multiset<T> m_upper;
+};
+
+#endif
@@ -57,6 +57,7 @@ StorageAdviser::storageStatusToString(StorageStatus status)
     return "Unknown";
 }
 
+QMutex StorageAdviser::m_mutex;
 size_t StorageAdviser::m_discPlanned = 0;
 size_t StorageAdviser::m_memoryPlanned = 0;
 
@@ -119,19 +120,22 @@ StorageAdviser::recommend(Criteria criteria,
         }
     }
 
-    SVDEBUG << "StorageAdviser: disc planned: " << (m_discPlanned / 1024)
-            << "K, memory planned: " << (m_memoryPlanned / 1024) << "K" << endl;
+    size_t discPlanned = getPlannedAllocation(DiscAllocation);
+    size_t memoryPlanned = getPlannedAllocation(MemoryAllocation);
+
+    SVDEBUG << "StorageAdviser: disc planned: " << (discPlanned / 1024)
+            << "K, memory planned: " << (memoryPlanned / 1024) << "K" << endl;
     SVDEBUG << "StorageAdviser: min requested: " << minimumSize
             << "K, max requested: " << maximumSize << "K" << endl;
 
-    if (discFree > ssize_t(m_discPlanned / 1024 + 1)) {
-        discFree -= m_discPlanned / 1024 + 1;
+    if (discFree > ssize_t(discPlanned / 1024 + 1)) {
+        discFree -= discPlanned / 1024 + 1;
     } else if (discFree > 0) { // can also be -1 for unknown
         discFree = 0;
     }
 
-    if (memoryFree > ssize_t(m_memoryPlanned / 1024 + 1)) {
-        memoryFree -= m_memoryPlanned / 1024 + 1;
+    if (memoryFree > ssize_t(memoryPlanned / 1024 + 1)) {
+        memoryFree -= memoryPlanned / 1024 + 1;
     } else if (memoryFree > 0) { // can also be -1 for unknown
         memoryFree = 0;
     }
@@ -247,6 +251,7 @@ StorageAdviser::recommend(Criteria criteria,
 void
 StorageAdviser::notifyPlannedAllocation(AllocationArea area, size_t size)
 {
+    QMutexLocker locker(&m_mutex);
     if (area == MemoryAllocation) m_memoryPlanned += size;
     else if (area == DiscAllocation) m_discPlanned += size;
     SVDEBUG << "StorageAdviser: storage planned up: now memory: " << m_memoryPlanned << ", disc "
@@ -256,6 +261,7 @@ StorageAdviser::notifyPlannedAllocation(AllocationArea area, size_t size)
 void
 StorageAdviser::notifyDoneAllocation(AllocationArea area, size_t size)
 {
+    QMutexLocker locker(&m_mutex);
     if (area == MemoryAllocation) {
         if (m_memoryPlanned > size) m_memoryPlanned -= size;
         else m_memoryPlanned = 0;
@@ -267,6 +273,14 @@ StorageAdviser::notifyDoneAllocation(AllocationArea area, size_t size)
             << m_discPlanned << endl;
 }
 
+size_t
+StorageAdviser::getPlannedAllocation(AllocationArea area)
+{
+    QMutexLocker locker(&m_mutex);
+    if (area == MemoryAllocation) return m_memoryPlanned;
+    else return m_discPlanned;
+}
+
 void
 StorageAdviser::setFixedRecommendation(Recommendation recommendation)
 {
@@ -20,6 +20,7 @@
 #include <cstdlib>
 
 #include <QString>
+#include <QMutex>
 
 /**
  * A utility class designed to help decide whether to store cache data
@@ -82,6 +83,12 @@ public:
      */
     static void notifyDoneAllocation(AllocationArea area, size_t size);
 
+    /**
+     * Return the total amount (in kilobytes) of a storage area that
+     * has been notified as planned and not yet as done.
+     */
+    static size_t getPlannedAllocation(AllocationArea area);
+
     /**
      * Force all subsequent recommendations to use the (perhaps
      * partial) specification given here.  If NoRecommendation given
@@ -90,6 +97,7 @@ public:
     static void setFixedRecommendation(Recommendation recommendation);
 
 private:
+    static QMutex m_mutex; // guards the planned totals
     static size_t m_discPlanned;
     static size_t m_memoryPlanned;
     static Recommendation m_baseRecommendation;
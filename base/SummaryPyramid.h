@@ -0,0 +1,234 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+
+/*
+    Sonic Visualiser
+    An audio file viewer and annotation editor.
+    Centre for Digital Music, Queen Mary, University of London.
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation; either version 2 of the
+    License, or (at your option) any later version.  See the file
+    COPYING included with this distribution for more information.
+*/
+
+#ifndef SV_SUMMARY_PYRAMID_H
+#define SV_SUMMARY_PYRAMID_H
+
+#include "BaseTypes.h"
+
+#include <vector>
+
+/**
+ * Minimum, maximum, mean and count of the values found at frames in
+ * a series of buckets, at every power-of-two bucket width from a
+ * given base width upwards, kept up to date as values are added and
+ * removed.
+ *
+ * Adding a value takes O(log n) time for n buckets at the base
+ * width. Removing one also takes O(log n), unless it was the minimum
+ * or maximum of its base bucket, in which case the caller is asked
+ * for a fresh summary of that bucket. A query returns summaries at
+ * the widest width no wider than the resolution asked for, in time
+ * proportional to the number returned.
+ *
+ * Buckets are stored densely from frame zero. Values at negative
+ * frames are not summarised.
+ */
+class SummaryPyramid
+{
+public:
+    struct Summary {
+        Summary() :
+            frame(0), duration(0), count(0), min(0.f), max(0.f), sum(0.0) { }
+        sv_frame_t frame;
+        sv_frame_t duration;
+        int count;
+        float min;
+        float max;
+        double sum;
+        float getMean() const { return count > 0 ? float(sum / count) : 0.f; }
+    };
+
+    /**
+     * Construct a pyramid whose narrowest buckets are 2^baseShift
+     * frames wide.
+     */
+    SummaryPyramid(int baseShift) : m_baseShift(baseShift) { }
+
+    int getBaseShift() const { return m_baseShift; }
+    sv_frame_t getBaseWidth() const { return sv_frame_t(1) << m_baseShift; }
+    int getLevelCount() const { return int(m_levels.size()); }
+
+    /**
+     * Return the number of bytes allocated for the buckets, not
+     * counting the pyramid object itself.
+     */
+    size_t getMemoryUsage() const {
+        size_t bytes = m_levels.capacity() * sizeof(std::vector<Bucket>);
+        for (const auto &level : m_levels) {
+            bytes += level.capacity() * sizeof(Bucket);
+        }
+        return bytes;
+    }
+
+    void clear() {
+        m_levels.clear();
+    }
+
+    void add(sv_frame_t frame, float value) {
+        if (frame < 0) return;
+        size_t index = size_t(frame >> m_baseShift);
+        extend(index);
+        for (size_t level = 0; level < m_levels.size(); ++level) {
+            Bucket &b = m_levels[level][index];
+            if (b.count == 0 || value < b.min) b.min = value;
+            if (b.count == 0 || value > b.max) b.max = value;
+            b.sum += value;
+            ++b.count;
+            index >>= 1;
+        }
+    }
+
+    /**
+     * Remove a value previously added at the given frame. If it was
+     * the minimum or maximum of its bucket at the base width,
+     * summarise(start, end) is called and must return a Summary
+     * (with count, min, max and sum set) of the values that remain
+     * at frames in [start, end).
+     */
+    template <typename F>
+    void remove(sv_frame_t frame, float value, F summarise) {
+        if (frame < 0) return;
+        size_t index = size_t(frame >> m_baseShift);
+        if (m_levels.empty() || index >= m_levels[0].size()) return;
+
+        size_t i = index;
+        for (size_t level = 0; level < m_levels.size(); ++level) {
+            Bucket &b = m_levels[level][i];
+            --b.count;
+            b.sum -= value;
+            if (b.count <= 0) b = Bucket();
+            i >>= 1;
+        }
+
+        Bucket &base = m_levels[0][index];
+        if (base.count > 0) {
+            if (value != base.min && value != base.max) {
+                // No bucket's extents can have depended on this value
+                return;
+            }
+            sv_frame_t start = sv_frame_t(index) << m_baseShift;
+            Summary s = summarise(start, start + getBaseWidth());
+            base.count = s.count;
+            base.min = s.min;
+            base.max = s.max;
+            base.sum = s.sum;
+        }
+
+        for (size_t level = 1; level < m_levels.size(); ++level) {
+            index >>= 1;
+            Bucket &b = m_levels[level][index];
+            if (b.count == 0) continue;
+            const std::vector<Bucket> &below = m_levels[level-1];
+            bool have = false;
+            for (size_t c = index * 2; c < index * 2 + 2 && c < below.size(); ++c) {
+                if (below[c].count == 0) continue;
+                if (!have || below[c].min < b.min) b.min = below[c].min;
+                if (!have || below[c].max > b.max) b.max = below[c].max;
+                have = true;
+            }
+        }
+    }
+
+    /**
+     * Return summaries of consecutive buckets covering the frames in
+     * [start, end), using the widest buckets that are no wider than
+     * resolution frames, or the narrowest if resolution is smaller
+     * than the base width. Empty buckets are included, with a count
+     * of zero.
+     */
+    std::vector<Summary> getSummaries(sv_frame_t start, sv_frame_t end,
+                                      sv_frame_t resolution) const {
+        std::vector<Summary> summaries;
+        if (start < 0) start = 0;
+        if (end <= start) return summaries;
+
+        size_t level = 0;
+        while (level + 1 < m_levels.size() &&
+               (getBaseWidth() << (level + 1)) <= resolution) {
+            ++level;
+        }
+
+        int shift = m_baseShift + int(level);
+        sv_frame_t width = sv_frame_t(1) << shift;
+        size_t first = size_t(start >> shift);
+        size_t last = size_t((end - 1) >> shift);
+
+        summaries.reserve(last - first + 1);
+        for (size_t i = first; i <= last; ++i) {
+            Summary s;
+            s.frame = sv_frame_t(i) << shift;
+            s.duration = width;
+            if (level < m_levels.size() && i < m_levels[level].size()) {
+                const Bucket &b = m_levels[level][i];
+                s.count = b.count;
+                s.min = b.min;
+                s.max = b.max;
+                s.sum = b.sum;
+            }
+            summaries.push_back(s);
+        }
+        return summaries;
+    }
+
+private:
+    struct Bucket {
+        Bucket() : count(0), min(0.f), max(0.f), sum(0.0) { }
+        int count;
+        float min;
+        float max;
+        double sum;
+    };
+
+    int m_baseShift;
+
+    // m_levels[n] holds the buckets 2^(m_baseShift + n) frames wide.
+    // The last level always has a single bucket
+    std::vector<std::vector<Bucket> > m_levels;
+
+    static void merge(Bucket &b, const Bucket &from) {
+        if (from.count == 0) return;
+        if (b.count == 0 || from.min < b.min) b.min = from.min;
+        if (b.count == 0 || from.max > b.max) b.max = from.max;
+        b.sum += from.sum;
+        b.count += from.count;
+    }
+
+    void extend(size_t index) {
+        size_t level = 0;
+        while (true) {
+            if (level == m_levels.size()) {
+                // A new top level, which must summarise what is
+                // already in the level below
+                std::vector<Bucket> above;
+                if (level > 0) {
+                    const std::vector<Bucket> &below = m_levels[level-1];
+                    above.resize((below.size() + 1) / 2);
+                    for (size_t i = 0; i < below.size(); ++i) {
+                        merge(above[i / 2], below[i]);
+                    }
+                }
+                m_levels.push_back(above);
+            }
+            if (m_levels[level].size() <= index) {
+                m_levels[level].resize(index + 1);
+            }
+            if (index == 0 && level + 1 == m_levels.size()) break;
+            index >>= 1;
+            ++level;
+        }
+    }
+};
+
+#endif
@@ -21,6 +21,8 @@
 #include <string>
 #include <map>
 #include <cstdlib>
+#include <memory>
+#include <mutex>
 
 #include <bqvec/VectorOps.h>
 #include <bqvec/Allocators.h>
@@ -50,22 +52,22 @@ public:
      * than symmetrical. (A window of size N is equivalent to a
      * symmetrical window of size N+1 with the final element missing.)
      */
-    Window(WindowType type, int size) : m_type(type), m_size(size), m_cache(0) {
+    Window(WindowType type, int size) : m_type(type), m_size(size) {
         encache();
     }
-    Window(const Window &w) : m_type(w.m_type), m_size(w.m_size), m_cache(0) {
-        encache();
+    Window(const Window &w) :
+        m_type(w.m_type), m_size(w.m_size), m_table(w.m_table),
+        m_cache(w.m_cache) {
     }
     Window &operator=(const Window &w) {
 	if (&w == this) return *this;
 	m_type = w.m_type;
 	m_size = w.m_size;
-	encache();
+        m_table = w.m_table;
+        m_cache = w.m_cache;
 	return *this;
     }
-    virtual ~Window() {
-        breakfastquay::deallocate(m_cache);
-    }
+    virtual ~Window() { }
     
     inline void cut(T *const BQ_R__ block) const {
         breakfastquay::v_multiply(block, m_cache, m_size);
@@ -75,8 +77,8 @@ public:
         breakfastquay::v_multiply(dst, src, m_cache, m_size);
     }
 
-    T getArea() { return m_area; }
-    T getValue(int i) { return m_cache[i]; }
+    T getArea() const { return m_table->area; }
+    T getValue(int i) const { return m_cache[i]; }
 
     WindowType getType() const { return m_type; }
     int getSize() const { return m_size; }
@@ -88,54 +90,100 @@ public:
     static WindowType getTypeForName(std::string name);
 
 protected:
+    /**
+     * The calculated window shape for a given type and size, shared
+     * immutably between all windows of that type, size, and sample
+     * type in the process.
+     */
+    struct Table {
+        Table(int n) : data(breakfastquay::allocate<T>(n)), area(0) { }
+        ~Table() { breakfastquay::deallocate(data); }
+        T *data;
+        T area;
+    private:
+        Table(const Table &); // not implemented
+        Table &operator=(const Table &); // not implemented
+    };
+    
     WindowType m_type;
     int m_size;
-    T *BQ_R__ m_cache;
-    T m_area;
+    std::shared_ptr<const Table> m_table;
+    const T *BQ_R__ m_cache;
     
     void encache();
-    void cosinewin(T *, double, double, double, double);
+    static std::shared_ptr<const Table> makeTable(WindowType type, int size);
+    static void cosinewin(T *, int, double, double, double, double);
 };
 
 template <typename T>
 void Window<T>::encache()
 {
-    if (!m_cache) m_cache = breakfastquay::allocate<T>(m_size);
+    // Window shapes are expensive to calculate (cos and pow for
+    // every sample) and short-lived windows of the same few sizes
+    // are created very frequently, so we calculate each one only
+    // once per process. The static data here is instantiated
+    // separately for each sample type T.
+    
+    static std::mutex mutex;
+    static std::map<std::pair<WindowType, int>,
+                    std::shared_ptr<const Table>> tables;
+
+    std::lock_guard<std::mutex> guard(mutex);
 
-    const int n = m_size;
-    breakfastquay::v_set(m_cache, T(1.0), n);
+    auto key = std::make_pair(m_type, m_size);
+    auto itr = tables.find(key);
+    if (itr != tables.end()) {
+        m_table = itr->second;
+    } else {
+        m_table = makeTable(m_type, m_size);
+        tables[key] = m_table;
+    }
+    
+    m_cache = m_table->data;
+}
+
+template <typename T>
+std::shared_ptr<const typename Window<T>::Table>
+Window<T>::makeTable(WindowType type, int size)
+{
+    const int n = size;
+
+    std::shared_ptr<Table> table(new Table(n));
+    T *const cache = table->data;
+    
+    breakfastquay::v_set(cache, T(1.0), n);
     int i;
 
-    switch (m_type) {
+    switch (type) {
 		
     case RectangularWindow:
 	for (i = 0; i < n; ++i) {
-	    m_cache[i] *= T(0.5);
+	    cache[i] *= T(0.5);
 	}
 	break;
 	    
     case BartlettWindow:
 	for (i = 0; i < n/2; ++i) {
-	    m_cache[i] *= T(i) / T(n/2);
-	    m_cache[i + n/2] *= T(1.0) - T(i) / T(n/2);
+	    cache[i] *= T(i) / T(n/2);
+	    cache[i + n/2] *= T(1.0) - T(i) / T(n/2);
 	}
 	break;
 	    
     case HammingWindow:
-        cosinewin(m_cache, 0.54, 0.46, 0.0, 0.0);
+        cosinewin(cache, n, 0.54, 0.46, 0.0, 0.0);
 	break;
 	    
     case HanningWindow:
-        cosinewin(m_cache, 0.50, 0.50, 0.0, 0.0);
+        cosinewin(cache, n, 0.50, 0.50, 0.0, 0.0);
 	break;
 	    
     case BlackmanWindow:
-        cosinewin(m_cache, 0.42, 0.50, 0.08, 0.0);
+        cosinewin(cache, n, 0.42, 0.50, 0.08, 0.0);
 	break;
 	    
     case GaussianWindow:
 	for (i = 0; i < n; ++i) {
-            m_cache[i] *= T(pow(2, - pow((i - (n-1)/2.0) / ((n-1)/2.0 / 3), 2)));
+            cache[i] *= T(pow(2, - pow((i - (n-1)/2.0) / ((n-1)/2.0 / 3), 2)));
 	}
 	break;
 	    
@@ -144,38 +192,40 @@ void Window<T>::encache()
         int N = n-1;
         for (i = 0; i < N/4; ++i) {
             T m = T(2 * pow(1.0 - (T(N)/2 - T(i)) / (T(N)/2), 3));
-            m_cache[i] *= m;
-            m_cache[N-i] *= m;
+            cache[i] *= m;
+            cache[N-i] *= m;
         }
         for (i = N/4; i <= N/2; ++i) {
             int wn = i - N/2;
             T m = T(1.0 - 6 * pow(T(wn) / (T(N)/2), 2) * (1.0 - T(abs(wn)) / (T(N)/2)));
-            m_cache[i] *= m;
-            m_cache[N-i] *= m;
+            cache[i] *= m;
+            cache[N-i] *= m;
         }            
         break;
     }
 
     case NuttallWindow:
-        cosinewin(m_cache, 0.3635819, 0.4891775, 0.1365995, 0.0106411);
+        cosinewin(cache, n, 0.3635819, 0.4891775, 0.1365995, 0.0106411);
 	break;
 
     case BlackmanHarrisWindow:
-        cosinewin(m_cache, 0.35875, 0.48829, 0.14128, 0.01168);
+        cosinewin(cache, n, 0.35875, 0.48829, 0.14128, 0.01168);
         break;
     }
 	
-    m_area = 0;
+    T area = 0;
     for (int i = 0; i < n; ++i) {
-        m_area += m_cache[i];
+        area += cache[i];
     }
-    m_area /= T(n);
+    table->area = area / T(n);
+
+    return table;
 }
 
 template <typename T>
-void Window<T>::cosinewin(T *mult, double a0, double a1, double a2, double a3)
+void Window<T>::cosinewin(T *mult, int n,
+                          double a0, double a1, double a2, double a3)
 {
-    const int n = m_size;
     for (int i = 0; i < n; ++i) {
         mult[i] *= T(a0
                      - a1 * cos((2 * M_PI * i) / n)
@@ -0,0 +1,124 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+
+/*
+    Sonic Visualiser
+    An audio file viewer and annotation editor.
+    Centre for Digital Music, Queen Mary, University of London.
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation; either version 2 of the
+    License, or (at your option) any later version.  See the file
+    COPYING included with this distribution for more information.
+*/
+
+#ifndef TEST_CACHE_BUDGET_H
+#define TEST_CACHE_BUDGET_H
+
+#include "../CacheBudget.h"
+
+#include <QObject>
+#include <QtTest>
+
+#include <iostream>
+
+using namespace std;
+
+class TestCacheBudget : public QObject
+{
+    Q_OBJECT
+
+    // A cache that releases everything it has when asked
+    class MockCache : public BudgetedCache
+    {
+    public:
+        MockCache(size_t size) : m_size(size), m_evictions(0) {
+            CacheBudget::getInstance()->registerCache(this);
+        }
+        ~MockCache() {
+            CacheBudget::getInstance()->unregisterCache(this);
+        }
+        size_t getEvictableSize() const { return m_size; }
+        size_t evict(size_t) {
+            size_t released = m_size;
+            m_size = 0;
+            ++m_evictions;
+            return released;
+        }
+        size_t m_size;
+        int m_evictions;
+    };
+
+private slots:
+    void total() {
+        MockCache a(100), b(200);
+        QCOMPARE(CacheBudget::getInstance()->getCacheTotal(), size_t(300));
+        {
+            MockCache c(50);
+            QCOMPARE(CacheBudget::getInstance()->getCacheTotal(), size_t(350));
+        }
+        QCOMPARE(CacheBudget::getInstance()->getCacheTotal(), size_t(300));
+    }
+
+    void leastRecentlyUsedFirst() {
+        MockCache a(100), b(100), c(100);
+        b.markUsed();
+        a.markUsed();
+        c.markUsed();
+        QCOMPARE(CacheBudget::getInstance()->release(150), size_t(200));
+        QCOMPARE(b.m_evictions, 1);
+        QCOMPARE(a.m_evictions, 1);
+        QCOMPARE(c.m_evictions, 0);
+        QCOMPARE(CacheBudget::getInstance()->getCacheTotal(), size_t(100));
+    }
+
+    void emptySkipped() {
+        MockCache a(0), b(100);
+        a.markUsed();
+        b.markUsed();
+        QCOMPARE(CacheBudget::getInstance()->release(10), size_t(100));
+        QCOMPARE(a.m_evictions, 0);
+        QCOMPARE(b.m_evictions, 1);
+    }
+
+    void moreThanAvailable() {
+        MockCache a(100), b(100);
+        QCOMPARE(CacheBudget::getInstance()->release(1000), size_t(200));
+        QCOMPARE(CacheBudget::getInstance()->release(1000), size_t(0));
+    }
+
+    void evictMayCallBudget() {
+        // No budget lock is held while a cache is asked to evict, so
+        // it can call back in (this would deadlock otherwise)
+        class ReentrantCache : public MockCache {
+        public:
+            ReentrantCache(size_t size) : MockCache(size), m_seen(0) { }
+            size_t evict(size_t bytes) {
+                m_seen = CacheBudget::getInstance()->getCacheTotal();
+                return MockCache::evict(bytes);
+            }
+            size_t m_seen;
+        };
+        ReentrantCache a(100);
+        QCOMPARE(CacheBudget::getInstance()->release(10), size_t(100));
+        QCOMPARE(a.m_seen, size_t(100));
+    }
+
+    void noLimit() {
+        MockCache a(100);
+        CacheBudget::getInstance()->setLimit(0);
+        QCOMPARE(CacheBudget::getInstance()->enforce(), size_t(0));
+        QCOMPARE(a.m_evictions, 0);
+    }
+
+    void overLimit() {
+        // However the memory in use is measured, it exceeds one byte
+        MockCache a(100);
+        CacheBudget::getInstance()->setLimit(1);
+        QCOMPARE(CacheBudget::getInstance()->enforce(), size_t(100));
+        QCOMPARE(a.m_evictions, 1);
+        CacheBudget::getInstance()->setLimit(0);
+    }
+};
+
+#endif
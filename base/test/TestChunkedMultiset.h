@@ -0,0 +1,275 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+
+/*
+    Sonic Visualiser
+    An audio file viewer and annotation editor.
+    Centre for Digital Music, Queen Mary, University of London.
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation; either version 2 of the
+    License, or (at your option) any later version.  See the file
+    COPYING included with this distribution for more information.
+*/
+
+#ifndef TEST_CHUNKED_MULTISET_H
+#define TEST_CHUNKED_MULTISET_H
+
+#include "../ChunkedMultiset.h"
+#include "TestRandom.h"
+
+#include <QObject>
+#include <QtTest>
+
+#include <iostream>
+#include <set>
+#include <vector>
+
+using namespace std;
+
+class TestChunkedMultiset : public QObject
+{
+    Q_OBJECT
+
+    // Something like a SparseModel point: ordered by frame only, so
+    // that there are distinct but equivalent elements
+    struct Point {
+        long frame;
+        int id;
+    };
+
+    struct OrderComparator {
+        bool operator()(const Point &p1, const Point &p2) const {
+            return p1.frame < p2.frame;
+        }
+    };
+
+    typedef multiset<Point, OrderComparator> Reference;
+
+    // A small chunk size, so that the tests split and remove chunks
+    typedef ChunkedMultiset<Point, OrderComparator, 8> Small;
+
+    TestRandom rnd;
+
+    template <typename A, typename B>
+    static bool same(const A &a, const B &b) {
+        if (a.size() != b.size()) return false;
+        auto j = b.begin();
+        for (auto i = a.begin(); i != a.end(); ++i, ++j) {
+            if (i->frame != j->frame || i->id != j->id) return false;
+        }
+        return j == b.end();
+    }
+
+    template <typename A, typename B>
+    static bool sameAt(const A &a, typename A::const_iterator i,
+                       const B &b, typename B::const_iterator j) {
+        if ((i == a.end()) != (j == b.end())) return false;
+        return i == a.end() || i->id == j->id;
+    }
+
+    // Benchmark sizes. A million points is about what a dense
+    // feature output over a long recording produces, which is where
+    // the choice of container matters
+    static const int benchCount = 1000000;
+    static const long benchSpacing = 512;
+
+    template <typename S>
+    void benchInsertInOrder() {
+        QBENCHMARK {
+            S s;
+            for (int i = 0; i < benchCount; ++i) {
+                s.insert(Point { i * benchSpacing, i });
+            }
+        }
+    }
+
+    template <typename S>
+    void benchInsertRandom() {
+        rnd.seed(1);
+        vector<Point> points;
+        for (int i = 0; i < benchCount / 10; ++i) {
+            points.push_back(Point { long(rnd()) * benchSpacing, i });
+        }
+        QBENCHMARK {
+            S s;
+            for (const Point &p : points) s.insert(p);
+        }
+    }
+
+    template <typename S>
+    void benchRangeQuery() {
+        S s;
+        for (int i = 0; i < benchCount; ++i) {
+            s.insert(Point { i * benchSpacing, i });
+        }
+        rnd.seed(2);
+        long total = 0;
+        QBENCHMARK {
+            // As SparseModel::getPoints(start, end) does, for ranges
+            // of about 100 points
+            for (int q = 0; q < 1000; ++q) {
+                long start = long(rnd() % benchCount) * benchSpacing;
+                long end = start + 100 * benchSpacing;
+                auto i0 = s.lower_bound(Point { start, 0 });
+                auto i1 = s.upper_bound(Point { end, 0 });
+                for (auto i = i0; i != i1; ++i) total += i->id;
+            }
+        }
+        QVERIFY(total > 0);
+    }
+
+    template <typename S>
+    void benchFullScan() {
+        S s;
+        for (int i = 0; i < benchCount; ++i) {
+            s.insert(Point { i * benchSpacing, i });
+        }
+        long total = 0;
+        QBENCHMARK {
+            for (const Point &p : s) total += p.frame;
+        }
+        QVERIFY(total > 0);
+    }
+
+private slots:
+    void empty() {
+        Small s;
+        QVERIFY(s.empty());
+        QCOMPARE(s.size(), size_t(0));
+        QVERIFY(s.begin() == s.end());
+        QVERIFY(s.lower_bound(Point { 0, 0 }) == s.end());
+        QVERIFY(s.find(Point { 0, 0 }) == s.end());
+        QCOMPARE(s.erase(Point { 0, 0 }), size_t(0));
+    }
+
+    void equivalentInInsertionOrder() {
+        Small s;
+        for (int i = 0; i < 40; ++i) s.insert(Point { 10, i });
+        s.insert(Point { 5, 100 });
+        s.insert(Point { 10, 101 });
+        s.insert(Point { 20, 102 });
+        QCOMPARE(s.size(), size_t(43));
+        QCOMPARE(s.count(Point { 10, 0 }), size_t(41));
+        auto i = s.begin();
+        QCOMPARE(i->id, 100);
+        for (int j = 0; j < 40; ++j) {
+            ++i;
+            QCOMPARE(i->id, j);
+        }
+        QCOMPARE((++i)->id, 101);
+        QCOMPARE((++i)->id, 102);
+        QVERIFY(++i == s.end());
+        QCOMPARE(s.rbegin()->id, 102);
+    }
+
+    void againstMultiset() {
+        // Random inserts, lookups and erases, compared with the
+        // results from std::multiset
+        rnd.seed(42);
+        Reference ref;
+        Small s;
+        for (int step = 0; step < 20000; ++step) {
+            int op = rnd() % 10;
+            Point p { long(rnd() % 300), step };
+            if (op < 6) {
+                auto i = s.insert(p);
+                ref.insert(p);
+                QCOMPARE(i->id, step);
+            } else if (op < 8) {
+                auto i = s.lower_bound(p);
+                auto j = ref.lower_bound(p);
+                QVERIFY(sameAt(s, i, ref, j));
+                QVERIFY(sameAt(s, s.upper_bound(p), ref, ref.upper_bound(p)));
+                QCOMPARE(s.count(p), ref.count(p));
+                if (i != s.end()) {
+                    QVERIFY(sameAt(s, s.erase(i), ref, ref.erase(j)));
+                }
+            } else if (op < 9) {
+                QCOMPARE(s.erase(p), ref.erase(p));
+            } else {
+                QVERIFY(sameAt(s, s.find(p), ref, ref.find(p)));
+            }
+            if (step % 1000 == 0) {
+                QVERIFY(same(s, ref));
+            }
+        }
+        QVERIFY(same(s, ref));
+
+        // and backwards
+        auto j = ref.rbegin();
+        for (auto i = s.rbegin(); i != s.rend(); ++i, ++j) {
+            QCOMPARE(i->id, j->id);
+        }
+    }
+
+    void rankAndNth() {
+        // Positional lookups interleaved with inserts and erases that
+        // sometimes split or remove chunks, and sometimes do not
+        rnd.seed(7);
+        Reference ref;
+        Small s;
+        QVERIFY(s.nth(0) == s.end());
+        QCOMPARE(s.rank(s.end()), size_t(0));
+        for (int step = 0; step < 5000; ++step) {
+            Point p { long(rnd() % 200), step };
+            if (rnd() % 3 == 0 && !ref.empty()) {
+                auto i = s.lower_bound(p);
+                if (i != s.end()) {
+                    ref.erase(ref.lower_bound(p));
+                    s.erase(i);
+                }
+            } else {
+                size_t r = s.rank(s.insert(p));
+                auto j = ref.insert(p);
+                QCOMPARE(r, size_t(distance(ref.begin(), j)));
+            }
+            size_t n = size_t(rnd()) % (ref.size() + 1);
+            auto i = s.nth(n);
+            QCOMPARE(s.rank(i), n);
+            QVERIFY(sameAt(s, i, ref, next(ref.begin(), n)));
+        }
+        size_t n = 0;
+        for (auto i = s.begin(); i != s.end(); ++i, ++n) {
+            QCOMPARE(s.rank(i), n);
+            QVERIFY(s.nth(n) == i);
+        }
+        QCOMPARE(s.rank(s.end()), s.size());
+    }
+
+    void copy() {
+        Small s;
+        for (int i = 0; i < 100; ++i) s.insert(Point { 99 - i, i });
+        Small t(s);
+        s.clear();
+        QCOMPARE(t.size(), size_t(100));
+        QCOMPARE(t.begin()->frame, 0L);
+        Small u(t.begin(), t.end());
+        QVERIFY(same(u, t));
+    }
+
+    // Benchmarks, with std::multiset for comparison. Run the test
+    // binary with e.g. -tickcounter or -callgrind for more detail
+
+    void benchInsertInOrderMultiset() { benchInsertInOrder<Reference>(); }
+    void benchInsertInOrderChunked() {
+        benchInsertInOrder<ChunkedMultiset<Point, OrderComparator>>();
+    }
+
+    void benchInsertRandomMultiset() { benchInsertRandom<Reference>(); }
+    void benchInsertRandomChunked() {
+        benchInsertRandom<ChunkedMultiset<Point, OrderComparator>>();
+    }
+
+    void benchRangeQueryMultiset() { benchRangeQuery<Reference>(); }
+    void benchRangeQueryChunked() {
+        benchRangeQuery<ChunkedMultiset<Point, OrderComparator>>();
+    }
+
+    void benchFullScanMultiset() { benchFullScan<Reference>(); }
+    void benchFullScanChunked() {
+        benchFullScan<ChunkedMultiset<Point, OrderComparator>>();
+    }
+};
+
+#endif
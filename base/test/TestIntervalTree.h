@@ -0,0 +1,119 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+
+/*
+    Sonic Visualiser
+    An audio file viewer and annotation editor.
+    Centre for Digital Music, Queen Mary, University of London.
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation; either version 2 of the
+    License, or (at your option) any later version.  See the file
+    COPYING included with this distribution for more information.
+*/
+
+#ifndef TEST_INTERVAL_TREE_H
+#define TEST_INTERVAL_TREE_H
+
+#include "../IntervalTree.h"
+#include "TestRandom.h"
+
+#include <QObject>
+#include <QtTest>
+
+#include <iostream>
+#include <vector>
+#include <algorithm>
+#include <utility>
+
+using namespace std;
+
+class TestIntervalTree : public QObject
+{
+    Q_OBJECT
+
+    typedef pair<long, long> Interval;
+    typedef vector<Interval> Intervals;
+
+    TestRandom rnd;
+
+    static Intervals overlapping(const IntervalTree<long> &tree,
+                                 long from, long to) {
+        Intervals found;
+        tree.visitOverlapping(from, to, [&found](long s, long e) {
+                found.push_back(Interval(s, e));
+            });
+        return found;
+    }
+
+private slots:
+    void empty() {
+        IntervalTree<long> tree;
+        QVERIFY(tree.empty());
+        QVERIFY(overlapping(tree, 0, 100).empty());
+        QVERIFY(!tree.erase(0, 10));
+    }
+
+    void closedIntervals() {
+        IntervalTree<long> tree;
+        tree.insert(10, 20);
+        tree.insert(30, 30);
+        QCOMPARE(overlapping(tree, 0, 9), Intervals());
+        QCOMPARE(overlapping(tree, 0, 10), Intervals({ { 10, 20 } }));
+        QCOMPARE(overlapping(tree, 20, 29), Intervals({ { 10, 20 } }));
+        QCOMPARE(overlapping(tree, 21, 29), Intervals());
+        QCOMPARE(overlapping(tree, 30, 30), Intervals({ { 30, 30 } }));
+        QCOMPARE(overlapping(tree, 15, 35),
+                 Intervals({ { 10, 20 }, { 30, 30 } }));
+    }
+
+    void duplicates() {
+        IntervalTree<long> tree;
+        for (int i = 0; i < 5; ++i) tree.insert(100, 200);
+        tree.insert(100, 150);
+        QCOMPARE(tree.size(), size_t(6));
+        QCOMPARE(int(overlapping(tree, 160, 170).size()), 5);
+        QVERIFY(tree.erase(100, 200));
+        QCOMPARE(int(overlapping(tree, 160, 170).size()), 4);
+        QVERIFY(tree.erase(100, 150));
+        QVERIFY(!tree.erase(100, 150));
+        QCOMPARE(overlapping(tree, 0, 1000).front(), Interval(100, 200));
+    }
+
+    void againstBruteForce() {
+        // Mostly short intervals with a few long ones, as in a note
+        // or region layer
+        rnd.seed(11);
+        IntervalTree<long> tree;
+        Intervals ref;
+        for (int step = 0; step < 10000; ++step) {
+            int op = rnd() % 10;
+            if (op < 5) {
+                long s = rnd() % 5000;
+                long d = (rnd() % 10 == 0) ? rnd() % 3000 : rnd() % 30;
+                tree.insert(s, s + d);
+                ref.push_back(Interval(s, s + d));
+            } else if (op < 7 && !ref.empty()) {
+                size_t n = size_t(rnd()) % ref.size();
+                QVERIFY(tree.erase(ref[n].first, ref[n].second));
+                ref.erase(ref.begin() + n);
+            } else {
+                long from = rnd() % 5200 - 100;
+                long to = from + rnd() % 200;
+                Intervals expected;
+                for (const auto &i : ref) {
+                    if (i.first <= to && i.second >= from) {
+                        expected.push_back(i);
+                    }
+                }
+                sort(expected.begin(), expected.end());
+                QCOMPARE(overlapping(tree, from, to), expected);
+            }
+            QCOMPARE(tree.size(), ref.size());
+        }
+        tree.clear();
+        QVERIFY(tree.empty());
+    }
+};
+
+#endif
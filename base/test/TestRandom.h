@@ -0,0 +1,41 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+
+/*
+    Sonic Visualiser
+    An audio file viewer and annotation editor.
+    Centre for Digital Music, Queen Mary, University of London.
+    
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation; either version 2 of the
+    License, or (at your option) any later version.  See the file
+    COPYING included with this distribution for more information.
+*/
+
+#ifndef TEST_RANDOM_H
+#define TEST_RANDOM_H
+
+#include <random>
+
+/**
+ * Pseudo-random numbers for tests that compare against a reference
+ * implementation on generated data. Always seeded, so that a failing
+ * test fails the same way on every run and every platform.
+ */
+class TestRandom
+{
+public:
+    TestRandom(unsigned int seed = 1) : m_engine(seed) { }
+
+    void seed(unsigned int seed) { m_engine.seed(seed); }
+
+    /**
+     * Return a pseudo-random integer in the range [0, 2^24).
+     */
+    int operator()() { return int(m_engine() >> 8); }
+
+private:
+    std::mt19937 m_engine;
+};
+
+#endif
@@ -0,0 +1,107 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+
+/*
+    Sonic Visualiser
+    An audio file viewer and annotation editor.
+    Centre for Digital Music, Queen Mary, University of London.
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation; either version 2 of the
+    License, or (at your option) any later version.  See the file
+    COPYING included with this distribution for more information.
+*/
+
+#ifndef TEST_SLIDING_PERCENTILE_H
+#define TEST_SLIDING_PERCENTILE_H
+
+#include "../SlidingPercentile.h"
+#include "TestRandom.h"
+
+#include <QObject>
+#include <QtTest>
+
+#include <iostream>
+#include <deque>
+#include <vector>
+#include <algorithm>
+
+using namespace std;
+
+class TestSlidingPercentile : public QObject
+{
+    Q_OBJECT
+
+    // The straightforward reference implementation
+    float sortedPercentile(const deque<float> &window, float percentile) {
+        vector<float> sorted(window.begin(), window.end());
+        sort(sorted.begin(), sorted.end());
+        int rank = int(float(sorted.size()) * percentile);
+        if (rank >= int(sorted.size())) rank = int(sorted.size()) - 1;
+        return sorted[rank];
+    }
+
+private slots:
+    void single() {
+        SlidingPercentile<float> sp;
+        QVERIFY(sp.empty());
+        sp.push(3.f);
+        QCOMPARE(sp.size(), 1);
+        QCOMPARE(sp.get(0.f), 3.f);
+        QCOMPARE(sp.get(0.5f), 3.f);
+        QCOMPARE(sp.get(1.f), 3.f);
+        sp.pop();
+        QVERIFY(sp.empty());
+    }
+
+    void median() {
+        SlidingPercentile<float> sp;
+        for (float v : { 5.f, 1.f, 4.f, 2.f, 3.f }) sp.push(v);
+        QCOMPARE(sp.get(0.5f), 3.f);
+        QCOMPARE(sp.get(0.f), 1.f);
+        QCOMPARE(sp.get(1.f), 5.f);
+        sp.pop(); // removes 5
+        QCOMPARE(sp.get(0.5f), 3.f); // { 1, 2, 3, 4 }
+        sp.pop(); // removes 1
+        QCOMPARE(sp.get(0.5f), 3.f); // { 2, 3, 4 }
+        sp.pop(); // removes 4
+        QCOMPARE(sp.get(0.5f), 3.f); // { 2, 3 }
+    }
+
+    void duplicates() {
+        SlidingPercentile<float> sp;
+        for (float v : { 2.f, 2.f, 1.f, 2.f, 2.f }) sp.push(v);
+        QCOMPARE(sp.get(0.f), 1.f);
+        QCOMPARE(sp.get(0.5f), 2.f);
+        sp.pop();
+        sp.pop();
+        QCOMPARE(sp.get(0.f), 1.f);
+        sp.pop();
+        QCOMPARE(sp.get(0.f), 2.f);
+        QCOMPARE(sp.size(), 2);
+    }
+
+    void varyingWindowAndPercentile() {
+        // Compare against sorting, with a window that grows and
+        // shrinks and a percentile that changes as we go, as in
+        // pitch-adaptive peak picking
+        SlidingPercentile<float> sp;
+        deque<float> window;
+        TestRandom rnd(12345);
+        for (int i = 0; i < 2000; ++i) {
+            float v = float(rnd() % 100);
+            sp.push(v);
+            window.push_back(v);
+            int winSize = 3 + (i / 20) % 40;
+            while (int(window.size()) > winSize) {
+                window.pop_front();
+                sp.pop();
+            }
+            QCOMPARE(sp.size(), int(window.size()));
+            float percentile = 0.5f + float(i % 500) / 1000.f;
+            QCOMPARE(sp.get(percentile), sortedPercentile(window, percentile));
+        }
+    }
+};
+
+#endif
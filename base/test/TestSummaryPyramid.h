@@ -0,0 +1,149 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+
+/*
+    Sonic Visualiser
+    An audio file viewer and annotation editor.
+    Centre for Digital Music, Queen Mary, University of London.
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation; either version 2 of the
+    License, or (at your option) any later version.  See the file
+    COPYING included with this distribution for more information.
+*/
+
+#ifndef TEST_SUMMARY_PYRAMID_H
+#define TEST_SUMMARY_PYRAMID_H
+
+#include "../SummaryPyramid.h"
+#include "TestRandom.h"
+
+#include <QObject>
+#include <QtTest>
+
+#include <iostream>
+#include <vector>
+#include <utility>
+
+using namespace std;
+
+class TestSummaryPyramid : public QObject
+{
+    Q_OBJECT
+
+    typedef SummaryPyramid::Summary Summary;
+    typedef pair<sv_frame_t, float> Value;
+    typedef vector<Value> Values;
+
+    TestRandom rnd;
+
+    static Summary summarise(const Values &values,
+                             sv_frame_t start, sv_frame_t end) {
+        Summary s;
+        for (const Value &v : values) {
+            if (v.first < start || v.first >= end) continue;
+            if (s.count == 0 || v.second < s.min) s.min = v.second;
+            if (s.count == 0 || v.second > s.max) s.max = v.second;
+            s.sum += v.second;
+            ++s.count;
+        }
+        return s;
+    }
+
+    // Compare every bucket at every width against a brute-force
+    // summary of the values
+    static bool check(const SummaryPyramid &p, const Values &values,
+                      sv_frame_t extent) {
+        for (sv_frame_t res = p.getBaseWidth(); res <= extent * 2; res *= 2) {
+            vector<Summary> ss = p.getSummaries(0, extent, res);
+            for (const Summary &s : ss) {
+                if (s.duration > res) return false;
+                Summary e = summarise(values, s.frame, s.frame + s.duration);
+                if (s.count != e.count) return false;
+                if (s.count == 0) continue;
+                if (s.min != e.min || s.max != e.max) return false;
+                // values are small integers, so sums are exact
+                if (s.sum != e.sum) return false;
+            }
+        }
+        return true;
+    }
+
+private slots:
+    void empty() {
+        SummaryPyramid p(4);
+        QCOMPARE(p.getLevelCount(), 0);
+        vector<Summary> ss = p.getSummaries(0, 64, 16);
+        QCOMPARE(int(ss.size()), 4);
+        QCOMPARE(ss[3].frame, sv_frame_t(48));
+        QCOMPARE(ss[3].count, 0);
+        QVERIFY(p.getSummaries(10, 10, 16).empty());
+    }
+
+    void widths() {
+        SummaryPyramid p(4);
+        for (int i = 0; i < 256; ++i) p.add(i, float(i % 10));
+        QCOMPARE(p.getLevelCount(), 5);
+        // Finer than the base width
+        QCOMPARE(int(p.getSummaries(0, 256, 1).size()), 16);
+        // Between widths, rounding down
+        QCOMPARE(int(p.getSummaries(0, 256, 100).size()), 4);
+        // Wider than the whole
+        vector<Summary> ss = p.getSummaries(0, 256, 100000);
+        QCOMPARE(int(ss.size()), 1);
+        QCOMPARE(ss[0].count, 256);
+        QCOMPARE(ss[0].min, 0.f);
+        QCOMPARE(ss[0].max, 9.f);
+        // Unaligned range
+        ss = p.getSummaries(20, 40, 16);
+        QCOMPARE(int(ss.size()), 2);
+        QCOMPARE(ss[0].frame, sv_frame_t(16));
+        QCOMPARE(ss[1].count, 16);
+    }
+
+    void mean() {
+        SummaryPyramid p(2);
+        p.add(0, 1.f);
+        p.add(1, 2.f);
+        p.add(2, 6.f);
+        vector<Summary> ss = p.getSummaries(0, 4, 4);
+        QCOMPARE(ss[0].getMean(), 3.f);
+    }
+
+    void addRemove() {
+        rnd.seed(9);
+        const sv_frame_t extent = 5000;
+        SummaryPyramid p(3);
+        Values values;
+        for (int round = 0; round < 50; ++round) {
+            for (int i = 0; i < 40; ++i) {
+                Value v(rnd() % extent, float(rnd() % 20));
+                values.push_back(v);
+                p.add(v.first, v.second);
+            }
+            for (int i = 0; i < 20 && !values.empty(); ++i) {
+                size_t k = size_t(rnd()) % values.size();
+                Value v = values[k];
+                values.erase(values.begin() + k);
+                p.remove(v.first, v.second,
+                         [&](sv_frame_t start, sv_frame_t end) {
+                             return summarise(values, start, end);
+                         });
+            }
+            QVERIFY(check(p, values, extent));
+        }
+        p.clear();
+        QCOMPARE(p.getSummaries(0, extent, extent)[0].count, 0);
+    }
+
+    void negativeFramesIgnored() {
+        SummaryPyramid p(4);
+        p.add(-5, 1.f);
+        p.add(5, 2.f);
+        vector<Summary> ss = p.getSummaries(-100, 16, 16);
+        QCOMPARE(int(ss.size()), 1);
+        QCOMPARE(ss[0].count, 1);
+    }
+};
+
+#endif
@@ -1,10 +1,16 @@
 TEST_HEADERS = \
+	     TestCacheBudget.h \
+	     TestChunkedMultiset.h \
 	     TestColumnOp.h \
+	     TestIntervalTree.h \
 	     TestLogRange.h \
 	     TestRangeMapper.h \
 	     TestOurRealTime.h \
 	     TestPitch.h \
+	     TestRandom.h \
 	     TestScaleTickIntervals.h \
+	     TestSlidingPercentile.h \
+	     TestSummaryPyramid.h \
 	     TestStringBits.h \
 	     TestVampRealTime.h
 	     
@@ -136,6 +136,13 @@ public:
 
     virtual bool isUpdating() const { return false; }
 
+    /**
+     * Return an estimate of the number of bytes of memory used by the
+     * reader for decoded or cached audio. Files that are read
+     * directly need none.
+     */
+    virtual size_t getMemoryUsage() const { return 0; }
+
 signals:
     void frameCountChanged();
     
@@ -34,6 +34,7 @@
 
 #include <iostream>
 #include <map>
+#include <vector>
 
 using namespace std;
 
@@ -204,6 +205,14 @@ CSVFileReader::load() const
     bool firstEverValue = true;
 
     map<QString, int> labelCountMap;
+
+    // Points are collected here and added to the model in one go
+    // once the file is read, which is much quicker than adding them
+    // one at a time
+    vector<SparseOneDimensionalModel::Point> points1;
+    vector<SparseTimeValueModel::Point> points2;
+    vector<RegionModel::Point> points2a;
+    vector<NoteModel::Point> points2b;
     
     int valueColumns = 0;
     for (int i = 0; i < m_format.getColumnCount(); ++i) {
@@ -336,23 +345,23 @@ CSVFileReader::load() const
             if (modelType == CSVFormat::OneDimensionalModel) {
 	    
                 SparseOneDimensionalModel::Point point(frameNo, label);
-                model1->addPoint(point);
+                points1.push_back(point);
 
             } else if (modelType == CSVFormat::TwoDimensionalModel) {
 
                 SparseTimeValueModel::Point point(frameNo, value, label);
-                model2->addPoint(point);
+                points2.push_back(point);
 
             } else if (modelType == CSVFormat::TwoDimensionalModelWithDuration) {
 
                 RegionModel::Point point(frameNo, value, duration, label);
-                model2a->addPoint(point);
+                points2a.push_back(point);
 
             } else if (modelType == CSVFormat::TwoDimensionalModelWithDurationAndPitch) {
 
                 float level = ((value >= 0.f && value <= 1.f) ? value : 1.f);
                 NoteModel::Point point(frameNo, pitch, duration, level, label);
-                model2b->addPoint(point);
+                points2b.push_back(point);
 
             } else if (modelType == CSVFormat::ThreeDimensionalModel) {
 
@@ -411,6 +420,11 @@ CSVFileReader::load() const
         }
     }
 
+    if (model1) model1->addPoints(points1);
+    if (model2) model2->addPoints(points2);
+    if (model2a) model2a->addPoints(points2a);
+    if (model2b) model2b->addPoints(points2b);
+
     if (!haveAnyValue) {
         if (model2a) {
             // assign values for regions based on label frequency; we
@@ -437,16 +451,13 @@ CSVFileReader::load() const
 
             map<RegionModel::Point, RegionModel::Point,
                 RegionModel::Point::Comparator> pointMap;
-            for (RegionModel::PointList::const_iterator i =
-                     model2a->getPoints().begin();
-                 i != model2a->getPoints().end(); ++i) {
-                RegionModel::Point p(*i);
-                int count = labelCountMap[p.label];
-                v = countLabelValueMap[count][p.label];
-                cerr << "mapping from label \"" << p.label << "\" (count " << count << ") to value " << v << endl;
-                RegionModel::Point pp(p.frame, v, p.duration, p.label);
-                pointMap[p] = pp;
-            }
+            model2a->visitAllPoints([&](const RegionModel::Point &p) {
+                    int count = labelCountMap[p.label];
+                    v = countLabelValueMap[count][p.label];
+                    cerr << "mapping from label \"" << p.label << "\" (count " << count << ") to value " << v << endl;
+                    RegionModel::Point pp(p.frame, v, p.duration, p.label);
+                    pointMap[p] = pp;
+                });
 
             for (map<RegionModel::Point, RegionModel::Point>::iterator i = 
                      pointMap.begin(); i != pointMap.end(); ++i) {
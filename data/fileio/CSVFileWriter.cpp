@@ -70,9 +70,9 @@ CSVFileWriter::write()
         }
     
         QTextStream out(&file);
-        out << m_model->toDelimitedDataStringWithOptions
-            (m_delimiter, m_options);
+        m_model->writeDelimitedData(out, m_delimiter, m_options);
 
+        out.flush();
         file.close();
         temp.moveToTarget();
 
@@ -101,10 +101,11 @@ CSVFileWriter::writeSelection(MultiSelection *selection)
              i != selection->getSelections().end(); ++i) {
 	
             sv_frame_t f0(i->getStartFrame()), f1(i->getEndFrame());
-            out << m_model->toDelimitedDataStringSubsetWithOptions
-                (m_delimiter, m_options, f0, f1);
+            m_model->writeDelimitedDataSubset
+                (out, m_delimiter, m_options, f0, f1);
         }
 
+        out.flush();
         file.close();
         temp.moveToTarget();
 
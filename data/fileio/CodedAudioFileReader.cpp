@@ -36,6 +36,8 @@ CodedAudioFileReader::CodedAudioFileReader(CacheMode cacheMode,
                                            bool normalised) :
     m_cacheMode(cacheMode),
     m_initialised(false),
+    m_decodeFinished(false),
+    m_spillFileReader(0),
     m_serialiser(0),
     m_fileRate(0),
     m_cacheFileWritePtr(0),
@@ -65,10 +67,14 @@ CodedAudioFileReader::CodedAudioFileReader(CacheMode cacheMode,
 
     m_frameCount = 0;
     m_sampleRate = targetRate;
+
+    CacheBudget::getInstance()->registerCache(this);
 }
 
 CodedAudioFileReader::~CodedAudioFileReader()
 {
+    CacheBudget::getInstance()->unregisterCache(this);
+
     QMutexLocker locker(&m_cacheMutex);
 
     if (m_serialiser) endSerialised();
@@ -87,6 +93,14 @@ CodedAudioFileReader::~CodedAudioFileReader()
         }
     }
 
+    delete m_spillFileReader;
+
+    if (m_spillFileName != "") {
+        if (!QFile(m_spillFileName).remove()) {
+            SVDEBUG << "WARNING: CodedAudioFileReader::~CodedAudioFileReader: Failed to delete spilled cache file \"" << m_spillFileName << "\"" << endl;
+        }
+    }
+
     delete m_resampler;
     delete[] m_resampleBuffer;
 
@@ -365,6 +379,11 @@ CodedAudioFileReader::finishDecodeCache()
     if (m_normalised) {
         SVDEBUG << "CodedAudioFileReader: Normalising, gain is " << m_gain << endl;
     }
+
+    m_decodeFinished = true;
+
+    locker.unlock();
+    CacheBudget::getInstance()->check();
 }
 
 void
@@ -575,11 +594,21 @@ CodedAudioFileReader::getInterleavedFrames(sv_frame_t start, sv_frame_t count) c
         sv_frame_t ix0 = start * m_channelCount;
         sv_frame_t ix1 = ix0 + (count * m_channelCount);
 
+        markUsed();
+
         // This lock used to be a QReadWriteLock, but it appears that
         // its lock mechanism is significantly slower than QMutex so
         // it's not a good idea in cases like this where we don't
         // really have threads taking a long time to read concurrently
         m_dataLock.lock();
+        if (m_spillFileReader) {
+            // Moved to disc by evict(); the reader is ours until
+            // we are deleted
+            WavFileReader *reader = m_spillFileReader;
+            m_dataLock.unlock();
+            frames = reader->getInterleavedFrames(start, count);
+            break;
+        }
         sv_frame_t n = sv_frame_t(m_data.size());
         if (ix0 > n) ix0 = n;
         if (ix1 > n) ix1 = n;
@@ -596,3 +625,99 @@ CodedAudioFileReader::getInterleavedFrames(sv_frame_t start, sv_frame_t count) c
     return frames;
 }
 
+size_t
+CodedAudioFileReader::getMemoryUsage() const
+{
+    m_dataLock.lock();
+    size_t bytes = m_data.capacity() * sizeof(float);
+    m_dataLock.unlock();
+    return bytes;
+}
+
+size_t
+CodedAudioFileReader::getEvictableSize() const
+{
+    if (!m_decodeFinished) return 0;
+    return getMemoryUsage();
+}
+
+size_t
+CodedAudioFileReader::evict(size_t)
+{
+    if (!m_decodeFinished) return 0;
+
+    // Holding m_cacheMutex means nothing else will modify m_data, so
+    // we can write it out without holding m_dataLock against readers
+    QMutexLocker locker(&m_cacheMutex);
+
+    if (m_cacheMode != CacheInMemory || m_spillFileReader ||
+        m_data.empty() || m_channelCount == 0) {
+        return 0;
+    }
+
+    QString fileName;
+    try {
+        QDir dir(TempDirectory::getInstance()->getPath());
+        fileName = dir.filePath(QString("spilled_%1.w64")
+                                .arg((intptr_t)this));
+    } catch (DirectoryCreationFailed f) {
+        SVDEBUG << "CodedAudioFileReader::evict: failed to create temporary directory" << endl;
+        return 0;
+    }
+
+    // As in initialiseDecodeCache, we write floats so as to read back
+    // exactly what we had
+    SF_INFO fileInfo;
+    fileInfo.samplerate = int(round(m_sampleRate));
+    fileInfo.channels = m_channelCount;
+    fileInfo.format = SF_FORMAT_W64 | SF_FORMAT_FLOAT;
+
+#ifdef Q_OS_WIN
+    SNDFILE *file = sf_wchar_open
+        ((LPCWSTR)fileName.utf16(), SFM_WRITE, &fileInfo);
+#else
+    SNDFILE *file = sf_open(fileName.toLocal8Bit(), SFM_WRITE, &fileInfo);
+#endif
+
+    if (!file) {
+        SVDEBUG << "CodedAudioFileReader::evict: failed to open \""
+                << fileName << "\" for writing" << endl;
+        return 0;
+    }
+
+    sf_count_t frames = sf_count_t(m_data.size() / m_channelCount);
+    sf_count_t written = sf_writef_float(file, m_data.data(), frames);
+    sf_close(file);
+
+    WavFileReader *reader = 0;
+    if (written == frames) {
+        reader = new WavFileReader(fileName);
+        if (!reader->isOK()) {
+            delete reader;
+            reader = 0;
+        }
+    }
+
+    if (!reader) {
+        SVDEBUG << "CodedAudioFileReader::evict: failed to write or read back \""
+                << fileName << "\"" << endl;
+        QFile(fileName).remove();
+        return 0;
+    }
+
+    QMutexLocker dataLocker(&m_dataLock);
+
+    size_t bytes = m_data.capacity() * sizeof(float);
+    StorageAdviser::notifyDoneAllocation
+        (StorageAdviser::MemoryAllocation,
+         (m_data.size() * sizeof(float)) / 1024);
+    floatvec_t().swap(m_data);
+
+    m_spillFileName = fileName;
+    m_spillFileReader = reader;
+
+    SVDEBUG << "CodedAudioFileReader::evict: moved " << bytes
+            << " bytes of decoded audio to \"" << fileName << "\"" << endl;
+
+    return bytes;
+}
@@ -18,9 +18,13 @@
 
 #include "AudioFileReader.h"
 
+#include "base/CacheBudget.h"
+
 #include <QMutex>
 #include <QReadWriteLock>
 
+#include <atomic>
+
 #ifdef Q_OS_WIN
 #include <windows.h>
 #define ENABLE_SNDFILE_WINDOWS_PROTOTYPES 1
@@ -35,7 +39,8 @@ namespace breakfastquay {
     class Resampler;
 }
 
-class CodedAudioFileReader : public AudioFileReader
+class CodedAudioFileReader : public AudioFileReader,
+                             public BudgetedCache
 {
     Q_OBJECT
 
@@ -61,6 +66,14 @@ public:
     /// Intermediate cache means all CodedAudioFileReaders are quickly seekable
     virtual bool isQuicklySeekable() const { return true; }
 
+    /// The in-memory decode cache, if we have one
+    virtual size_t getMemoryUsage() const;
+
+    // BudgetedCache methods. Once decoding is complete, an in-memory
+    // decode cache can be moved to a temporary file
+    virtual size_t getEvictableSize() const;
+    virtual size_t evict(size_t bytes);
+
 signals:
     void progress(int);
 
@@ -104,6 +117,11 @@ protected:
     floatvec_t m_data;
     mutable QMutex m_dataLock;
     bool m_initialised;
+    std::atomic<bool> m_decodeFinished;
+
+    // Where m_data went if it was evicted, protected by m_dataLock
+    QString m_spillFileName;
+    WavFileReader *m_spillFileReader;
     Serialiser *m_serialiser;
     sv_samplerate_t m_fileRate;
 
@@ -84,6 +84,7 @@ DataFileReaderFactory::load(QString path,
     try {
         Model *model = reader->load();
         delete reader;
+        if (model) Model::registerModel(model);
         return model;
     } catch (Exception) {
         delete reader;
@@ -105,6 +106,7 @@ DataFileReaderFactory::loadNonCSV(QString path,
     try {
         Model *model = reader->load();
         delete reader;
+        if (model) Model::registerModel(model);
         return model;
     } catch (Exception) {
         delete reader;
@@ -123,6 +125,7 @@ DataFileReaderFactory::loadCSV(QString path, CSVFormat format,
     try {
         Model *model = reader->load();
         delete reader;
+        if (model) Model::registerModel(model);
         return model;
     } catch (Exception) {
         delete reader;
@@ -16,6 +16,9 @@
 #include "AlignmentModel.h"
 
 #include "SparseTimeValueModel.h"
+#include "ModelChangeCoalescer.h"
+
+#include <algorithm>
 
 //#define DEBUG_ALIGNMENT_MODEL 1
 
@@ -28,20 +31,14 @@ AlignmentModel::AlignmentModel(Model *reference,
     m_inputModel(inputModel),
     m_rawPath(path),
     m_path(0),
-    m_reversePath(0),
     m_pathBegun(false),
-    m_pathComplete(false)
+    m_pathComplete(false),
+    m_pathBuilt(false),
+    m_pathFilled(false)
 {
     if (m_rawPath) {
 
-        connect(m_rawPath, SIGNAL(modelChanged()),
-                this, SLOT(pathChanged()));
-
-        connect(m_rawPath, SIGNAL(modelChangedWithin(sv_frame_t, sv_frame_t)),
-                this, SLOT(pathChangedWithin(sv_frame_t, sv_frame_t)));
-        
-        connect(m_rawPath, SIGNAL(completionChanged()),
-                this, SLOT(pathCompletionChanged()));
+        connectRawPath();
 
         constructPath();
         constructReversePath();
@@ -62,9 +59,6 @@ AlignmentModel::~AlignmentModel()
 
     if (m_path) m_path->aboutToDelete();
     delete m_path;
-
-    if (m_reversePath) m_reversePath->aboutToDelete();
-    delete m_reversePath;
 }
 
 bool
@@ -141,11 +135,12 @@ AlignmentModel::toReference(sv_frame_t frame) const
 #ifdef DEBUG_ALIGNMENT_MODEL
     cerr << "AlignmentModel::toReference(" << frame << ")" << endl;
 #endif
-    if (!m_path) {
+    if (!m_pathBuilt) {
         if (!m_rawPath) return frame;
         constructPath();
+        constructReversePath();
     }
-    return align(m_path, frame);
+    return align(m_forward, frame);
 }
 
 sv_frame_t
@@ -154,11 +149,57 @@ AlignmentModel::fromReference(sv_frame_t frame) const
 #ifdef DEBUG_ALIGNMENT_MODEL
     cerr << "AlignmentModel::fromReference(" << frame << ")" << endl;
 #endif
-    if (!m_reversePath) {
+    if (!m_pathBuilt) {
         if (!m_rawPath) return frame;
+        constructPath();
+        constructReversePath();
+    }
+    return align(m_reverse, frame);
+}
+
+std::vector<sv_frame_t>
+AlignmentModel::toReference(const std::vector<sv_frame_t> &frames) const
+{
+    if (!m_pathBuilt) {
+        if (!m_rawPath) return frames;
+        constructPath();
+        constructReversePath();
+    }
+    return align(m_forward, frames);
+}
+
+std::vector<sv_frame_t>
+AlignmentModel::fromReference(const std::vector<sv_frame_t> &frames) const
+{
+    if (!m_pathBuilt) {
+        if (!m_rawPath) return frames;
+        constructPath();
         constructReversePath();
     }
-    return align(m_reversePath, frame);
+    return align(m_reverse, frames);
+}
+
+void
+AlignmentModel::connectRawPath()
+{
+    connect(m_rawPath, SIGNAL(modelChanged()),
+            this, SLOT(pathChanged()));
+
+    // The aligner may report progress often, and each report costs
+    // us a path update, so take them at most once per turn of the
+    // event loop. The coalescer replaces any ranges still pending
+    // with a whole-model change if one arrives, so we must take
+    // that from it too, or those ranges would be lost
+    ModelChangeCoalescer *coalescer = ModelChangeCoalescer::getFor(m_rawPath);
+
+    connect(coalescer, SIGNAL(modelChangedWithin(sv_frame_t, sv_frame_t)),
+            this, SLOT(pathChangedWithin(sv_frame_t, sv_frame_t)));
+
+    connect(coalescer, SIGNAL(modelChanged()),
+            this, SLOT(pathChangedThroughout()));
+
+    connect(m_rawPath, SIGNAL(completionChanged()),
+            this, SLOT(pathCompletionChanged()));
 }
 
 void
@@ -173,12 +214,19 @@ AlignmentModel::pathChanged()
 }
 
 void
-AlignmentModel::pathChangedWithin(sv_frame_t, sv_frame_t)
+AlignmentModel::pathChangedWithin(sv_frame_t startFrame, sv_frame_t endFrame)
+{
+    if (!m_rawPath) return;
+    updatePath(startFrame, endFrame);
+}    
+
+void
+AlignmentModel::pathChangedThroughout()
 {
-    if (!m_pathComplete) return;
+    if (!m_rawPath) return;
     constructPath();
     constructReversePath();
-}    
+}
 
 void
 AlignmentModel::pathCompletionChanged()
@@ -215,79 +263,129 @@ AlignmentModel::pathCompletionChanged()
 void
 AlignmentModel::constructPath() const
 {
-    if (!m_path) {
-        if (!m_rawPath) {
+    if (!m_rawPath) {
+        if (!m_pathBuilt) {
             cerr << "ERROR: AlignmentModel::constructPath: "
                       << "No raw path available" << endl;
-            return;
         }
+        return;
+    }
+
+    if (!m_path) {
+        // Only filled when we come to export it
         m_path = new PathModel
             (m_rawPath->getSampleRate(), m_rawPath->getResolution(), false);
-    } else {
-        if (!m_rawPath) return;
     }
         
-    m_path->clear();
+    m_forward.clear();
+    m_forward.reserve(m_rawPath->getPointCount());
 
-    SparseTimeValueModel::PointList points = m_rawPath->getPoints();
-        
-    for (SparseTimeValueModel::PointList::const_iterator i = points.begin();
-         i != points.end(); ++i) {
-        sv_frame_t frame = i->frame;
-        double value = i->value;
-        sv_frame_t rframe = lrint(value * m_aligned->getSampleRate());
-        m_path->addPoint(PathPoint(frame, rframe));
-    }
+    sv_samplerate_t alignedRate = m_aligned->getSampleRate();
+
+    m_rawPath->visitAllPoints([&](const TimeValuePoint &p) {
+            sv_frame_t rframe = lrint(p.value * alignedRate);
+            m_forward.push_back(PathPoint(p.frame, rframe));
+        });
+
+    m_pathBuilt = true;
+    m_pathFilled = false;
 
 #ifdef DEBUG_ALIGNMENT_MODEL
-    cerr << "AlignmentModel::constructPath: " << m_path->getPointCount() << " points, at least " << (2 * m_path->getPointCount() * (3 * sizeof(void *) + sizeof(int) + sizeof(PathPoint))) << " bytes" << endl;
+    cerr << "AlignmentModel::constructPath: " << m_forward.size() << " points, " << (m_forward.size() * sizeof(PathPoint)) << " bytes" << endl;
 #endif
 }
 
 void
 AlignmentModel::constructReversePath() const
 {
-    if (!m_reversePath) {
-        if (!m_path) {
-            cerr << "ERROR: AlignmentModel::constructReversePath: "
-                      << "No forward path available" << endl;
-            return;
-        }
-        m_reversePath = new PathModel
-            (m_path->getSampleRate(), m_path->getResolution(), false);
-    } else {
-        if (!m_path) return;
+    if (!m_pathBuilt) {
+        cerr << "ERROR: AlignmentModel::constructReversePath: "
+                  << "No forward path available" << endl;
+        return;
     }
-        
-    m_reversePath->clear();
 
-    PathModel::PointList points = m_path->getPoints();
-        
-    for (PathModel::PointList::const_iterator i = points.begin();
-         i != points.end(); ++i) {
-        sv_frame_t frame = i->frame;
-        sv_frame_t rframe = i->mapframe;
-        m_reversePath->addPoint(PathPoint(rframe, frame));
+    m_reverse.clear();
+    m_reverse.reserve(m_forward.size());
+
+    for (FlatPath::const_iterator i = m_forward.begin();
+         i != m_forward.end(); ++i) {
+        m_reverse.push_back(PathPoint(i->mapframe, i->frame));
     }
 
+    // Stable, so that points with the same frame stay in path order
+    std::stable_sort(m_reverse.begin(), m_reverse.end(),
+                     PathPoint::OrderComparator());
+
 #ifdef DEBUG_ALIGNMENT_MODEL
-    cerr << "AlignmentModel::constructReversePath: " << m_reversePath->getPointCount() << " points, at least " << (2 * m_reversePath->getPointCount() * (3 * sizeof(void *) + sizeof(int) + sizeof(PathPoint))) << " bytes" << endl;
+    cerr << "AlignmentModel::constructReversePath: " << m_reverse.size() << " points, " << (m_reverse.size() * sizeof(PathPoint)) << " bytes" << endl;
 #endif
 }
 
-sv_frame_t
-AlignmentModel::align(PathModel *path, sv_frame_t frame) const
+void
+AlignmentModel::updatePath(sv_frame_t startFrame, sv_frame_t endFrame)
 {
-    if (!path) return frame;
+    // The aligner adds points to the raw path in order as it goes, so
+    // usually only the end of our path needs to change. Anything else
+    // is handled by rebuilding the lot
+
+    if (!m_pathBuilt ||
+        (!m_forward.empty() && endFrame < m_forward.rbegin()->frame)) {
+        constructPath();
+        constructReversePath();
+        return;
+    }
+
+    // Drop the points from startFrame onwards...
+
+    while (!m_forward.empty() && m_forward.rbegin()->frame >= startFrame) {
+        const PathPoint &p = *m_forward.rbegin();
+        FlatPath::iterator i = std::upper_bound
+            (m_reverse.begin(), m_reverse.end(), PathPoint(p.mapframe),
+             PathPoint::OrderComparator());
+        while (i != m_reverse.begin()) {
+            --i;
+            if (i->frame != p.mapframe) break;
+            if (i->mapframe == p.frame) {
+                m_reverse.erase(i);
+                break;
+            }
+        }
+        m_forward.pop_back();
+    }
+
+    // ...and take them again from the raw path
 
+    sv_samplerate_t alignedRate = m_aligned->getSampleRate();
+
+    m_rawPath->visitPointsWithin
+        (startFrame, std::max(endFrame, m_rawPath->getEndFrame()),
+         [&](const TimeValuePoint &p) {
+            if (p.frame < startFrame) return;
+            sv_frame_t rframe = lrint(p.value * alignedRate);
+            m_forward.push_back(PathPoint(p.frame, rframe));
+            m_reverse.insert(std::upper_bound
+                             (m_reverse.begin(), m_reverse.end(),
+                              PathPoint(rframe),
+                              PathPoint::OrderComparator()),
+                             PathPoint(rframe, p.frame));
+        });
+
+    m_pathFilled = false;
+
+#ifdef DEBUG_ALIGNMENT_MODEL
+    cerr << "AlignmentModel::updatePath: " << m_forward.size() << " points after update from " << startFrame << endl;
+#endif
+}
+
+sv_frame_t
+AlignmentModel::align(const FlatPath &path, sv_frame_t frame) const
+{
     // The path consists of a series of points, each with frame equal
     // to the frame on the source model and mapframe equal to the
     // frame on the target model.  Both should be monotonically
     // increasing.
 
-    const PathModel::PointList &points = path->getPoints();
-
-    if (points.empty()) {
+    if (path.empty()) {
 #ifdef DEBUG_ALIGNMENT_MODEL
         cerr << "AlignmentModel::align: No points" << endl;
 #endif
@@ -298,15 +396,66 @@ AlignmentModel::align(PathModel *path, sv_frame_t frame) const
     cerr << "AlignmentModel::align: frame " << frame << " requested" << endl;
 #endif
 
-    PathModel::Point point(frame);
-    PathModel::PointList::const_iterator i = points.lower_bound(point);
-    if (i == points.end()) {
+    FlatPath::const_iterator i = std::lower_bound
+        (path.begin(), path.end(), PathPoint(frame),
+         PathPoint::OrderComparator());
+
+    return interpolate(path, i, frame);
+}
+
+std::vector<sv_frame_t>
+AlignmentModel::align(const FlatPath &path,
+                      const std::vector<sv_frame_t> &frames) const
+{
+    if (path.empty()) return frames;
+
+    std::vector<sv_frame_t> results;
+    results.reserve(frames.size());
+
+    PathPoint::OrderComparator comparator;
+    FlatPath::const_iterator i = path.begin();
+    sv_frame_t prevFrame = 0;
+
+    for (size_t k = 0; k < frames.size(); ++k) {
+
+        sv_frame_t frame = frames[k];
+
+        // Search onwards from the last result if we are still
+        // ascending, stepping in increasing strides before a binary
+        // search, so that a run of nearby frames costs little more
+        // than a walk along the path
+        if (k == 0 || frame < prevFrame) i = path.begin();
+
+        FlatPath::const_iterator lo = i, hi = i;
+        FlatPath::difference_type stride = 1;
+        while (hi != path.end() && hi->frame < frame) {
+            lo = hi;
+            hi += std::min(stride, path.end() - hi);
+            stride *= 2;
+        }
+        i = std::lower_bound(lo, hi, PathPoint(frame), comparator);
+
+        results.push_back(interpolate(path, i, frame));
+        prevFrame = frame;
+    }
+
+    return results;
+}
+
+sv_frame_t
+AlignmentModel::interpolate(const FlatPath &path,
+                            FlatPath::const_iterator i,
+                            sv_frame_t frame)
+{
+    // i is the first point at or after frame, if there is one. We
+    // want the last point at or before frame, if there is one
+    if (i == path.end()) {
 #ifdef DEBUG_ALIGNMENT_MODEL
         cerr << "Note: i == points.end()" << endl;
 #endif
         --i;
     }
-    while (i != points.begin() && i->frame > frame) --i;
+    if (i != path.begin() && i->frame > frame) --i;
 
     sv_frame_t foundFrame = i->frame;
     sv_frame_t foundMapFrame = i->mapframe;
@@ -314,7 +463,7 @@ AlignmentModel::align(PathModel *path, sv_frame_t frame) const
     sv_frame_t followingFrame = foundFrame;
     sv_frame_t followingMapFrame = foundMapFrame;
 
-    if (++i != points.end()) {
+    if (++i != path.end()) {
 #ifdef DEBUG_ALIGNMENT_MODEL
         cerr << "another point available" << endl;
 #endif
@@ -358,14 +507,7 @@ AlignmentModel::setPathFrom(SparseTimeValueModel *rawpath)
 
     m_rawPath = rawpath;
 
-    connect(m_rawPath, SIGNAL(modelChanged()),
-            this, SLOT(pathChanged()));
-
-    connect(m_rawPath, SIGNAL(modelChangedWithin(sv_frame_t, sv_frame_t)),
-            this, SLOT(pathChangedWithin(sv_frame_t, sv_frame_t)));
-        
-    connect(m_rawPath, SIGNAL(completionChanged()),
-            this, SLOT(pathCompletionChanged()));
+    connectRawPath();
     
     constructPath();
     constructReversePath();
@@ -384,10 +526,23 @@ AlignmentModel::setPath(PathModel *path)
 #ifdef DEBUG_ALIGNMENT_MODEL
     cerr << "AlignmentModel::setPath: path = " << m_path << endl;
 #endif
+
+    m_forward.clear();
+    m_pathBuilt = false;
+    if (!m_path) return;
+
+    m_forward.reserve(m_path->getPointCount());
+    m_path->visitAllPoints([&](const PathPoint &p) {
+            m_forward.push_back(p);
+        });
+    m_pathBuilt = true;
+    m_pathFilled = true;
+
     constructReversePath();
 #ifdef DEBUG_ALIGNMENT_MODEL
-    cerr << "AlignmentModel::setPath: after construction path = "
-              << m_path << ", rpath = " << m_reversePath << endl;
+    cerr << "AlignmentModel::setPath: after construction path has "
+              << m_forward.size() << " points, reverse path "
+              << m_reverse.size() << endl;
 #endif
 }
     
@@ -396,11 +551,17 @@ AlignmentModel::toXml(QTextStream &stream,
                       QString indent,
                       QString extraAttributes) const
 {
-    if (!m_path) {
+    if (!m_pathBuilt || !m_path) {
         SVDEBUG << "AlignmentModel::toXml: no path" << endl;
         return;
     }
 
+    if (!m_pathFilled) {
+        m_path->clear();
+        m_path->addPoints(m_forward);
+        m_pathFilled = true;
+    }
+
     m_path->toXml(stream, indent, "");
 
     Model::toXml(stream, indent,
@@ -23,6 +23,8 @@
 #include <QString>
 #include <QStringList>
 
+#include <vector>
+
 class SparseTimeValueModel;
 
 class AlignmentModel : public Model
@@ -51,6 +53,15 @@ public:
     sv_frame_t toReference(sv_frame_t frame) const;
     sv_frame_t fromReference(sv_frame_t frame) const;
 
+    /**
+     * Map many frames at once, returning the results in the same
+     * order. This is much quicker than mapping them one at a time if
+     * the frames are in ascending order, as the path is then searched
+     * in a single pass.
+     */
+    std::vector<sv_frame_t> toReference(const std::vector<sv_frame_t> &frames) const;
+    std::vector<sv_frame_t> fromReference(const std::vector<sv_frame_t> &frames) const;
+
     void setPathFrom(SparseTimeValueModel *rawpath);
     void setPath(PathModel *path);
 
@@ -66,6 +77,7 @@ signals:
 protected slots:
     void pathChanged();
     void pathChangedWithin(sv_frame_t startFrame, sv_frame_t endFrame);
+    void pathChangedThroughout();
     void pathCompletionChanged();
 
 protected:
@@ -76,14 +88,29 @@ protected:
 
     SparseTimeValueModel *m_rawPath; // I own this
     mutable PathModel *m_path; // I own this
-    mutable PathModel *m_reversePath; // I own this
     bool m_pathBegun;
     bool m_pathComplete;
 
+    // The path and its reverse, as arrays sorted by frame, which is
+    // all we need for mapping. m_path is only filled from these when
+    // it is needed for export
+    typedef std::vector<PathPoint> FlatPath;
+    mutable FlatPath m_forward;
+    mutable FlatPath m_reverse;
+    mutable bool m_pathBuilt;
+    mutable bool m_pathFilled;
+
+    void connectRawPath();
     void constructPath() const;
     void constructReversePath() const;
-
-    sv_frame_t align(PathModel *path, sv_frame_t frame) const;
+    void updatePath(sv_frame_t startFrame, sv_frame_t endFrame);
+
+    sv_frame_t align(const FlatPath &path, sv_frame_t frame) const;
+    std::vector<sv_frame_t> align(const FlatPath &path,
+                                  const std::vector<sv_frame_t> &frames) const;
+    static sv_frame_t interpolate(const FlatPath &path,
+                                  FlatPath::const_iterator i,
+                                  sv_frame_t frame);
 };
 
 #endif
@@ -14,124 +14,311 @@
 */
 
 #include "Dense3DModelPeakCache.h"
+#include "DenseColumnStore.h"
+#include "ModelChangeCoalescer.h"
 
 #include "base/Profiler.h"
 
 #include "base/HitCount.h"
 
+#include <bqvec/Restrict.h>
+
 Dense3DModelPeakCache::Dense3DModelPeakCache(const DenseThreeDimensionalModel *source,
-					     int columnsPerPeak) :
+					     int columnsPerPeak,
+                                             int levels) :
     m_source(source),
-    m_columnsPerPeak(columnsPerPeak)
+    m_columnsPerPeak(columnsPerPeak),
+    m_levels(levels < 1 ? 1 : levels),
+    m_fillThread(0),
+    m_exiting(false)
 {
-    m_cache = new EditableDenseThreeDimensionalModel
-        (source->getSampleRate(),
-         getResolution(),
-         source->getHeight(),
-         EditableDenseThreeDimensionalModel::NoCompression,
-         false);
+    for (int level = 0; level < m_levels; ++level) {
+        m_stores.push_back(new DenseColumnStore
+                           (DenseColumnStore::FixedStride,
+                            source->getHeight()));
+        m_coverage.push_back(std::vector<bool>());
+    }
 
-    connect(source, SIGNAL(modelChanged()),
+    // A source still being written may change very often, and we
+    // only need to know that it has, so take its changes at most
+    // once per turn of the event loop
+    ModelChangeCoalescer *coalescer = ModelChangeCoalescer::getFor(source);
+    connect(coalescer, SIGNAL(modelChanged()),
+            this, SLOT(sourceModelChanged()));
+    connect(coalescer, SIGNAL(modelChangedWithin(sv_frame_t, sv_frame_t)),
             this, SLOT(sourceModelChanged()));
     connect(source, SIGNAL(aboutToBeDeleted()),
             this, SLOT(sourceModelAboutToBeDeleted()));
+
+    // Register before the fill thread starts, as it may call on the
+    // budget at any time after that
+    CacheBudget::getInstance()->registerCache(this);
+
+    m_fillThread = new FillThread(*this);
+    m_fillThread->start();
+
+    registerModel(this);
 }
 
 Dense3DModelPeakCache::~Dense3DModelPeakCache()
 {
-    if (m_cache) m_cache->aboutToDelete();
-    delete m_cache;
+    unregisterModel(this);
+    CacheBudget::getInstance()->unregisterCache(this);
+
+    m_exiting = true;
+    if (m_fillThread) {
+        m_fillThread->wait();
+        delete m_fillThread;
+    }
+    for (DenseColumnStore *store : m_stores) {
+        delete store;
+    }
 }
 
 Dense3DModelPeakCache::Column
 Dense3DModelPeakCache::getColumn(int column) const
 {
-    if (!m_source) return Column();
-    if (!haveColumn(column)) fillColumn(column);
-    return m_cache->getColumn(column);
+    return getPeakColumn(0, column);
 }
 
 float
 Dense3DModelPeakCache::getValueAt(int column, int n) const
 {
-    if (!m_source) return 0.f;
-    if (!haveColumn(column)) fillColumn(column);
-    return m_cache->getValueAt(column, n);
+    Column c = getPeakColumn(0, column);
+    if (in_range_for(c, n)) return c[n];
+    return 0.f;
 }
 
-void
-Dense3DModelPeakCache::sourceModelChanged()
+int
+Dense3DModelPeakCache::getLevelFor(int sourceColumnsPerPeak) const
 {
-    if (!m_source) return;
-    if (m_coverage.size() > 0) {
-        // The last peak may have come from an incomplete read, which
-        // may since have been filled, so reset it
-        m_coverage[m_coverage.size()-1] = false;
+    int level = 0;
+    while (level + 1 < m_levels &&
+           getColumnsPerPeak(level + 1) <= sourceColumnsPerPeak) {
+        ++level;
     }
-    m_coverage.resize(getWidth(), false); // retaining data
+    return level;
 }
 
-void
-Dense3DModelPeakCache::sourceModelAboutToBeDeleted()
+int
+Dense3DModelPeakCache::getPeakWidth(int level) const
 {
-    m_source = 0;
+    if (!m_source || level < 0 || level >= m_levels) return 0;
+    int sourceWidth = m_source->getWidth();
+    int cpp = getColumnsPerPeak(level);
+    if ((sourceWidth % cpp) == 0) {
+        return sourceWidth / cpp;
+    } else {
+        return sourceWidth / cpp + 1;
+    }
 }
 
-bool
-Dense3DModelPeakCache::haveColumn(int column) const
+Dense3DModelPeakCache::Column
+Dense3DModelPeakCache::getPeakColumn(int level, int column) const
 {
     static HitCount count("Dense3DModelPeakCache");
-    if (in_range_for(m_coverage, column) && m_coverage[column]) {
+
+    if (level < 0 || level >= m_levels) return Column();
+
+    markUsed();
+
+    QMutexLocker locker(&m_mutex);
+    if (!m_source) return Column();
+
+    Column c;
+    if (in_range_for(m_coverage[level], column) && m_coverage[level][column]) {
         count.hit();
-        return true;
+        c = m_stores[level]->getColumn(column);
     } else {
         count.miss();
-        return false;
+        c = fillColumn(level, column);
+    }
+
+    // Short columns read as zero-padded, as they did when the cache
+    // was an EditableDenseThreeDimensionalModel
+    int h = m_source->getHeight();
+    if (int(c.size()) < h) c.resize(h, 0.f);
+    return c;
+}
+
+size_t
+Dense3DModelPeakCache::getMemoryUsage() const
+{
+    QMutexLocker locker(&m_mutex);
+    size_t bytes = 0;
+    for (const DenseColumnStore *store : m_stores) {
+        bytes += store->getMemoryUsage();
+    }
+    for (const auto &coverage : m_coverage) {
+        bytes += coverage.capacity() / 8;
+    }
+    return bytes;
+}
+
+size_t
+Dense3DModelPeakCache::getEvictableSize() const
+{
+    // While the fill thread is running it would only fill the
+    // levels again
+    if (!m_fillThread || !m_fillThread->isFinished()) return 0;
+    return getMemoryUsage();
+}
+
+size_t
+Dense3DModelPeakCache::evict(size_t bytes)
+{
+    if (!m_fillThread || !m_fillThread->isFinished()) return 0;
+
+    QMutexLocker locker(&m_mutex);
+
+    // Drop the lowest levels first, as they are the largest. Each is
+    // recalculated from the source (level 0) or the level below it
+    // when next needed, and the higher levels that are kept don't
+    // depend on them for that
+    size_t released = 0;
+    for (int level = 0; level < m_levels && released < bytes; ++level) {
+        size_t before = m_stores[level]->getMemoryUsage() +
+            m_coverage[level].capacity() / 8;
+        m_stores[level]->clear();
+        std::vector<bool>().swap(m_coverage[level]);
+        size_t after = m_stores[level]->getMemoryUsage();
+        if (before > after) released += before - after;
     }
+    return released;
 }
 
 void
-Dense3DModelPeakCache::fillColumn(int column) const
+Dense3DModelPeakCache::sourceModelChanged()
 {
-    Profiler profiler("Dense3DModelPeakCache::fillColumn");
+    // The fill thread exits once the source reports completion, but
+    // the source may continue to grow after that
+    if (!m_source || m_exiting) return;
+    if (m_fillThread && m_fillThread->isFinished()) {
+        m_fillThread->start();
+    }
+}
 
-    if (!in_range_for(m_coverage, column)) {
-        if (m_coverage.size() > 0) {
-            // The last peak may have come from an incomplete read, which
-            // may since have been filled, so reset it
-            m_coverage[m_coverage.size()-1] = false;
-        }
-        m_coverage.resize(column + 1, false);
+void
+Dense3DModelPeakCache::sourceModelAboutToBeDeleted()
+{
+    m_exiting = true;
+    if (m_fillThread) {
+        m_fillThread->wait();
+    }
+    QMutexLocker locker(&m_mutex);
+    m_source = 0;
+}
+
+bool
+Dense3DModelPeakCache::isSourceComplete(int level, int column,
+                                        int sourceWidth) const
+{
+    // We can't rely on the source's completion to tell us that the
+    // final, short column will not grow (a model may report 100%
+    // before it has started), so that one is never considered
+    // complete
+    return (column + 1) * getColumnsPerPeak(level) <= sourceWidth;
+}
+
+// Take the elementwise maximum of peak and in, into peak. This is
+// written without branches and with unaliased pointers so that the
+// compiler can vectorise it
+static void
+mergePeaks(float *const BQ_R__ peak, const float *const BQ_R__ in, int n)
+{
+    for (int i = 0; i < n; ++i) {
+        peak[i] = (in[i] > peak[i] ? in[i] : peak[i]);
     }
+}
+
+Dense3DModelPeakCache::Column
+Dense3DModelPeakCache::fillColumn(int level, int column) const
+{
+    Profiler profiler("Dense3DModelPeakCache::fillColumn");
 
     int sourceWidth = m_source->getWidth();
-    
+    bool complete = isSourceComplete(level, column, sourceWidth);
+
+    // Each level is made from the one below, two columns at a time;
+    // level 0 from getColumnsPerPeak() source columns
+    int inputs = (level == 0 ? m_columnsPerPeak : 2);
+    int inputWidth = (level == 0 ? sourceWidth : getPeakWidth(level - 1));
+
     Column peak;
     int n = 0;
-    for (int i = 0; i < m_columnsPerPeak; ++i) {
+    for (int i = 0; i < inputs; ++i) {
 
-        int sourceColumn = column * m_columnsPerPeak + i;
-        if (sourceColumn >= sourceWidth) break;
-        
-        Column here = m_source->getColumn(sourceColumn);
+        int inputColumn = column * inputs + i;
+        if (inputColumn >= inputWidth) break;
+
+        Column here;
+        if (level == 0) {
+            here = m_source->getColumn(inputColumn);
+        } else if (in_range_for(m_coverage[level-1], inputColumn) &&
+                   m_coverage[level-1][inputColumn]) {
+            here = m_stores[level-1]->getColumn(inputColumn);
+        } else {
+            here = fillColumn(level - 1, inputColumn);
+        }
 
-//        cerr << "Dense3DModelPeakCache::fillColumn(" << column << "): source col "
-//             << sourceColumn << " of " << sourceWidth
-//             << " returned " << here.size() << " elts" << endl;
-        
         if (i == 0) {
             peak = here;
             n = int(peak.size());
         } else {
-            int m = std::min(n, int(here.size()));
-            for (int j = 0; j < m; ++j) {
-                peak[j] = std::max(here[j], peak[j]);
-            }
+            n = std::min(n, int(here.size()));
+            mergePeaks(peak.data(), here.data(), n);
         }
     }
 
-    m_cache->setColumn(column, peak);
-    m_coverage[column] = true;
+    // Values beyond the shortest input column are not peaks
+    peak.resize(n);
+
+    if (complete) {
+        m_stores[level]->setColumn(column, peak);
+        if (!in_range_for(m_coverage[level], column)) {
+            m_coverage[level].resize(column + 1, false);
+        }
+        m_coverage[level][column] = true;
+    }
+
+    return peak;
 }
 
+void
+Dense3DModelPeakCache::FillThread::run()
+{
+    Profiler profiler("Dense3DModelPeakCache::FillThread::run");
+
+    // Next column to fill at each level
+    std::vector<int> next(m_cache.m_levels, 0);
+
+    while (!m_cache.m_exiting) {
 
+        bool complete = (m_cache.m_source->getCompletion() == 100);
+        int sourceWidth = m_cache.m_source->getWidth();
+
+        for (int level = 0; level < m_cache.m_levels; ++level) {
+
+            // Fill only the columns whose source is complete (see
+            // isSourceComplete)
+            int width = sourceWidth / m_cache.getColumnsPerPeak(level);
+
+            for (int &x = next[level]; x < width; ++x) {
+                if (m_cache.m_exiting) return;
+                QMutexLocker locker(&m_cache.m_mutex);
+                if (in_range_for(m_cache.m_coverage[level], x) &&
+                    m_cache.m_coverage[level][x]) {
+                    continue;
+                }
+                m_cache.fillColumn(level, x);
+            }
+        }
+
+        CacheBudget::getInstance()->check();
+
+        // All but the final, short column of each level are now filled
+        if (complete) break;
+
+        msleep(100);
+    }
+}
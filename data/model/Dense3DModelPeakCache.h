@@ -17,15 +17,53 @@
 #define DENSE_3D_MODEL_PEAK_CACHE_H
 
 #include "DenseThreeDimensionalModel.h"
-#include "EditableDenseThreeDimensionalModel.h"
 
-class Dense3DModelPeakCache : public DenseThreeDimensionalModel
+#include "base/Thread.h"
+#include "base/CacheBudget.h"
+
+#include <QMutex>
+
+#include <vector>
+#include <atomic>
+
+class DenseColumnStore;
+
+/**
+ * A DenseThreeDimensionalModel that presents the peak (maximum)
+ * values across groups of columns of a source model, for drawing the
+ * source at zoom levels at which there are many columns per pixel.
+ *
+ * Peaks are kept at several levels of detail, forming a pyramid.
+ * Level 0 has one column for every getColumnsPerPeak() source
+ * columns, and each level above it has one column for every two
+ * columns of the level below, from which it is calculated. The
+ * model's own getColumn and getValueAt return level 0; the other
+ * levels are available through getPeakColumn.
+ *
+ * The pyramid is filled in a background thread, as the source model
+ * completes. A column that is requested before the background thread
+ * has reached it is calculated immediately on the reader's thread.
+ * Either way, no column of any level requires more than two columns
+ * of the level below it to be read, once those have been filled.
+ *
+ * When the background thread is idle, levels may be discarded at
+ * the request of CacheBudget, from level 0 upwards, after which their
+ * columns are calculated again as they are requested.
+ */
+class Dense3DModelPeakCache : public DenseThreeDimensionalModel,
+                              public BudgetedCache
 {
     Q_OBJECT
 
 public:
+    /**
+     * Construct a peak cache for the given source model, with
+     * columnsPerPeak source columns to each column of level 0 and
+     * the given number of levels in total.
+     */
     Dense3DModelPeakCache(const DenseThreeDimensionalModel *source,
-                          int columnsPerPeak);
+                          int columnsPerPeak,
+                          int levels = 8);
     ~Dense3DModelPeakCache();
 
     virtual bool isOK() const {
@@ -53,12 +91,7 @@ public:
     }
     
     virtual int getWidth() const {
-        int sourceWidth = m_source->getWidth();
-        if ((sourceWidth % m_columnsPerPeak) == 0) {
-            return sourceWidth / m_columnsPerPeak;
-        } else {
-            return sourceWidth / m_columnsPerPeak + 1;
-        }
+        return getPeakWidth(0);
     }
 
     virtual int getHeight() const {
@@ -83,6 +116,38 @@ public:
 
     virtual float getValueAt(int col, int n) const;
 
+    /**
+     * Return the number of levels in the pyramid.
+     */
+    int getLevelCount() const { return m_levels; }
+
+    /**
+     * Return the number of source columns summarised by each column
+     * at the given level, i.e. getColumnsPerPeak() * 2^level.
+     */
+    int getColumnsPerPeak(int level) const {
+        return m_columnsPerPeak << level;
+    }
+
+    /**
+     * Return the highest level having no more than the given number
+     * of source columns per peak column, or 0 if there is none.
+     */
+    int getLevelFor(int sourceColumnsPerPeak) const;
+
+    /**
+     * Return the number of columns at the given level.
+     */
+    int getPeakWidth(int level) const;
+
+    /**
+     * Retrieve the peaks column at column number col of the given
+     * level. This will consist of the peak values in the underlying
+     * model from columns (col * getColumnsPerPeak(level)) to
+     * ((col+1) * getColumnsPerPeak(level) - 1) inclusive.
+     */
+    Column getPeakColumn(int level, int col) const;
+
     virtual QString getBinName(int n) const {
         return m_source->getBinName(n);
     }
@@ -93,6 +158,13 @@ public:
 
     QString getTypeName() const { return tr("Dense 3-D Peak Cache"); }
 
+    virtual size_t getMemoryUsage() const;
+
+    // BudgetedCache methods:
+    //
+    virtual size_t getEvictableSize() const;
+    virtual size_t evict(size_t bytes);
+
     virtual int getCompletion() const {
         return m_source->getCompletion();
     }
@@ -101,15 +173,39 @@ protected slots:
     void sourceModelChanged();
     void sourceModelAboutToBeDeleted();
 
+protected:
+    class FillThread : public Thread
+    {
+    public:
+        FillThread(Dense3DModelPeakCache &cache) : m_cache(cache) { }
+        virtual void run();
+
+    protected:
+        Dense3DModelPeakCache &m_cache;
+    };
+
 private:
+    Dense3DModelPeakCache(const Dense3DModelPeakCache &); // not implemented
+    Dense3DModelPeakCache &operator=(const Dense3DModelPeakCache &); // not implemented
+
     const DenseThreeDimensionalModel *m_source;
-    mutable EditableDenseThreeDimensionalModel *m_cache;
-    mutable std::vector<bool> m_coverage; // must be bool, for space efficiency
-                                          // (vector of bool uses 1-bit elements)
     int m_columnsPerPeak;
-
-    bool haveColumn(int column) const;
-    void fillColumn(int column) const;
+    int m_levels;
+
+    // m_mutex protects the stores and coverage for all levels. A
+    // column is marked as covered only once it has been calculated
+    // from all of the source columns it summarises; the last column
+    // of a level may be calculated from an incomplete source, and
+    // is then recalculated each time it is requested
+    mutable QMutex m_mutex;
+    std::vector<DenseColumnStore *> m_stores;
+    mutable std::vector<std::vector<bool>> m_coverage; // vector of bool uses 1-bit elements
+
+    FillThread *m_fillThread;
+    std::atomic<bool> m_exiting;
+
+    bool isSourceComplete(int level, int col, int sourceWidth) const;
+    Column fillColumn(int level, int col) const; // call with m_mutex held
 };
 
 
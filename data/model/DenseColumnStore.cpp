@@ -0,0 +1,373 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+
+/*
+    Sonic Visualiser
+    An audio file viewer and annotation editor.
+    Centre for Digital Music, Queen Mary, University of London.
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation; either version 2 of the
+    License, or (at your option) any later version.  See the file
+    COPYING included with this distribution for more information.
+*/
+
+#include "DenseColumnStore.h"
+#include "MappedChunkFile.h"
+
+#include "base/Debug.h"
+
+#include <bqvec/Allocators.h>
+
+#include <algorithm>
+#include <cstring>
+
+using namespace std;
+
+// Aim for chunks of about this many values (256K bytes of float)
+static const int chunkValues = 65536;
+
+// When paging, keep this many of the most recently allocated chunks
+// on the heap
+static const int hotChunks = 16;
+
+DenseColumnStore::DenseColumnStore(Layout layout, int stride) :
+    m_layout(layout),
+    m_stride(1),
+    m_columnsPerChunk(1),
+    m_pageFile(0),
+    m_deferRelease(false)
+{
+    setStride(stride);
+}
+
+DenseColumnStore::~DenseColumnStore()
+{
+    clear();
+}
+
+bool
+DenseColumnStore::setStride(int stride)
+{
+    if (!m_lengths.empty()) return false;
+    m_stride = (stride < 1 ? 1 : stride);
+    m_columnsPerChunk = 1;
+    if (m_stride < chunkValues) {
+        m_columnsPerChunk = chunkValues / m_stride;
+    }
+    return true;
+}
+
+void
+DenseColumnStore::clear()
+{
+    for (int i = 0; i < m_chunks.size(); ++i) {
+        if (!m_mapped[i]) breakfastquay::deallocate(m_chunks[i].load());
+    }
+    m_chunks.clear();
+    m_mapped.clear();
+    {
+        lock_guard<mutex> guard(m_overflowMutex);
+        m_overflow.clear();
+    }
+
+    for (int i = 0; i < m_packedData.size(); ++i) {
+        if (!m_packed[i].mapped) breakfastquay::deallocate(m_packedData[i].load());
+    }
+    m_packedData.clear();
+    m_packed.clear();
+    m_locations.clear();
+
+    m_resident.clear();
+    releaseRetired();
+
+    m_lengths.clear();
+}
+
+int
+DenseColumnStore::getColumnLength(int x) const
+{
+    if (x < 0 || x >= m_lengths.size()) return 0;
+    return m_lengths[x];
+}
+
+float *
+DenseColumnStore::getSlot(int x) const
+{
+    int chunk = x / m_columnsPerChunk;
+    if (chunk >= m_chunks.size()) return 0;
+    float *data = m_chunks[chunk].load(memory_order_acquire);
+    if (!data) return 0;
+    return data + size_t(x % m_columnsPerChunk) * m_stride;
+}
+
+float *
+DenseColumnStore::getOrCreateSlot(int x)
+{
+    int chunk = x / m_columnsPerChunk;
+    if (chunk >= m_chunks.size()) {
+        m_chunks.resize(chunk + 1, (float *)0);
+        m_mapped.resize(chunk + 1, false);
+    }
+    if (!m_chunks[chunk].load()) {
+        m_chunks[chunk].store(breakfastquay::allocate_and_zero<float>
+                              (size_t(m_columnsPerChunk) * m_stride),
+                              memory_order_release);
+        m_resident.push_back(chunk);
+        pageOutColdChunks();
+    }
+    return m_chunks[chunk].load() + size_t(x % m_columnsPerChunk) * m_stride;
+}
+
+const float *
+DenseColumnStore::getPacked(int x) const
+{
+    const Location &loc = m_locations[x];
+    if (loc.chunk < 0) return 0;
+    return m_packedData[loc.chunk].load(memory_order_acquire) + loc.offset;
+}
+
+void
+DenseColumnStore::setColumn(int x, const Column &values)
+{
+    if (x < 0) return;
+
+    if (x >= m_lengths.size()) {
+        if (m_layout == Packed) {
+            Location none = { -1, 0 };
+            m_locations.resize(x + 1, none);
+        }
+        m_lengths.resize(x + 1, 0);
+    }
+
+    int n = int(values.size());
+
+    if (m_layout == FixedStride) {
+
+        if (n > m_stride) {
+            {
+                lock_guard<mutex> guard(m_overflowMutex);
+                m_overflow[x] = values;
+            }
+            if (float *slot = getSlot(x)) {
+                fill(slot, slot + m_stride, 0.f);
+            }
+        } else {
+            if (m_lengths[x] > m_stride) {
+                lock_guard<mutex> guard(m_overflowMutex);
+                m_overflow.erase(x);
+            }
+            if (n > 0 || getSlot(x)) {
+                float *slot = getOrCreateSlot(x);
+                copy(values.begin(), values.end(), slot);
+                // zero the remainder, so a row slice need not check
+                // the column length for columns within the stride
+                fill(slot + n, slot + m_stride, 0.f);
+            }
+        }
+
+    } else {
+
+        Location &loc = m_locations[x];
+
+        if (n == 0) {
+            loc = { -1, 0 };
+        } else if (loc.chunk >= 0 && n <= m_lengths[x]) {
+            // overwrite in place
+            copy(values.begin(), values.end(),
+                 m_packedData[loc.chunk].load() + loc.offset);
+        } else {
+            if (m_packed.empty() ||
+                m_packed.back().capacity - m_packed.back().used < n) {
+                int capacity = max(n, chunkValues);
+                m_packedData.push_back(breakfastquay::allocate<float>(capacity));
+                m_packed.push_back({ capacity, 0, false });
+                m_resident.push_back(int(m_packed.size()) - 1);
+                pageOutColdChunks();
+            }
+            int c = int(m_packed.size()) - 1;
+            PackedChunk &chunk = m_packed[c];
+            loc = { c, chunk.used };
+            copy(values.begin(), values.end(),
+                 m_packedData[c].load() + chunk.used);
+            chunk.used += n;
+        }
+    }
+
+    m_lengths[x] = n;
+}
+
+DenseColumnStore::Column
+DenseColumnStore::getColumn(int x) const
+{
+    int n = getColumnLength(x);
+    if (n == 0) return Column();
+
+    if (m_layout == FixedStride) {
+        if (n > m_stride) {
+            lock_guard<mutex> guard(m_overflowMutex);
+            return m_overflow.at(x);
+        }
+        const float *slot = getSlot(x);
+        return Column(slot, slot + n);
+    } else {
+        const float *data = getPacked(x);
+        return Column(data, data + n);
+    }
+}
+
+float
+DenseColumnStore::getValueAt(int x, int n, float deflt) const
+{
+    if (n < 0 || n >= getColumnLength(x)) return deflt;
+
+    if (m_layout == FixedStride) {
+        if (m_lengths[x] > m_stride) {
+            lock_guard<mutex> guard(m_overflowMutex);
+            return m_overflow.at(x)[n];
+        }
+        return getSlot(x)[n];
+    } else {
+        return getPacked(x)[n];
+    }
+}
+
+void
+DenseColumnStore::getRowSlice(int n, int x0, int count, float *values,
+                              float deflt) const
+{
+    int i = 0;
+
+    if (m_layout == FixedStride && n >= 0 && n < m_stride) {
+
+        // Walk along each chunk at a constant stride
+        while (i < count) {
+            int x = x0 + i;
+            if (x < 0 || x >= getWidth()) {
+                values[i++] = deflt;
+                continue;
+            }
+            int chunk = x / m_columnsPerChunk;
+            int end = min(count, i + (m_columnsPerChunk -
+                                      x % m_columnsPerChunk));
+            end = min(end, getWidth() - x0);
+            const float *slot = getSlot(x);
+            if (!slot) {
+                while (i < end) values[i++] = deflt;
+                continue;
+            }
+            const float *base = m_chunks[chunk].load(memory_order_acquire);
+            int offset = (x % m_columnsPerChunk) * m_stride + n;
+            for ( ; i < end; ++i, offset += m_stride) {
+                int len = m_lengths[x0 + i];
+                if (len > m_stride) {
+                    values[i] = getValueAt(x0 + i, n, deflt);
+                } else if (n < len) {
+                    values[i] = base[offset];
+                } else {
+                    values[i] = deflt;
+                }
+            }
+        }
+
+    } else {
+        for ( ; i < count; ++i) {
+            values[i] = getValueAt(x0 + i, n, deflt);
+        }
+    }
+}
+
+size_t
+DenseColumnStore::getMemoryUsage() const
+{
+    size_t total = sizeof(*this);
+    total += m_lengths.getAllocatedSize();
+    for (int i = 0; i < m_chunks.size(); ++i) {
+        if (m_chunks[i].load() && !m_mapped[i]) {
+            total += size_t(m_columnsPerChunk) * m_stride * sizeof(float);
+        }
+    }
+    total += m_chunks.getAllocatedSize();
+    {
+        lock_guard<mutex> guard(m_overflowMutex);
+        for (const auto &o : m_overflow) {
+            total += o.second.capacity() * sizeof(float) + 64; // map node
+        }
+    }
+    total += m_locations.getAllocatedSize();
+    for (const PackedChunk &chunk : m_packed) {
+        if (!chunk.mapped) total += size_t(chunk.capacity) * sizeof(float);
+    }
+    total += m_packedData.getAllocatedSize();
+    total += m_packed.capacity() * sizeof(PackedChunk);
+    return total;
+}
+
+void
+DenseColumnStore::setPageFile(MappedChunkFile *file)
+{
+    m_pageFile = file;
+    pageOutColdChunks();
+}
+
+void
+DenseColumnStore::pageOutColdChunks()
+{
+    while (m_pageFile && int(m_resident.size()) > hotChunks) {
+
+        int c = m_resident.front();
+        atomic<float *> *data = 0;
+        size_t count = 0;
+
+        if (m_layout == FixedStride) {
+            data = &m_chunks[c];
+            count = size_t(m_columnsPerChunk) * m_stride;
+        } else {
+            data = &m_packedData[c];
+            count = size_t(m_packed[c].used);
+        }
+
+        if (count == 0) {
+            m_resident.pop_front();
+            continue;
+        }
+
+        float *heap = data->load();
+        void *mapped = m_pageFile->append(heap, count * sizeof(float));
+        if (!mapped) {
+            SVDEBUG << "WARNING: DenseColumnStore::pageOutColdChunks: Failed to page out chunk, keeping remaining chunks in memory" << endl;
+            m_pageFile = 0;
+            return;
+        }
+
+        data->store(static_cast<float *>(mapped), memory_order_release);
+        if (m_deferRelease) m_retired.push_back(heap);
+        else breakfastquay::deallocate(heap);
+
+        if (m_layout == FixedStride) {
+            m_mapped[c] = true;
+        } else {
+            // A paged-out packed chunk takes no further columns
+            m_packed[c].mapped = true;
+            m_packed[c].capacity = m_packed[c].used;
+        }
+
+        m_resident.pop_front();
+    }
+}
+
+void
+DenseColumnStore::setDeferredRelease(bool deferred)
+{
+    m_deferRelease = deferred;
+    if (!deferred) releaseRetired();
+}
+
+void
+DenseColumnStore::releaseRetired()
+{
+    for (float *chunk : m_retired) {
+        breakfastquay::deallocate(chunk);
+    }
+    m_retired.clear();
+}
@@ -0,0 +1,213 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+
+/*
+    Sonic Visualiser
+    An audio file viewer and annotation editor.
+    Centre for Digital Music, Queen Mary, University of London.
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation; either version 2 of the
+    License, or (at your option) any later version.  See the file
+    COPYING included with this distribution for more information.
+*/
+
+#ifndef SV_DENSE_COLUMN_STORE_H
+#define SV_DENSE_COLUMN_STORE_H
+
+#include "base/SegmentedArray.h"
+
+#include <vector>
+#include <map>
+#include <deque>
+#include <atomic>
+#include <mutex>
+#include <cstddef>
+
+class MappedChunkFile;
+
+/**
+ * Backing store for the columns of a dense three-dimensional grid of
+ * floats, such as that in EditableDenseThreeDimensionalModel.
+ *
+ * Rather than allocating each column separately, columns are stored
+ * contiguously in large chunks. There are two layouts:
+ *
+ * FixedStride places column x at a fixed offset of (x * stride) values
+ * within its chunk. Any column of up to stride values can be stored
+ * in place, and values from the same row in neighbouring columns are
+ * found at a constant distance apart, which makes row slices across
+ * many columns cheap to read. A column longer than the stride is held
+ * separately. This is the layout to use when columns may be replaced.
+ *
+ * Packed appends each column to the end of the current chunk, taking
+ * only as much space as the column needs. This suits columns of
+ * varying length that are written once, in order, as produced by the
+ * truncation compression in EditableDenseThreeDimensionalModel.
+ * Replacing a column in this layout leaves its previous space unused.
+ *
+ * Optionally, all but the most recently allocated few chunks can be
+ * paged out to a memory-mapped file (see setPageFile).
+ *
+ * A column that was never set reads as empty. This class is not
+ * thread-safe in general, and the owner must serialise access, with
+ * one exception: while columns are only being appended (each column
+ * set is beyond the current width) by a single writer, other threads
+ * may read columns that were complete before the writer started on
+ * its current column, without synchronising with the writer. The
+ * owner must have published the completion of those columns (for
+ * example through an atomic width), and must enable deferred release
+ * (see setDeferredRelease) if paging is in use.
+ */
+class DenseColumnStore
+{
+public:
+    typedef std::vector<float> Column;
+
+    enum Layout {
+        FixedStride,
+        Packed
+    };
+
+    /**
+     * Construct a store with the given layout. The stride is the
+     * number of values reserved for each column in the FixedStride
+     * layout; it is ignored for Packed.
+     */
+    DenseColumnStore(Layout layout, int stride);
+    ~DenseColumnStore();
+
+    Layout getLayout() const { return m_layout; }
+    int getStride() const { return m_stride; }
+
+    /**
+     * Change the stride. This is only possible while the store is
+     * empty; return false if it is not.
+     */
+    bool setStride(int stride);
+
+    /**
+     * Return the number of columns, i.e. one more than the index of
+     * the highest column set so far.
+     */
+    int getWidth() const { return m_lengths.size(); }
+
+    /**
+     * Return the number of values stored for column x, or 0 if x is
+     * out of range or was never set.
+     */
+    int getColumnLength(int x) const;
+
+    /**
+     * Store the given values as column x, replacing any existing
+     * column there. Columns between the current width and x are
+     * created empty.
+     */
+    void setColumn(int x, const Column &values);
+
+    /**
+     * Return the values stored for column x, or an empty column if
+     * there are none.
+     */
+    Column getColumn(int x) const;
+
+    /**
+     * Return the value at index n in column x, or the given default
+     * if the column is not long enough or does not exist.
+     */
+    float getValueAt(int x, int n, float deflt = 0.f) const;
+
+    /**
+     * Write the values at index n from count consecutive columns
+     * starting at column x0 into the given array. A column that is
+     * not long enough, or does not exist, supplies the default value.
+     */
+    void getRowSlice(int n, int x0, int count, float *values,
+                     float deflt = 0.f) const;
+
+    /**
+     * Discard all columns.
+     */
+    void clear();
+
+    /**
+     * Return an estimate of the number of bytes of memory in use.
+     * This excludes any chunks that have been paged out.
+     */
+    size_t getMemoryUsage() const;
+
+    /**
+     * Move all chunks but the most recently allocated few into the
+     * given file, and continue to do so as further chunks are
+     * allocated. The file is not owned by the store, and must outlive
+     * it. Pass 0 to stop paging out further chunks.
+     */
+    void setPageFile(MappedChunkFile *file);
+
+    bool isPaged() const { return m_pageFile != 0; }
+
+    /**
+     * If deferred is true, keep the heap copy of any chunk that is
+     * paged out until releaseRetired() is called, rather than freeing
+     * it straight away, in case a concurrent reader is still using
+     * it. If false (the default), release anything retired so far.
+     */
+    void setDeferredRelease(bool deferred);
+
+    /**
+     * Free the heap copies of chunks that have been paged out since
+     * the last call. Only call this when no concurrent reader can
+     * be using them.
+     */
+    void releaseRetired();
+
+private:
+    DenseColumnStore(const DenseColumnStore &); // not implemented
+    DenseColumnStore &operator=(const DenseColumnStore &); // not implemented
+
+    Layout m_layout;
+    int m_stride;
+    int m_columnsPerChunk;
+
+    // Readers may use m_lengths, m_chunks, m_overflow (with
+    // m_overflowMutex held), m_locations and m_packedData while a
+    // single writer appends. Everything else belongs to the writer
+
+    // Values stored per column. In FixedStride layout a length
+    // greater than the stride means the column is in m_overflow
+    SegmentedArray<int> m_lengths;
+
+    // FixedStride layout
+    SegmentedArray<std::atomic<float *>> m_chunks;
+    std::vector<bool> m_mapped;
+    std::map<int, Column> m_overflow;
+    mutable std::mutex m_overflowMutex;
+    float *getSlot(int x) const;
+    float *getOrCreateSlot(int x);
+
+    // Packed layout
+    struct Location {
+        int chunk;
+        int offset; // in values
+    };
+    SegmentedArray<Location> m_locations;
+    SegmentedArray<std::atomic<float *>> m_packedData;
+    struct PackedChunk {
+        int capacity;
+        int used;
+        bool mapped;
+    };
+    std::vector<PackedChunk> m_packed;
+    const float *getPacked(int x) const;
+
+    // Chunks still on the heap (indices into m_chunks or m_packed
+    // according to layout), in order of allocation
+    MappedChunkFile *m_pageFile;
+    std::deque<int> m_resident;
+    void pageOutColdChunks();
+
+    bool m_deferRelease;
+    std::vector<float *> m_retired;
+};
+
+#endif
@@ -15,10 +15,17 @@
 
 #include "EditableDenseThreeDimensionalModel.h"
 
+#include "MappedChunkFile.h"
+
 #include "base/LogRange.h"
+#include "base/StorageAdviser.h"
+#include "base/Exceptions.h"
 
 #include <QTextStream>
 #include <QStringList>
+#include <QXmlAttributes>
+#include <QByteArray>
+#include <QtEndian>
 #include <QReadLocker>
 #include <QWriteLocker>
 
@@ -26,6 +33,8 @@
 
 #include <cmath>
 #include <cassert>
+#include <cstring>
+#include <algorithm>
 
 using std::vector;
 
@@ -36,6 +45,16 @@ EditableDenseThreeDimensionalModel::EditableDenseThreeDimensionalModel(sv_sample
                                                                        int yBinCount,
                                                                        CompressionType compression,
                                                                        bool notifyOnAdd) :
+    m_data(compression == NoCompression ?
+           DenseColumnStore::FixedStride : DenseColumnStore::Packed,
+           yBinCount),
+    m_encoded(compression == HalfPrecisionCompression ?
+              EncodedColumnStore::HalfFloat : EncodedColumnStore::XorBlock),
+    m_pageFile(0),
+    m_nextStorageCheck(0),
+    m_appendOnly(false),
+    m_published(0),
+    m_lockFreeReaders(0),
     m_startFrame(0),
     m_sampleRate(sampleRate),
     m_resolution(resolution),
@@ -47,10 +66,23 @@ EditableDenseThreeDimensionalModel::EditableDenseThreeDimensionalModel(sv_sample
     m_notifyOnAdd(notifyOnAdd),
     m_sinceLastNotifyMin(-1),
     m_sinceLastNotifyMax(-1),
-    m_completion(100)
+    m_completion(100),
+    m_datasetEncoding(TextDataset)
 {
 }    
 
+EditableDenseThreeDimensionalModel::~EditableDenseThreeDimensionalModel()
+{
+    unregisterModel(this);
+
+    // Nobody can be reading any more, so there is no need to leave
+    // append-only mode properly. But do stop the stores referring to
+    // the page file before it goes
+    m_data.clear();
+    m_encoded.clear();
+    delete m_pageFile;
+}
+
 bool
 EditableDenseThreeDimensionalModel::isOK() const
 {
@@ -78,7 +110,7 @@ EditableDenseThreeDimensionalModel::setStartFrame(sv_frame_t f)
 sv_frame_t
 EditableDenseThreeDimensionalModel::getEndFrame() const
 {
-    return m_resolution * m_data.size() + (m_resolution - 1);
+    return m_resolution * sv_frame_t(getWidth()) + (m_resolution - 1);
 }
 
 int
@@ -96,7 +128,7 @@ EditableDenseThreeDimensionalModel::setResolution(int sz)
 int
 EditableDenseThreeDimensionalModel::getWidth() const
 {
-    return int(m_data.size());
+    return m_published.load(std::memory_order_acquire);
 }
 
 int
@@ -108,7 +140,11 @@ EditableDenseThreeDimensionalModel::getHeight() const
 void
 EditableDenseThreeDimensionalModel::setHeight(int sz)
 {
+    QWriteLocker locker(&m_lock);
+    if (m_appendOnly) leaveAppendOnly();
     m_yBinCount = sz;
+    // Only has any effect if nothing has been stored yet
+    m_data.setStride(sz);
 }
 
 float
@@ -138,30 +174,103 @@ EditableDenseThreeDimensionalModel::setMaximumLevel(float level)
 EditableDenseThreeDimensionalModel::Column
 EditableDenseThreeDimensionalModel::getColumn(int index) const
 {
+    LockFreeRead read(*this);
+    if (read.isActive()) return retrieveColumn(index);
+
     QReadLocker locker(&m_lock);
-    if (in_range_for(m_data, index)) return expandAndRetrieve(index);
+    return retrieveColumn(index);
+}
+
+EditableDenseThreeDimensionalModel::Column
+EditableDenseThreeDimensionalModel::retrieveColumn(int index) const
+{
+    if (index >= 0 && index < getWidth()) return expandAndRetrieve(index);
     else return Column();
 }
 
 float
 EditableDenseThreeDimensionalModel::getValueAt(int index, int n) const
 {
+    if (m_compression != BasicMultirateCompression) {
+        LockFreeRead read(*this);
+        if (read.isActive()) return retrieveValue(index, n);
+
+        QReadLocker locker(&m_lock);
+        return retrieveValue(index, n);
+    }
+    
     Column c = getColumn(index);
     if (in_range_for(c, n)) return c.at(n);
     return m_minimum;
 }
 
+float
+EditableDenseThreeDimensionalModel::retrieveValue(int index, int n) const
+{
+    // No need to retrieve the whole column. Values beyond the stored
+    // length of an existing column read as zero (as rightHeight would
+    // pad them), beyond the height as minimum
+    if (index < 0 || index >= getWidth() ||
+        n < 0 || n >= m_yBinCount) {
+        return m_minimum;
+    }
+    if (isEncoded()) return m_encoded.getValueAt(index, n, 0.f);
+    return m_data.getValueAt(index, n, 0.f);
+}
+
+EditableDenseThreeDimensionalModel::Column
+EditableDenseThreeDimensionalModel::getRowSlice(int n, int x0, int count) const
+{
+    if (count <= 0) return Column();
+
+    Column slice(count, m_minimum);
+    if (n < 0 || n >= m_yBinCount) return slice;
+
+    LockFreeRead read(*this);
+    if (read.isActive()) {
+        retrieveRowSlice(n, x0, slice);
+    } else {
+        QReadLocker locker(&m_lock);
+        retrieveRowSlice(n, x0, slice);
+    }
+
+    return slice;
+}
+
+void
+EditableDenseThreeDimensionalModel::retrieveRowSlice(int n, int x0,
+                                                     Column &slice) const
+{
+    int count = int(slice.size());
+    int width = getWidth();
+    int from = std::max(x0, 0);
+    int to = std::min(x0 + count, width);
+    if (from >= to) return;
+
+    if (m_compression == NoCompression) {
+        m_data.getRowSlice(n, from, to - from, slice.data() + (from - x0), 0.f);
+    } else if (isEncoded()) {
+        for (int x = from; x < to; ++x) {
+            slice[x - x0] = m_encoded.getValueAt(x, n, 0.f);
+        }
+    } else {
+        for (int x = from; x < to; ++x) {
+            slice[x - x0] = expandAndRetrieve(x).at(n);
+        }
+    }
+}
+
 //static int given = 0, stored = 0;
 
 void
 EditableDenseThreeDimensionalModel::truncateAndStore(int index,
                                                      const Column &values)
 {
-    assert(in_range_for(m_data, index));
+    assert(in_range_for(m_trunc, index));
 
     //cout << "truncateAndStore(" << index << ", " << values.size() << ")" << endl;
 
-    // The default case is to store the entire column at m_data[index]
+    // The default case is to store the entire column in m_data
     // and place 0 at m_trunc[index] to indicate that it has not been
     // truncated.  We only do clever stuff if one of the clever-stuff
     // tests works out.
@@ -172,7 +281,7 @@ EditableDenseThreeDimensionalModel::truncateAndStore(int index,
         int(values.size()) != m_yBinCount) {
 //        given += values.size();
 //        stored += values.size();
-        m_data[index] = values;
+        m_data.setColumn(index, values);
         return;
     }
 
@@ -236,7 +345,7 @@ EditableDenseThreeDimensionalModel::truncateAndStore(int index,
                 for (int i = bcount; i < h; ++i) {
                     tcol[i - bcount] = values.at(i);
                 }
-                m_data[index] = tcol;
+                m_data.setColumn(index, tcol);
                 m_trunc[index] = (signed char)(-tdist);
                 return;
             } else {
@@ -247,7 +356,7 @@ EditableDenseThreeDimensionalModel::truncateAndStore(int index,
                 for (int i = 0; i < h - tcount; ++i) {
                     tcol[i] = values.at(i);
                 }
-                m_data[index] = tcol;
+                m_data.setColumn(index, tcol);
                 m_trunc[index] = (signed char)(tdist);
                 return;
             }
@@ -260,7 +369,7 @@ EditableDenseThreeDimensionalModel::truncateAndStore(int index,
 //              << ((float(stored) / float(given)) * 100.f) << "%)" << endl;
 
     // default case if nothing wacky worked out
-    m_data[index] = values;
+    m_data.setColumn(index, values);
     return;
 }
 
@@ -280,9 +389,15 @@ EditableDenseThreeDimensionalModel::expandAndRetrieve(int index) const
 {
     // See comment above m_trunc declaration in header
 
-    assert(index >= 0 && index < int(m_data.size()));
-    Column c = m_data.at(index);
-    if (index == 0) {
+    if (isEncoded()) {
+        return rightHeight(m_encoded.getColumn(index));
+    }
+
+    assert(index >= 0 && index < m_data.getWidth());
+    Column c = m_data.getColumn(index);
+    if (index == 0 || m_compression == NoCompression) {
+        // Nothing is truncated, and m_trunc may be being resized by
+        // an append-only writer
         return rightHeight(c);
     }
     int trunc = (int)m_trunc[index];
@@ -314,15 +429,128 @@ EditableDenseThreeDimensionalModel::expandAndRetrieve(int index) const
     return c;
 }
 
+void
+EditableDenseThreeDimensionalModel::setAppendOnly(bool appendOnly)
+{
+    QWriteLocker locker(&m_lock);
+
+    if (!appendOnly) {
+        if (m_appendOnly) leaveAppendOnly();
+        return;
+    }
+
+    if (m_compression == BasicMultirateCompression) return;
+
+    m_data.setDeferredRelease(true);
+    m_encoded.setDeferredRelease(true);
+    m_appendOnly = true;
+}
+
+void
+EditableDenseThreeDimensionalModel::leaveAppendOnly()
+{
+    // From here on, new readers will take the lock, which we hold;
+    // wait for any that started before to finish
+    m_appendOnly = false;
+    {
+        QMutexLocker locker(&m_readersMutex);
+        while (m_lockFreeReaders > 0) {
+            m_readersDone.wait(&m_readersMutex);
+        }
+    }
+    m_data.setDeferredRelease(false);
+    m_encoded.setDeferredRelease(false);
+}
+
+void
+EditableDenseThreeDimensionalModel::lockFreeReadEnded() const
+{
+    // If the mode has been left, leaveAppendOnly may be waiting for
+    // this reader. It checks the count with m_readersMutex held, so
+    // taking that here means the wakeup can't be missed
+    if (--m_lockFreeReaders == 0 && !m_appendOnly) {
+        QMutexLocker locker(&m_readersMutex);
+        m_readersDone.wakeAll();
+    }
+}
+
+void
+EditableDenseThreeDimensionalModel::checkStorage()
+{
+    // Called from setColumn with the write lock held
+
+    // Check again after this many further columns
+    static const int checkInterval = 1024;
+
+    // Don't bother paging anything smaller than this (in K)
+    static const size_t minimumPagedSize = 64 * 1024;
+
+    m_nextStorageCheck = getWidth() + checkInterval;
+
+    if (m_pageFile) return;
+
+    size_t kb = (isEncoded() ?
+                 m_encoded.getMemoryUsage() :
+                 m_data.getMemoryUsage()) / 1024;
+    if (kb < minimumPagedSize) return;
+
+    // We don't know how much larger the model will get; assume it
+    // could double
+
+    StorageAdviser::Recommendation recommendation =
+        StorageAdviser::NoRecommendation;
+
+    try {
+        recommendation = StorageAdviser::recommend
+            (StorageAdviser::Criteria
+             (StorageAdviser::LongRetentionLikely |
+              StorageAdviser::FrequentLookupLikely),
+             kb, kb * 2);
+    } catch (const InsufficientDiscSpace &e) {
+        SVDEBUG << "EditableDenseThreeDimensionalModel::checkStorage: "
+                << e.what() << ", keeping data in memory" << endl;
+        return;
+    }
+
+    if (!(recommendation & (StorageAdviser::UseDisc |
+                            StorageAdviser::PreferDisc))) {
+        return;
+    }
+
+    try {
+        m_pageFile = new MappedChunkFile("dense3d");
+    } catch (const std::exception &e) {
+        SVDEBUG << "EditableDenseThreeDimensionalModel::checkStorage: "
+                << "Failed to create page file: " << e.what()
+                << ", keeping data in memory" << endl;
+        return;
+    }
+
+    SVDEBUG << "EditableDenseThreeDimensionalModel::checkStorage: "
+            << "paging model of " << kb << "K to "
+            << m_pageFile->getFileName() << endl;
+
+    if (isEncoded()) m_encoded.setPageFile(m_pageFile);
+    else m_data.setPageFile(m_pageFile);
+}
+
+EditableDenseThreeDimensionalModel::Column
+EditableDenseThreeDimensionalModel::getStoredColumn(int index) const
+{
+    // The column as stored, without expansion of truncated columns or
+    // adjustment to the model height
+    if (isEncoded()) return m_encoded.getColumn(index);
+    return m_data.getColumn(index);
+}
+
 void
 EditableDenseThreeDimensionalModel::setColumn(int index,
                                               const Column &values)
 {
     QWriteLocker locker(&m_lock);
 
-    while (index >= int(m_data.size())) {
-	m_data.push_back(Column());
-        m_trunc.push_back(0);
+    if (m_appendOnly && index < getWidth()) {
+        leaveAppendOnly();
     }
 
     bool allChange = false;
@@ -343,7 +571,33 @@ EditableDenseThreeDimensionalModel::setColumn(int index,
         m_haveExtents = true;
     }
 
-    truncateAndStore(index, values);
+    if (isEncoded()) {
+        m_encoded.setColumn(index, values);
+    } else {
+        if (index >= int(m_trunc.size())) {
+            m_trunc.resize(index + 1, 0);
+        }
+        truncateAndStore(index, values);
+    }
+
+    // Only now can readers see the new column
+    if (index >= getWidth()) {
+        m_published.store(index + 1, std::memory_order_release);
+    }
+
+    if (index >= m_nextStorageCheck) {
+        checkStorage();
+    }
+
+    if (m_appendOnly) {
+        // Free the heap copies of any chunks paged out, if nobody
+        // could still be reading them (see LockFreeRead)
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (m_lockFreeReaders == 0) {
+            m_data.releaseRetired();
+            m_encoded.releaseRetired();
+        }
+    }
 
 //    assert(values == expandAndRetrieve(index));
 
@@ -437,8 +691,8 @@ EditableDenseThreeDimensionalModel::shouldUseLogValueScale() const
     
     for (int i = 0; i < 10; ++i) {
         int index = i * 10;
-        if (in_range_for(m_data, index)) {
-            const Column &c = m_data.at(index);
+        if (index < getWidth()) {
+            const Column c = getStoredColumn(index);
             while (c.size() > sample.size()) {
                 sample.push_back(0.0);
                 n.push_back(0);
@@ -458,6 +712,19 @@ EditableDenseThreeDimensionalModel::shouldUseLogValueScale() const
     return LogRange::shouldUseLogScale(sample);
 }
 
+size_t
+EditableDenseThreeDimensionalModel::getMemoryUsage() const
+{
+    QReadLocker locker(&m_lock);
+
+    // The stores leave out anything paged out to m_pageFile
+    size_t bytes = (isEncoded() ?
+                    m_encoded.getMemoryUsage() :
+                    m_data.getMemoryUsage());
+    bytes += m_trunc.capacity() * sizeof(signed char);
+    return bytes;
+}
+
 void
 EditableDenseThreeDimensionalModel::setCompletion(int completion, bool update)
 {
@@ -491,10 +758,11 @@ EditableDenseThreeDimensionalModel::toDelimitedDataString(QString delimiter) con
 {
     QReadLocker locker(&m_lock);
     QString s;
-    for (int i = 0; in_range_for(m_data, i); ++i) {
+    for (int i = 0; i < getWidth(); ++i) {
         QStringList list;
-	for (int j = 0; in_range_for(m_data.at(i), j); ++j) {
-            list << QString("%1").arg(m_data.at(i).at(j));
+        Column c = getStoredColumn(i);
+	for (int j = 0; in_range_for(c, j); ++j) {
+            list << QString("%1").arg(c.at(j));
         }
         s += list.join(delimiter) + "\n";
     }
@@ -506,12 +774,13 @@ EditableDenseThreeDimensionalModel::toDelimitedDataStringSubset(QString delimite
 {
     QReadLocker locker(&m_lock);
     QString s;
-    for (int i = 0; in_range_for(m_data, i); ++i) {
+    for (int i = 0; i < getWidth(); ++i) {
         sv_frame_t fr = m_startFrame + i * m_resolution;
         if (fr >= f0 && fr < f1) {
             QStringList list;
-            for (int j = 0; in_range_for(m_data.at(i), j); ++j) {
-                list << QString("%1").arg(m_data.at(i).at(j));
+            Column c = getStoredColumn(i);
+            for (int j = 0; in_range_for(c, j); ++j) {
+                list << QString("%1").arg(c.at(j));
             }
             s += list.join(delimiter) + "\n";
         }
@@ -553,18 +822,137 @@ EditableDenseThreeDimensionalModel::toXml(QTextStream &out,
 	}
     }
 
-    for (int i = 0; i < (int)m_data.size(); ++i) {
-	out << indent + "  ";
-	out << QString("<row n=\"%1\">").arg(i);
-	for (int j = 0; j < (int)m_data.at(i).size(); ++j) {
-	    if (j > 0) out << " ";
-	    out << m_data.at(i).at(j);
-	}
-	out << QString("</row>\n");
-        out.flush();
+    if (m_datasetEncoding == BinaryDataset) {
+        writeBinaryRows(out, indent + "  ");
+    } else {
+        for (int i = 0; i < getWidth(); ++i) {
+            out << indent + "  ";
+            out << QString("<row n=\"%1\">").arg(i);
+            Column c = getStoredColumn(i);
+            for (int j = 0; j < (int)c.size(); ++j) {
+                if (j > 0) out << " ";
+                out << c.at(j);
+            }
+            out << QString("</row>\n");
+            out.flush();
+        }
     }
 
     out << indent + "</dataset>\n";
 }
 
+// Number of columns in each "rows" element of a binary dataset
+static const int binaryRowsPerBlock = 256;
+
+void
+EditableDenseThreeDimensionalModel::writeBinaryRows(QTextStream &out,
+                                                    QString indent) const
+{
+    // Each block holds, for each of its columns, the number of values
+    // as a little-endian 32-bit unsigned integer followed by the
+    // values as little-endian 32-bit floats. If compressing the block
+    // with qCompress (zlib deflate preceded by the uncompressed size
+    // as a big-endian 32-bit integer) saves at least a tenth, we
+    // write that instead and say so in the "compression" attribute
+
+    int width = getWidth();
+    QByteArray block;
+
+    for (int i0 = 0; i0 < width; i0 += binaryRowsPerBlock) {
+
+        int count = std::min(binaryRowsPerBlock, width - i0);
+        block.clear();
+
+        for (int i = i0; i < i0 + count; ++i) {
+            Column c = getStoredColumn(i);
+            int offset = block.size();
+            block.resize(offset + 4 * (int(c.size()) + 1));
+            uchar *p = reinterpret_cast<uchar *>(block.data()) + offset;
+            qToLittleEndian<quint32>(quint32(c.size()), p);
+            p += 4;
+            for (float v : c) {
+                quint32 bits;
+                memcpy(&bits, &v, 4);
+                qToLittleEndian<quint32>(bits, p);
+                p += 4;
+            }
+        }
+
+        QByteArray compressed = qCompress(block);
+        bool useCompressed = (compressed.size() < block.size() - block.size() / 10);
+
+        out << indent;
+        out << QString("<rows n=\"%1\" count=\"%2\" encoding=\"base64\"%3>")
+            .arg(i0).arg(count)
+            .arg(useCompressed ? " compression=\"qcompress\"" : "");
+        out << QString::fromLatin1
+            ((useCompressed ? compressed : block).toBase64());
+        out << "</rows>\n";
+        out.flush();
+    }
+}
+
+bool
+EditableDenseThreeDimensionalModel::setColumnsFromXml(const QXmlAttributes &attributes,
+                                                      const QString &data)
+{
+    bool ok = false;
+    int n = attributes.value("n").trimmed().toInt(&ok);
+    if (!ok || n < 0) return false;
+    int count = attributes.value("count").trimmed().toInt(&ok);
+    if (!ok || count < 0) return false;
+
+    if (attributes.value("encoding") != "base64") {
+        SVDEBUG << "EditableDenseThreeDimensionalModel::setColumnsFromXml: Unsupported encoding \"" << attributes.value("encoding") << "\"" << endl;
+        return false;
+    }
+
+    QByteArray block = QByteArray::fromBase64(data.toLatin1());
+
+    QString compression = attributes.value("compression");
+    if (compression == "qcompress") {
+        block = qUncompress(block);
+        if (block.isEmpty() && count > 0) return false;
+    } else if (compression != "") {
+        SVDEBUG << "EditableDenseThreeDimensionalModel::setColumnsFromXml: Unsupported compression \"" << compression << "\"" << endl;
+        return false;
+    }
+
+    // Decode the whole block before setting anything, so that a
+    // malformed one leaves the model unchanged
+    
+    std::vector<Column> columns(count);
+    const uchar *p = reinterpret_cast<const uchar *>(block.constData());
+    const uchar *end = p + block.size();
+
+    for (int i = 0; i < count; ++i) {
+        if (end - p < 4) return false;
+        quint32 size = qFromLittleEndian<quint32>(p);
+        p += 4;
+        if (quint32(end - p) / 4 < size) return false;
+        Column &c = columns[i];
+        c.resize(size);
+        for (quint32 j = 0; j < size; ++j) {
+            quint32 bits = qFromLittleEndian<quint32>(p);
+            memcpy(&c[j], &bits, 4);
+            p += 4;
+        }
+    }
+
+    if (p != end) return false;
+
+    for (int i = 0; i < count; ++i) {
+        setColumn(n + i, columns[i]);
+    }
+
+    return true;
+}
+
+void
+EditableDenseThreeDimensionalModel::setDatasetEncoding(DatasetEncoding encoding)
+{
+    QWriteLocker locker(&m_lock);
+    m_datasetEncoding = encoding;
+}
+
 
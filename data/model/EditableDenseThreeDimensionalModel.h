@@ -17,10 +17,18 @@
 #define _EDITABLE_DENSE_THREE_DIMENSIONAL_MODEL_H_
 
 #include "DenseThreeDimensionalModel.h"
+#include "DenseColumnStore.h"
+#include "EncodedColumnStore.h"
 
 #include <QReadWriteLock>
+#include <QMutex>
+#include <QWaitCondition>
 
 #include <vector>
+#include <atomic>
+
+class MappedChunkFile;
+class QXmlAttributes;
 
 class EditableDenseThreeDimensionalModel : public DenseThreeDimensionalModel
 {
@@ -35,11 +43,23 @@ public:
     // whose columns are set in order from 0 and never subsequently
     // changed.  If the model is going to be actually edited, it must
     // have NoCompression.
+    //
+    // The other compression types do not have that restriction, and
+    // retrieve each column without reference to any but (at most) one
+    // other. HalfPrecisionCompression stores values as 16-bit floats,
+    // halving the size of the model at the expense of precision (see
+    // EncodedColumnStore for the bounds); it is suitable for outputs
+    // that are primarily for display. DeltaBlockCompression is
+    // lossless, coding each column against the first column in its
+    // block of neighbours, and does best with data that changes
+    // little from one column to the next.
 
     enum CompressionType
     {
         NoCompression,
-        BasicMultirateCompression
+        BasicMultirateCompression,
+        HalfPrecisionCompression,
+        DeltaBlockCompression
     };
 
     EditableDenseThreeDimensionalModel(sv_samplerate_t sampleRate,
@@ -47,6 +67,7 @@ public:
 				       int height,
                                        CompressionType compression,
 				       bool notifyOnAdd = true);
+    virtual ~EditableDenseThreeDimensionalModel();
 
     virtual bool isOK() const;
 
@@ -121,6 +142,26 @@ public:
      */
     virtual float getValueAt(int x, int n) const;
 
+    /**
+     * Get the values from the n'th bin of count consecutive columns
+     * starting at column x0. Columns that do not exist give the
+     * minimum level, as for getValueAt.
+     */
+    virtual Column getRowSlice(int n, int x0, int count) const;
+
+    /**
+     * Declare that, until further notice, columns will only be added
+     * by a single thread and each beyond the last one (as when a
+     * transform is writing its output). While this is so, getColumn,
+     * getValueAt and getRowSlice take no lock, and columns become
+     * visible to them only once completely stored. Replacing an
+     * existing column, or changing the height, ends the mode.
+     *
+     * This has no effect with BasicMultirateCompression, for which
+     * retrieving a column depends on state the writer may be changing.
+     */
+    void setAppendOnly(bool appendOnly);
+
     /**
      * Set the entire set of bin values at the given column.
      */
@@ -188,16 +229,112 @@ public:
 
     QString getTypeName() const { return tr("Editable Dense 3-D"); }
 
+    virtual size_t getMemoryUsage() const;
+
     virtual QString toDelimitedDataString(QString delimiter) const;
     virtual QString toDelimitedDataStringSubset(QString delimiter, sv_frame_t f0, sv_frame_t f1) const;
 
+    /**
+     * Dataset encodings for toXml. TextDataset, the default, writes
+     * each column as a "row" element of decimal values separated by
+     * spaces, as older versions did. BinaryDataset writes blocks of
+     * columns as "rows" elements, each containing little-endian
+     * 32-bit floats in base64, compressed where that makes them
+     * usefully smaller. This is exact, and smaller and faster to
+     * write and read than text, but can only be read back by a
+     * session loader that passes "rows" elements to
+     * setColumnsFromXml.
+     *
+     * Nothing in this library selects BinaryDataset or calls
+     * setColumnsFromXml: the session writer and reader belong to the
+     * application, and must opt in to both before the encoding is
+     * used for real sessions.
+     */
+    enum DatasetEncoding
+    {
+        TextDataset,
+        BinaryDataset
+    };
+
+    void setDatasetEncoding(DatasetEncoding encoding);
+    DatasetEncoding getDatasetEncoding() const { return m_datasetEncoding; }
+
     virtual void toXml(QTextStream &out,
                        QString indent = "",
                        QString extraAttributes = "") const;
 
+    /**
+     * Decode a block of columns written by toXml with BinaryDataset
+     * encoding, given the attributes and text content of its "rows"
+     * element, and set them into this model. Return false, setting
+     * no columns, if the attributes are not understood or the data
+     * is malformed. (Columns written as TextDataset are read by
+     * splitting each row and calling setColumn as before.) Each
+     * "rows" element holds at most 256 columns, so a loader calling
+     * this as each element ends never decodes more than that at once.
+     */
+    bool setColumnsFromXml(const QXmlAttributes &attributes,
+                           const QString &data);
+
 protected:
-    typedef std::vector<Column> ValueMatrix;
-    ValueMatrix m_data;
+    // With NoCompression, columns are stored at a fixed stride of the
+    // model height; with BasicMultirateCompression, they are packed
+    // end to end. The other compression types use m_encoded instead
+    DenseColumnStore m_data;
+    EncodedColumnStore m_encoded;
+    bool isEncoded() const {
+        return m_compression == HalfPrecisionCompression ||
+            m_compression == DeltaBlockCompression;
+    }
+    Column getStoredColumn(int index) const;
+
+    void writeBinaryRows(QTextStream &out, QString indent) const; // call with m_lock held
+
+    // Once the model grows large, the StorageAdviser is consulted
+    // periodically; if it recommends disc, older chunks of the store
+    // are paged out to m_pageFile
+    MappedChunkFile *m_pageFile;
+    int m_nextStorageCheck;
+    void checkStorage();
+
+    // m_published is the width of the model as seen by readers,
+    // updated by setColumn once a column is completely stored. In
+    // append-only mode (see setAppendOnly) readers of columns take no
+    // lock, and m_lockFreeReaders counts those in progress so that
+    // the writer can wait for them before leaving the mode. The last
+    // to finish after the mode has been left signals m_readersDone
+    std::atomic<bool> m_appendOnly;
+    std::atomic<int> m_published;
+    mutable std::atomic<int> m_lockFreeReaders;
+    mutable QMutex m_readersMutex;
+    mutable QWaitCondition m_readersDone;
+    void leaveAppendOnly(); // call with m_lock held for writing
+    void lockFreeReadEnded() const;
+
+    class LockFreeRead
+    {
+    public:
+        LockFreeRead(const EditableDenseThreeDimensionalModel &model) :
+            m_model(model), m_active(false) {
+            if (!m_model.m_appendOnly) return;
+            ++m_model.m_lockFreeReaders;
+            // pairs with the fence in setColumn before releaseRetired
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if (m_model.m_appendOnly) m_active = true;
+            else m_model.lockFreeReadEnded();
+        }
+        ~LockFreeRead() {
+            if (m_active) m_model.lockFreeReadEnded();
+        }
+        bool isActive() const { return m_active; }
+    private:
+        const EditableDenseThreeDimensionalModel &m_model;
+        bool m_active;
+    };
+
+    Column retrieveColumn(int index) const;
+    float retrieveValue(int index, int n) const;
+    void retrieveRowSlice(int n, int x0, Column &slice) const;
 
     // m_trunc is used for simple compression.  If at least the top N
     // elements of column x (for N = some proportion of the column
@@ -228,6 +365,7 @@ protected:
     sv_frame_t m_sinceLastNotifyMin;
     sv_frame_t m_sinceLastNotifyMax;
     int m_completion;
+    DatasetEncoding m_datasetEncoding;
 
     mutable QReadWriteLock m_lock;
 };
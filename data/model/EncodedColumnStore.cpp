@@ -0,0 +1,446 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+
+/*
+    Sonic Visualiser
+    An audio file viewer and annotation editor.
+    Centre for Digital Music, Queen Mary, University of London.
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation; either version 2 of the
+    License, or (at your option) any later version.  See the file
+    COPYING included with this distribution for more information.
+*/
+
+#include "EncodedColumnStore.h"
+#include "MappedChunkFile.h"
+
+#include "base/Debug.h"
+
+#include <bqvec/Allocators.h>
+
+#include <algorithm>
+#include <cstring>
+
+using namespace std;
+
+// Aim for chunks of about this many bytes
+static const int chunkBytes = 262144;
+
+// When paging, keep this many of the most recently allocated chunks
+// on the heap
+static const int hotChunks = 16;
+
+static inline uint32_t
+floatBits(float f)
+{
+    uint32_t b;
+    memcpy(&b, &f, sizeof(b));
+    return b;
+}
+
+static inline float
+bitsFloat(uint32_t b)
+{
+    float f;
+    memcpy(&f, &b, sizeof(f));
+    return f;
+}
+
+// Number of bytes needed to hold b once its leading zero bytes are
+// dropped
+static inline int
+significantBytes(uint32_t b)
+{
+    if (b == 0) return 0;
+    if (b < 0x100u) return 1;
+    if (b < 0x10000u) return 2;
+    if (b < 0x1000000u) return 3;
+    return 4;
+}
+
+EncodedColumnStore::EncodedColumnStore(Encoding encoding) :
+    m_encoding(encoding),
+    m_pageFile(0),
+    m_deferRelease(false)
+{
+}
+
+EncodedColumnStore::~EncodedColumnStore()
+{
+    clear();
+}
+
+void
+EncodedColumnStore::clear()
+{
+    for (int i = 0; i < m_chunkData.size(); ++i) {
+        if (!m_chunks[i].mapped) breakfastquay::deallocate(m_chunkData[i].load());
+    }
+    m_chunkData.clear();
+    m_chunks.clear();
+    m_resident.clear();
+    releaseRetired();
+    m_locations.clear();
+    m_lengths.clear();
+}
+
+int
+EncodedColumnStore::getColumnLength(int x) const
+{
+    if (x < 0 || x >= m_lengths.size()) return 0;
+    return m_lengths[x];
+}
+
+uint16_t
+EncodedColumnStore::toHalf(float f)
+{
+    uint32_t b = floatBits(f);
+    uint16_t sign = uint16_t((b >> 16) & 0x8000u);
+    uint32_t abs = b & 0x7fffffffu;
+
+    if (abs >= 0x7f800000u) {
+        // infinity, or NaN (keeping it quiet)
+        return uint16_t(sign | 0x7c00u | (abs > 0x7f800000u ? 0x200u : 0u));
+    }
+
+    if (abs >= 0x477ff000u) {
+        // 65520 or more, which would round to infinity: clamp to the
+        // largest finite half. Values just below this round to 65504
+        // in the normal case below
+        return uint16_t(sign | 0x7bffu);
+    }
+
+    if (abs < 0x38800000u) {
+        // below 2^-14, subnormal in half precision
+        if (abs < 0x33000000u) return sign; // below 2^-25, rounds to 0
+        uint32_t mantissa = (abs & 0x7fffffu) | 0x800000u;
+        int shift = 126 - int(abs >> 23);
+        uint32_t h = mantissa >> shift;
+        uint32_t rem = mantissa & ((1u << shift) - 1);
+        uint32_t halfway = 1u << (shift - 1);
+        if (rem > halfway || (rem == halfway && (h & 1u))) ++h;
+        return uint16_t(sign | h);
+    }
+
+    // Normal: rebias the exponent from 127 to 15 and round the
+    // mantissa to nearest, ties to even. A carry out of the mantissa
+    // correctly increments the exponent
+    uint32_t h = (abs - 0x38000000u) >> 13;
+    uint32_t rem = abs & 0x1fffu;
+    if (rem > 0x1000u || (rem == 0x1000u && (h & 1u))) ++h;
+    return uint16_t(sign | h);
+}
+
+float
+EncodedColumnStore::fromHalf(uint16_t h)
+{
+    uint32_t sign = uint32_t(h & 0x8000u) << 16;
+    uint32_t exponent = (h >> 10) & 0x1fu;
+    uint32_t mantissa = h & 0x3ffu;
+
+    if (exponent == 0) {
+        float f = float(mantissa) * (1.f / 16777216.f); // 2^-24
+        return sign ? -f : f;
+    }
+    if (exponent == 31) {
+        return bitsFloat(sign | 0x7f800000u | (mantissa << 13));
+    }
+    return bitsFloat(sign | ((exponent + 112) << 23) | (mantissa << 13));
+}
+
+const unsigned char *
+EncodedColumnStore::getBytes(int x) const
+{
+    const Location &loc = m_locations[x];
+    if (loc.chunk < 0) return 0;
+    return m_chunkData[loc.chunk].load(memory_order_acquire) + loc.offset;
+}
+
+void
+EncodedColumnStore::store(int x, const Bytes &bytes, bool plain)
+{
+    Location &loc = m_locations[x];
+    int size = int(bytes.size());
+
+    if (size == 0) {
+        loc = { -1, 0, 0, plain };
+        return;
+    }
+
+    if (loc.chunk >= 0 && size <= loc.size) {
+        // overwrite in place
+        copy(bytes.begin(), bytes.end(),
+             m_chunkData[loc.chunk].load() + loc.offset);
+        loc.size = size;
+        loc.plain = plain;
+        return;
+    }
+
+    if (m_chunks.empty() ||
+        m_chunks.back().capacity - m_chunks.back().used < size) {
+        int capacity = max(size, chunkBytes);
+        m_chunkData.push_back(breakfastquay::allocate<unsigned char>(capacity));
+        m_chunks.push_back({ capacity, 0, false });
+        m_resident.push_back(int(m_chunks.size()) - 1);
+        pageOutColdChunks();
+    }
+
+    int c = int(m_chunks.size()) - 1;
+    Chunk &chunk = m_chunks[c];
+    loc = { c, chunk.used, size, plain };
+    copy(bytes.begin(), bytes.end(), m_chunkData[c].load() + chunk.used);
+    chunk.used += size;
+}
+
+uint32_t
+EncodedColumnStore::getKeyBits(int key, int n) const
+{
+    // Key columns are always stored plain
+    if (n >= getColumnLength(key)) return 0;
+    uint32_t b;
+    memcpy(&b, getBytes(key) + size_t(n) * 4, 4);
+    return b;
+}
+
+void
+EncodedColumnStore::encodeXor(int x, const Column &values, Bytes &bytes,
+                              bool &plain) const
+{
+    int n = int(values.size());
+    int key = x - x % blockSize;
+
+    bytes.clear();
+
+    if (x != key) {
+
+        // A nibble per value giving its number of bytes, then the
+        // bytes themselves, least significant first
+        bytes.resize((n + 1) / 2, 0);
+
+        for (int i = 0; i < n; ++i) {
+            uint32_t b = floatBits(values[i]) ^ getKeyBits(key, i);
+            int sz = significantBytes(b);
+            bytes[i / 2] |= (unsigned char)(sz << ((i % 2) * 4));
+            for (int j = 0; j < sz; ++j) {
+                bytes.push_back((unsigned char)(b >> (j * 8)));
+            }
+            if (int(bytes.size()) >= n * 4) break; // not worth it
+        }
+
+        if (int(bytes.size()) < n * 4) {
+            plain = false;
+            return;
+        }
+    }
+
+    plain = true;
+    bytes.resize(size_t(n) * 4);
+    if (n > 0) memcpy(bytes.data(), values.data(), size_t(n) * 4);
+}
+
+void
+EncodedColumnStore::decodeXor(int x, Column &values) const
+{
+    int n = getColumnLength(x);
+    values.resize(n);
+    if (n == 0) return;
+
+    const unsigned char *bytes = getBytes(x);
+
+    if (m_locations[x].plain) {
+        memcpy(values.data(), bytes, size_t(n) * 4);
+        return;
+    }
+
+    int key = x - x % blockSize;
+    const unsigned char *data = bytes + (n + 1) / 2;
+
+    for (int i = 0; i < n; ++i) {
+        int sz = (bytes[i / 2] >> ((i % 2) * 4)) & 0xf;
+        uint32_t b = 0;
+        for (int j = 0; j < sz; ++j) {
+            b |= uint32_t(*data++) << (j * 8);
+        }
+        values[i] = bitsFloat(b ^ getKeyBits(key, i));
+    }
+}
+
+void
+EncodedColumnStore::setColumn(int x, const Column &values)
+{
+    if (x < 0) return;
+
+    if (x >= m_lengths.size()) {
+        Location none = { -1, 0, 0, true };
+        m_locations.resize(x + 1, none);
+        m_lengths.resize(x + 1, 0);
+    }
+
+    int n = int(values.size());
+    Bytes bytes;
+
+    if (m_encoding == HalfFloat) {
+        bytes.resize(size_t(n) * 2);
+        for (int i = 0; i < n; ++i) {
+            uint16_t h = toHalf(values[i]);
+            memcpy(bytes.data() + size_t(i) * 2, &h, 2);
+        }
+        m_lengths[x] = n;
+        store(x, bytes, true);
+        return;
+    }
+
+    int key = x - x % blockSize;
+    bool plain = true;
+
+    if (x != key) {
+        encodeXor(x, values, bytes, plain);
+        m_lengths[x] = n;
+        store(x, bytes, plain);
+        return;
+    }
+
+    // Replacing a key column: the other columns in the block must be
+    // decoded against the old key and re-encoded against the new one
+
+    vector<pair<int, Column>> others;
+    int end = min(getWidth(), key + blockSize);
+    for (int j = key + 1; j < end; ++j) {
+        if (m_lengths[j] > 0) {
+            others.push_back({ j, Column() });
+            decodeXor(j, others.back().second);
+        }
+    }
+
+    encodeXor(x, values, bytes, plain);
+    m_lengths[x] = n;
+    store(x, bytes, plain);
+
+    for (const auto &other : others) {
+        encodeXor(other.first, other.second, bytes, plain);
+        store(other.first, bytes, plain);
+    }
+}
+
+EncodedColumnStore::Column
+EncodedColumnStore::getColumn(int x) const
+{
+    int n = getColumnLength(x);
+    if (n == 0) return Column();
+
+    Column values;
+
+    if (m_encoding == HalfFloat) {
+        const unsigned char *bytes = getBytes(x);
+        values.resize(n);
+        for (int i = 0; i < n; ++i) {
+            uint16_t h;
+            memcpy(&h, bytes + size_t(i) * 2, 2);
+            values[i] = fromHalf(h);
+        }
+    } else {
+        decodeXor(x, values);
+    }
+
+    return values;
+}
+
+float
+EncodedColumnStore::getValueAt(int x, int n, float deflt) const
+{
+    if (n < 0 || n >= getColumnLength(x)) return deflt;
+
+    const unsigned char *bytes = getBytes(x);
+
+    if (m_encoding == HalfFloat) {
+        uint16_t h;
+        memcpy(&h, bytes + size_t(n) * 2, 2);
+        return fromHalf(h);
+    }
+
+    if (m_locations[x].plain) {
+        float f;
+        memcpy(&f, bytes + size_t(n) * 4, 4);
+        return f;
+    }
+
+    // Skip the bytes of the values before this one
+    int len = m_lengths[x];
+    const unsigned char *data = bytes + (len + 1) / 2;
+    for (int i = 0; i < n; ++i) {
+        data += (bytes[i / 2] >> ((i % 2) * 4)) & 0xf;
+    }
+    int sz = (bytes[n / 2] >> ((n % 2) * 4)) & 0xf;
+    uint32_t b = 0;
+    for (int j = 0; j < sz; ++j) {
+        b |= uint32_t(data[j]) << (j * 8);
+    }
+    return bitsFloat(b ^ getKeyBits(x - x % blockSize, n));
+}
+
+size_t
+EncodedColumnStore::getMemoryUsage() const
+{
+    size_t total = sizeof(*this);
+    total += m_lengths.getAllocatedSize();
+    total += m_locations.getAllocatedSize();
+    for (const Chunk &chunk : m_chunks) {
+        if (!chunk.mapped) total += size_t(chunk.capacity);
+    }
+    total += m_chunkData.getAllocatedSize();
+    total += m_chunks.capacity() * sizeof(Chunk);
+    return total;
+}
+
+void
+EncodedColumnStore::setPageFile(MappedChunkFile *file)
+{
+    m_pageFile = file;
+    pageOutColdChunks();
+}
+
+void
+EncodedColumnStore::pageOutColdChunks()
+{
+    while (m_pageFile && int(m_resident.size()) > hotChunks) {
+
+        int c = m_resident.front();
+        Chunk &chunk = m_chunks[c];
+
+        if (chunk.used > 0) {
+            unsigned char *heap = m_chunkData[c].load();
+            void *mapped = m_pageFile->append(heap, size_t(chunk.used));
+            if (!mapped) {
+                SVDEBUG << "WARNING: EncodedColumnStore::pageOutColdChunks: Failed to page out chunk, keeping remaining chunks in memory" << endl;
+                m_pageFile = 0;
+                return;
+            }
+            m_chunkData[c].store(static_cast<unsigned char *>(mapped),
+                                 memory_order_release);
+            if (m_deferRelease) m_retired.push_back(heap);
+            else breakfastquay::deallocate(heap);
+            chunk.mapped = true;
+            // A paged-out chunk takes no further columns
+            chunk.capacity = chunk.used;
+        }
+
+        m_resident.pop_front();
+    }
+}
+
+void
+EncodedColumnStore::setDeferredRelease(bool deferred)
+{
+    m_deferRelease = deferred;
+    if (!deferred) releaseRetired();
+}
+
+void
+EncodedColumnStore::releaseRetired()
+{
+    for (unsigned char *chunk : m_retired) {
+        breakfastquay::deallocate(chunk);
+    }
+    m_retired.clear();
+}
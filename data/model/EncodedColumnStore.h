@@ -0,0 +1,201 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+
+/*
+    Sonic Visualiser
+    An audio file viewer and annotation editor.
+    Centre for Digital Music, Queen Mary, University of London.
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation; either version 2 of the
+    License, or (at your option) any later version.  See the file
+    COPYING included with this distribution for more information.
+*/
+
+#ifndef SV_ENCODED_COLUMN_STORE_H
+#define SV_ENCODED_COLUMN_STORE_H
+
+#include "base/SegmentedArray.h"
+
+#include <vector>
+#include <deque>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+class MappedChunkFile;
+
+/**
+ * Backing store for the columns of a dense three-dimensional grid of
+ * floats that holds each column in an encoded form, taking less space
+ * than DenseColumnStore. There are two encodings:
+ *
+ * HalfFloat stores each value as an IEEE 754 half-precision float.
+ * This is lossy: values with magnitude between 2^-14 and 65504 are
+ * stored with a relative error of at most 2^-11, and smaller values
+ * with an absolute error of at most 2^-25. Values below 65520 in
+ * magnitude round to at most 65504, and those of 65520 or more, which
+ * would round to infinity, are clamped to +/-65504. Infinities and
+ * NaNs are preserved.
+ *
+ * XorBlock is lossless. Columns are grouped into blocks of blockSize,
+ * and the first column of each block (the key column) is stored as it
+ * is. Every other column is stored as the bitwise XOR of its values
+ * with those of the key column, with the leading zero bytes of each
+ * result dropped. Neighbouring columns of feature data often have
+ * values that are equal, or close enough to share their sign, exponent
+ * and leading mantissa bits, and those take little or no space. A
+ * column that does not encode smaller than its plain size is stored
+ * plain instead.
+ *
+ * Either way, retrieving a column takes time proportional to its
+ * height only. Columns may be set in any order and replaced, although
+ * replacing a column leaves its previous space unused, and replacing
+ * a key column means re-encoding the rest of its block.
+ *
+ * As with DenseColumnStore, older chunks can be paged out to a
+ * memory-mapped file (see setPageFile).
+ *
+ * A column that was never set reads as empty. The same rules about
+ * thread safety apply as for DenseColumnStore: the owner must
+ * serialise access, except that while a single writer only appends
+ * columns, other threads may read columns whose completion the owner
+ * has published.
+ */
+class EncodedColumnStore
+{
+public:
+    typedef std::vector<float> Column;
+
+    enum Encoding {
+        HalfFloat,
+        XorBlock
+    };
+
+    static const int blockSize = 64;
+
+    EncodedColumnStore(Encoding encoding);
+    ~EncodedColumnStore();
+
+    Encoding getEncoding() const { return m_encoding; }
+
+    /**
+     * Return the number of columns, i.e. one more than the index of
+     * the highest column set so far.
+     */
+    int getWidth() const { return m_lengths.size(); }
+
+    /**
+     * Return the number of values stored for column x, or 0 if x is
+     * out of range or was never set.
+     */
+    int getColumnLength(int x) const;
+
+    /**
+     * Store the given values as column x, replacing any existing
+     * column there. Columns between the current width and x are
+     * created empty.
+     */
+    void setColumn(int x, const Column &values);
+
+    /**
+     * Return the values stored for column x, or an empty column if
+     * there are none.
+     */
+    Column getColumn(int x) const;
+
+    /**
+     * Return the value at index n in column x, or the given default
+     * if the column is not long enough or does not exist.
+     */
+    float getValueAt(int x, int n, float deflt = 0.f) const;
+
+    /**
+     * Discard all columns.
+     */
+    void clear();
+
+    /**
+     * Return an estimate of the number of bytes of memory in use.
+     * This excludes any chunks that have been paged out.
+     */
+    size_t getMemoryUsage() const;
+
+    /**
+     * Move all chunks but the most recently allocated few into the
+     * given file, and continue to do so as further chunks are
+     * allocated. The file is not owned by the store, and must outlive
+     * it. Pass 0 to stop paging out further chunks.
+     */
+    void setPageFile(MappedChunkFile *file);
+
+    bool isPaged() const { return m_pageFile != 0; }
+
+    /**
+     * As DenseColumnStore::setDeferredRelease.
+     */
+    void setDeferredRelease(bool deferred);
+
+    /**
+     * As DenseColumnStore::releaseRetired.
+     */
+    void releaseRetired();
+
+    /**
+     * Convert a float to the nearest half-precision value, clamping
+     * finite values that are out of range.
+     */
+    static uint16_t toHalf(float f);
+
+    /**
+     * Convert a half-precision value to float. This is exact.
+     */
+    static float fromHalf(uint16_t h);
+
+private:
+    EncodedColumnStore(const EncodedColumnStore &); // not implemented
+    EncodedColumnStore &operator=(const EncodedColumnStore &); // not implemented
+
+    typedef std::vector<unsigned char> Bytes;
+
+    Encoding m_encoding;
+
+    // Readers may use m_lengths, m_locations and m_chunkData while a
+    // single writer appends. Everything else belongs to the writer
+
+    SegmentedArray<int> m_lengths;
+
+    struct Location {
+        int chunk; // -1 if the column is empty
+        int offset; // in bytes
+        int size; // in bytes
+        bool plain; // XorBlock only: stored without XOR coding
+    };
+    SegmentedArray<Location> m_locations;
+
+    SegmentedArray<std::atomic<unsigned char *>> m_chunkData;
+    struct Chunk {
+        int capacity;
+        int used;
+        bool mapped;
+    };
+    std::vector<Chunk> m_chunks;
+
+    // Indices of chunks still on the heap, in order of allocation
+    MappedChunkFile *m_pageFile;
+    std::deque<int> m_resident;
+    void pageOutColdChunks();
+
+    bool m_deferRelease;
+    std::vector<unsigned char *> m_retired;
+
+    void store(int x, const Bytes &bytes, bool plain);
+    const unsigned char *getBytes(int x) const;
+
+    void encodeXor(int x, const Column &values, Bytes &bytes,
+                   bool &plain) const;
+    void decodeXor(int x, Column &values) const;
+    uint32_t getKeyBits(int key, int n) const;
+};
+
+#endif
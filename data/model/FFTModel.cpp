@@ -62,10 +62,13 @@ FFTModel::FFTModel(const DenseTimeValueModel *model,
     connect(model, SIGNAL(modelChanged()), this, SIGNAL(modelChanged()));
     connect(model, SIGNAL(modelChangedWithin(sv_frame_t, sv_frame_t)),
             this, SIGNAL(modelChangedWithin(sv_frame_t, sv_frame_t)));
+
+    registerModel(this);
 }
 
 FFTModel::~FFTModel()
 {
+    unregisterModel(this);
 }
 
 void
@@ -218,6 +221,16 @@ FFTModel::getSourceSamples(int column) const
     }
 }
 
+size_t
+FFTModel::getMemoryUsage() const
+{
+    size_t bytes = m_savedData.data.capacity() * sizeof(float);
+    for (const auto &saved : m_cached) {
+        bytes += saved.col.capacity() * sizeof(complex<float>);
+    }
+    return bytes;
+}
+
 FFTModel::fvec
 FFTModel::getSourceData(pair<sv_frame_t, sv_frame_t> range) const
 {
@@ -345,6 +358,25 @@ FFTModel::estimateStableFrequency(int x, int y, double &frequency)
 
     if (x+1 >= getWidth()) return false;
 
+    return getInstantaneousFrequencies(x, &frequency, y, 1);
+}
+
+void
+FFTModel::getPhasesFor(int x, int minbin, int count, vector<double> &phases) const
+{
+    const cvec &col = getFFTColumn(x);
+    phases.resize(count);
+    for (int i = 0; i < count; ++i) {
+        phases[i] = arg(col[minbin + i]);
+    }
+}
+
+void
+FFTModel::calculateFrequencies(const vector<double> &oldPhases,
+                               const vector<double> &newPhases,
+                               int minbin, int count,
+                               double *frequencies) const
+{
     // At frequency f, a phase shift of 2pi (one cycle) happens in 1/f sec.
     // At hopsize h and sample rate sr, one hop happens in h/sr sec.
     // At window size w, for bin b, f is b*sr/w.
@@ -353,26 +385,83 @@ FFTModel::estimateStableFrequency(int x, int y, double &frequency)
     // -> 2pi * ((h/sr) / (w/(b*sr)))
     //  = 2pi * ((h * b * sr) / (w * sr))
     //  = 2pi * (h * b) / w.
+    //
+    // The frequency estimate is then based on the phase error
+    // resulting from assuming the "native" frequency of each bin.
+    // Everything here is straight-line arithmetic (with princarg
+    // written out inline) so that the loop can be vectorised.
 
-    double oldPhase = getPhaseAt(x, y);
-    double newPhase = getPhaseAt(x+1, y);
+    const double sampleRate = getSampleRate();
+    const int incr = getResolution();
+    const double twoPi = 2.0 * M_PI;
+    const double binAdvance = (twoPi * incr) / m_fftSize;
+    const double scale = sampleRate / (twoPi * incr);
 
-    int incr = getResolution();
+    const double *const BQ_R__ oldp = oldPhases.data();
+    const double *const BQ_R__ newp = newPhases.data();
 
-    double expectedPhase = oldPhase + (2.0 * M_PI * y * incr) / m_fftSize;
-
-    double phaseError = princarg(newPhase - expectedPhase);
+    for (int i = 0; i < count; ++i) {
+        double expectedAdvance = binAdvance * (minbin + i);
+        double error = newp[i] - oldp[i] - expectedAdvance + M_PI;
+        error = error + twoPi * floor(error / -twoPi) + M_PI;
+        frequencies[i] = scale * (expectedAdvance + error);
+    }
+}
 
-    // The new frequency estimate based on the phase error resulting
-    // from assuming the "native" frequency of this bin
+bool
+FFTModel::getInstantaneousFrequencies(int x, double *frequencies,
+                                      int minbin, int count) const
+{
+    if (!isOK()) return false;
+    if (count == 0) count = getHeight() - minbin;
+    if (x < 0 || x+1 >= getWidth() ||
+        minbin < 0 || count < 0 || minbin + count > getHeight()) {
+        return false;
+    }
 
-    frequency =
-        (getSampleRate() * (expectedPhase + phaseError - oldPhase)) /
-        (2.0 * M_PI * incr);
+    vector<double> oldPhases, newPhases;
+    getPhasesFor(x, minbin, count, oldPhases);
+    getPhasesFor(x+1, minbin, count, newPhases);
 
+    calculateFrequencies(oldPhases, newPhases, minbin, count, frequencies);
     return true;
 }
 
+vector<vector<double>>
+FFTModel::getInstantaneousFrequenciesForColumns(int x0, int x1,
+                                                int minbin, int count) const
+{
+    Profiler profiler("FFTModel::getInstantaneousFrequenciesForColumns");
+
+    vector<vector<double>> result;
+    if (!isOK()) return result;
+    if (count == 0) count = getHeight() - minbin;
+    if (x1 + 1 >= getWidth()) x1 = getWidth() - 2;
+    if (x0 < 0 || x1 < x0 ||
+        minbin < 0 || count < 0 || minbin + count > getHeight()) {
+        return result;
+    }
+
+    result.reserve(x1 - x0 + 1);
+
+    // Each column's phases serve as the "new" phases for one
+    // estimate and the "old" phases for the next, so we calculate
+    // them only once
+    vector<double> oldPhases, newPhases;
+    getPhasesFor(x0, minbin, count, oldPhases);
+
+    for (int x = x0; x <= x1; ++x) {
+        getPhasesFor(x+1, minbin, count, newPhases);
+        vector<double> frequencies(count, 0.0);
+        calculateFrequencies(oldPhases, newPhases, minbin, count,
+                             frequencies.data());
+        result.push_back(frequencies);
+        oldPhases.swap(newPhases);
+    }
+
+    return result;
+}
+
 FFTModel::PeakLocationSet
 FFTModel::getPeaks(PeakPickType type, int x, int ymin, int ymax) const
 {
@@ -405,24 +494,64 @@ FFTModel::getPeaks(PeakPickType type, int x, int ymin, int ymax) const
     }
 
     Column values = getColumn(x);
-    int nv = int(values.size());
+    SlidingPercentile<float> window;
+    pickMajorPeaks(type, values, ymin, ymax, window, peaks);
+
+    return peaks;
+}
+
+vector<FFTModel::PeakLocationSet>
+FFTModel::getPeaksForColumns(PeakPickType type, int x0, int x1,
+                             int ymin, int ymax) const
+{
+    Profiler profiler("FFTModel::getPeaksForColumns");
+
+    vector<PeakLocationSet> result;
+    if (!isOK() || x1 < x0) return result;
 
-    float mean = 0.f;
-    for (int i = 0; i < nv; ++i) mean += values[i];
-    if (nv > 0) mean = mean / float(values.size());
+    result.reserve(x1 - x0 + 1);
+
+    if (type == AllPeaks) {
+        for (int x = x0; x <= x1; ++x) {
+            result.push_back(getPeaks(type, x, ymin, ymax));
+        }
+        return result;
+    }
+
+    if (ymax == 0 || ymax > getHeight() - 1) {
+        ymax = getHeight() - 1;
+    }
+
+    SlidingPercentile<float> window;
     
+    for (int x = x0; x <= x1; ++x) {
+        PeakLocationSet peaks;
+        pickMajorPeaks(type, getColumn(x), ymin, ymax, window, peaks);
+        result.push_back(peaks);
+    }
+
+    return result;
+}
+
+void
+FFTModel::pickMajorPeaks(PeakPickType type, const Column &values,
+                         int ymin, int ymax,
+                         SlidingPercentile<float> &window,
+                         PeakLocationSet &peaks) const
+{
+    int nv = int(values.size());
+    if (nv == 0) return;
+
     // For peak picking we use a moving median window, picking the
     // highest value within each continuous region of values that
     // exceed the median.  For pitch adaptivity, we adjust the window
     // size to a roughly constant pitch range (about four tones).
 
-    sv_samplerate_t sampleRate = getSampleRate();
-
-    deque<float> window;
+    window.clear();
     vector<int> inrange;
     float dist = 0.5;
 
-    int medianWinSize = getPeakPickWindowSize(type, sampleRate, ymin, dist);
+    int medianWinSize = getCachedPeakPickWindowSize(type, ymin, dist);
     int halfWin = medianWinSize/2;
 
     int binmin;
@@ -439,26 +568,24 @@ FFTModel::getPeaks(PeakPickType type, int x, int ymin, int ymax) const
 
         float value = values[bin];
 
-        window.push_back(value);
+        window.push(value);
 
         // so-called median will actually be the dist*100'th percentile
-        medianWinSize = getPeakPickWindowSize(type, sampleRate, bin, dist);
+        medianWinSize = getCachedPeakPickWindowSize(type, bin, dist);
         halfWin = medianWinSize/2;
 
-        while ((int)window.size() > medianWinSize) {
-            window.pop_front();
+        while (window.size() > medianWinSize) {
+            window.pop();
         }
 
-        int actualSize = int(window.size());
+        int actualSize = window.size();
 
         if (type == MajorPitchAdaptivePeaks) {
             if (ymax + halfWin < nv) binmax = ymax + halfWin;
             else binmax = nv - 1;
         }
 
-        deque<float> sorted(window);
-        sort(sorted.begin(), sorted.end());
-        float median = sorted[int(float(sorted.size()) * dist)];
+        float median = window.get(dist);
 
         int centrebin = 0;
         if (bin > actualSize/2) centrebin = bin - actualSize/2;
@@ -493,8 +620,40 @@ FFTModel::getPeaks(PeakPickType type, int x, int ymin, int ymax) const
             if (bin == binmin) break;
         }
     }
+}
 
-    return peaks;
+int
+FFTModel::getCachedPeakPickWindowSize(PeakPickType type, int bin,
+                                      float &percentile) const
+{
+    sv_samplerate_t sampleRate = getSampleRate();
+    
+    if (type != MajorPitchAdaptivePeaks) {
+        return getPeakPickWindowSize(type, sampleRate, bin, percentile);
+    }
+
+    // The pitch-adaptive window sizes depend only on the bin, and
+    // are relatively expensive to calculate, so we do them all once.
+    // Peak pickers on different threads may share this model, so
+    // the table is filled and read under its own mutex
+    QMutexLocker locker(&m_adaptivePeakWindowsMutex);
+    
+    if (m_adaptivePeakWindows.empty()) {
+        int h = getHeight();
+        m_adaptivePeakWindows.reserve(h);
+        for (int i = 0; i < h; ++i) {
+            float p = 0.5f;
+            int sz = getPeakPickWindowSize(type, sampleRate, i, p);
+            m_adaptivePeakWindows.push_back({ sz, p });
+        }
+    }
+
+    if (!in_range_for(m_adaptivePeakWindows, bin)) {
+        return getPeakPickWindowSize(type, sampleRate, bin, percentile);
+    }
+    
+    percentile = m_adaptivePeakWindows[bin].second;
+    return m_adaptivePeakWindows[bin].first;
 }
 
 int
@@ -527,32 +686,27 @@ FFTModel::getPeakFrequencies(PeakPickType type, int x,
     if (!isOK()) return peaks;
     PeakLocationSet locations = getPeaks(type, x, ymin, ymax);
 
+    if (locations.empty()) return peaks;
+
+    // Calculate frequencies across the whole span of peak bins at
+    // once, rather than jumping back and forth between columns x and
+    // x+1 for each peak
+    int minbin = *locations.begin();
+    int count = *locations.rbegin() - minbin + 1;
+
+    vector<double> frequencies(count, 0.0);
+    bool estimated =
+        getInstantaneousFrequencies(x, frequencies.data(), minbin, count);
+
     sv_samplerate_t sampleRate = getSampleRate();
-    int incr = getResolution();
-
-    // This duplicates some of the work of estimateStableFrequency to
-    // allow us to retrieve the phases in two separate vertical
-    // columns, instead of jumping back and forth between columns x and
-    // x+1, which may be significantly slower if re-seeking is needed
-
-    vector<float> phases;
-    for (PeakLocationSet::iterator i = locations.begin();
-         i != locations.end(); ++i) {
-        phases.push_back(getPhaseAt(x, *i));
-    }
-
-    int phaseIndex = 0;
-    for (PeakLocationSet::iterator i = locations.begin();
-         i != locations.end(); ++i) {
-        double oldPhase = phases[phaseIndex];
-        double newPhase = getPhaseAt(x+1, *i);
-        double expectedPhase = oldPhase + (2.0 * M_PI * *i * incr) / m_fftSize;
-        double phaseError = princarg(newPhase - expectedPhase);
-        double frequency =
-            (sampleRate * (expectedPhase + phaseError - oldPhase))
-            / (2 * M_PI * incr);
-        peaks[*i] = frequency;
-        ++phaseIndex;
+    
+    for (int bin : locations) {
+        if (estimated) {
+            peaks[bin] = frequencies[bin - minbin];
+        } else {
+            // no following column: use the bin's nominal frequency
+            peaks[bin] = double(bin * sampleRate) / m_fftSize;
+        }
     }
 
     return peaks;
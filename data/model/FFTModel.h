@@ -20,6 +20,9 @@
 #include "DenseTimeValueModel.h"
 
 #include "base/Window.h"
+#include "base/SlidingPercentile.h"
+
+#include <QMutex>
 
 #include <bqfft/FFT.h>
 #include <bqvec/Allocators.h>
@@ -32,6 +35,10 @@
  * An implementation of DenseThreeDimensionalModel that makes FFT data
  * derived from a DenseTimeValueModel available as a generic data
  * grid.
+ *
+ * The column accessors fill small unguarded caches, so columns
+ * should be read from one thread at a time; only the pitch-adaptive
+ * peak window table is shared safely between threads.
  */
 class FFTModel : public DenseThreeDimensionalModel
 {
@@ -114,6 +121,26 @@ public:
      */
     virtual bool estimateStableFrequency(int x, int y, double &frequency);
 
+    /**
+     * Calculate estimated stable frequencies, as for
+     * estimateStableFrequency, for count bins starting at minbin in
+     * column x, writing them into the frequencies array. If count
+     * is zero, all bins from minbin to the top will be used. Return
+     * false if the bin range is invalid or there is no column x+1.
+     */
+    bool getInstantaneousFrequencies(int x, double *frequencies,
+                                     int minbin = 0, int count = 0) const;
+
+    /**
+     * Calculate estimated stable frequencies for count bins starting
+     * at minbin in each column from x0 to x1 inclusive, returning
+     * one vector per column. Each column's phases are calculated
+     * only once. The range is truncated if x1 is the final column
+     * (for which no estimate is possible).
+     */
+    std::vector<std::vector<double>> getInstantaneousFrequenciesForColumns
+    (int x0, int x1, int minbin = 0, int count = 0) const;
+
     enum PeakPickType
     {
         AllPeaks,                /// Any bin exceeding its immediate neighbours
@@ -131,6 +158,16 @@ public:
     virtual PeakLocationSet getPeaks(PeakPickType type, int x,
                                      int ymin = 0, int ymax = 0) const;
 
+    /**
+     * Return locations of peak bins in the range [ymin,ymax] for
+     * each column from x0 to x1 inclusive. This gives the same
+     * results as calling getPeaks for each column in turn, and
+     * does the same work: the median window runs over the bins of
+     * one column, so each column is picked on its own.
+     */
+    virtual std::vector<PeakLocationSet> getPeaksForColumns
+    (PeakPickType type, int x0, int x1, int ymin = 0, int ymax = 0) const;
+
     /**
      * Return locations and estimated stable frequencies of peak bins.
      */
@@ -139,6 +176,12 @@ public:
 
     QString getTypeName() const { return tr("FFT"); }
 
+    /**
+     * The small column cache and the saved source data. Not
+     * thread-safe, like the column accessors that fill them.
+     */
+    virtual size_t getMemoryUsage() const;
+
 public slots:
     void sourceModelAboutToBeDeleted();
 
@@ -157,6 +200,22 @@ private:
     
     int getPeakPickWindowSize(PeakPickType type, sv_samplerate_t sampleRate,
                               int bin, float &percentile) const;
+    int getCachedPeakPickWindowSize(PeakPickType type, int bin,
+                                    float &percentile) const;
+    mutable std::vector<std::pair<int, float>> m_adaptivePeakWindows;
+    mutable QMutex m_adaptivePeakWindowsMutex;
+
+    void getPhasesFor(int x, int minbin, int count,
+                      std::vector<double> &phases) const;
+    void calculateFrequencies(const std::vector<double> &oldPhases,
+                              const std::vector<double> &newPhases,
+                              int minbin, int count,
+                              double *frequencies) const;
+
+    void pickMajorPeaks(PeakPickType type, const Column &values,
+                        int ymin, int ymax,
+                        SlidingPercentile<float> &window,
+                        PeakLocationSet &peaks) const;
 
     std::pair<sv_frame_t, sv_frame_t> getSourceSampleRange(int column) const {
         sv_frame_t startFrame = m_windowIncrement * sv_frame_t(column);
@@ -184,12 +184,12 @@ public:
             return IntervalModel<FlexiNote>::getData(row, column, role);
         }
 
-        PointListConstIterator i = getPointListIteratorForRow(row);
-        if (i == m_points.end()) return QVariant();
+        Point point(0);
+        if (!getPointForRow(row, point)) return QVariant();
 
         switch (column) {
-        case 4: return i->level;
-        case 5: return i->label;
+        case 4: return point.level;
+        case 5: return point.label;
         default: return QVariant();
         }
     }
@@ -202,11 +202,10 @@ public:
         }
 
         if (role != Qt::EditRole) return 0;
-        PointListConstIterator i = getPointListIteratorForRow(row);
-        if (i == m_points.end()) return 0;
+        Point point(0);
+        if (!getPointForRow(row, point)) return 0;
         EditCommand *command = new EditCommand(this, tr("Edit Data"));
 
-        Point point(*i);
         command->deletePoint(point);
 
         switch (column) {
@@ -234,30 +233,36 @@ public:
     }
 
     NoteList getNotesWithin(sv_frame_t startFrame, sv_frame_t endFrame) const 
-    {    
-    	PointList points = getPoints(startFrame, endFrame);
+    {
         NoteList notes;
-        for (PointList::iterator pli = points.begin(); pli != points.end(); ++pli) {
-    	    sv_frame_t duration = pli->duration;
-            if (duration == 0 || duration == 1) {
-                duration = sv_frame_t(getSampleRate() / 20);
-            }
-            int pitch = int(lrintf(pli->value));
-
-            int velocity = 100;
-            if (pli->level > 0.f && pli->level <= 1.f) {
-                velocity = int(lrintf(pli->level * 127));
-            }
-
-            NoteData note(pli->frame, duration, pitch, velocity);
-
-            if (getScaleUnits() == "Hz") {
-                note.frequency = pli->value;
-                note.midiPitch = Pitch::getPitchForFrequency(note.frequency);
-                note.isMidiPitchQuantized = false;
-            }
-            notes.push_back(note);
-        }
+        bool hz = (getScaleUnits() == "Hz");
+        sv_frame_t defaultDuration = sv_frame_t(getSampleRate() / 20);
+
+        visitPointsWithin(startFrame, endFrame, [&](const Point &p) {
+
+                sv_frame_t duration = p.duration;
+                if (duration == 0 || duration == 1) {
+                    duration = defaultDuration;
+                }
+
+                int pitch = int(lrintf(p.value));
+
+                int velocity = 100;
+                if (p.level > 0.f && p.level <= 1.f) {
+                    velocity = int(lrintf(p.level * 127));
+                }
+
+                NoteData note(p.frame, duration, pitch, velocity);
+
+                if (hz) {
+                    note.frequency = p.value;
+                    note.midiPitch = Pitch::getPitchForFrequency(note.frequency);
+                    note.isMidiPitchQuantized = false;
+                }
+
+                notes.push_back(note);
+            });
+
         return notes;
     }
 
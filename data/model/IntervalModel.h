@@ -18,6 +18,7 @@
 
 #include "SparseValueModel.h"
 #include "base/RealTime.h"
+#include "base/IntervalTree.h"
 
 /**
  * Model containing sparse data (points with some properties) of which
@@ -42,24 +43,41 @@ public:
                                     notifyOnAdd)
     { }
 
+    virtual ~IntervalModel() { Model::unregisterModel(this); }
+
     /**
      * PointTypes have a duration, so this returns all points that span any
-     * of the given range (as well as the usual additional few before
-     * and after).  Consequently this can be very slow (optimised data
-     * structures still to be done!).
+     * of the given range.  Points that start before the range are
+     * found through an interval index, so this takes time
+     * logarithmic in the number of points plus linear in the number
+     * returned.
      */
     virtual typename SparseValueModel<PointType>::PointList getPoints(sv_frame_t start, sv_frame_t end) const;
 
     /**
      * PointTypes have a duration, so this returns all points that span the
-     * given frame.  Consequently this can be very slow (optimised
-     * data structures still to be done!).
+     * given frame (to the model's resolution).
      */
     virtual typename SparseValueModel<PointType>::PointList getPoints(sv_frame_t frame) const;
 
-    virtual const typename SparseModel<PointType>::PointList &getPoints() const {
-        return SparseModel<PointType>::getPoints(); 
-    }
+    /**
+     * As getPoints(start, end), visiting each point in order without
+     * copying.
+     */
+    virtual void visitPointsWithin(sv_frame_t start, sv_frame_t end,
+                                   const typename SparseModel<PointType>::PointVisitor &visitor) const;
+
+    /**
+     * As getPoints(frame), visiting each point in order without
+     * copying.
+     */
+    virtual void visitPointsAt(sv_frame_t frame,
+                               const typename SparseModel<PointType>::PointVisitor &visitor) const;
+
+    /**
+     * The points, row index and interval tree.
+     */
+    virtual size_t getMemoryUsage() const;
 
     /**
      * TabularModel methods.  
@@ -72,16 +90,15 @@ public:
                 (row, column, role);
         }
 
-        typename SparseModel<PointType>::PointList::const_iterator i
-            = SparseModel<PointType>::getPointListIteratorForRow(row);
-        if (i == SparseModel<PointType>::m_points.end()) return QVariant();
+        PointType point(0);
+        if (!SparseModel<PointType>::getPointForRow(row, point)) return QVariant();
 
         switch (column) {
         case 2:
-            if (role == Qt::EditRole || role == TabularModel::SortRole) return i->value;
-            else return QString("%1 %2").arg(i->value).arg
+            if (role == Qt::EditRole || role == TabularModel::SortRole) return point.value;
+            else return QString("%1 %2").arg(point.value).arg
                      (IntervalModel<PointType>::getScaleUnits());
-        case 3: return int(i->duration); //!!! could be better presented
+        case 3: return int(point.duration); //!!! could be better presented
         default: return QVariant();
         }
     }
@@ -96,13 +113,11 @@ public:
         }
 
         if (role != Qt::EditRole) return 0;
-        typename I::PointList::const_iterator i
-            = I::getPointListIteratorForRow(row);
-        if (i == I::m_points.end()) return 0;
+        PointType point(0);
+        if (!I::getPointForRow(row, point)) return 0;
         typename I::EditCommand *command = new typename I::EditCommand
             (this, I::tr("Edit Data"));
 
-        PointType point(*i);
         command->deletePoint(point);
 
         switch (column) {
@@ -121,74 +136,132 @@ public:
         // whose sort ordering is exactly that of the frame time
         return (column < 2);
     }
+
+protected:
+    // Start and end frame of every point, for finding those that
+    // reach into a range from before it. Access only with m_lock
+    // held
+    IntervalTree<sv_frame_t> m_intervals;
+
+    virtual void pointAdded(const PointType &point) {
+        m_intervals.insert(point.frame, point.frame + point.duration);
+    }
+    virtual void pointRemoved(const PointType &point) {
+        m_intervals.erase(point.frame, point.frame + point.duration);
+    }
+    virtual void pointsCleared() {
+        m_intervals.clear();
+    }
+
+    // Visit the points that span any of [start, end]. Call with
+    // m_lock held
+    void visitSpanning(sv_frame_t start, sv_frame_t end,
+                       const typename SparseModel<PointType>::PointVisitor &visitor) const;
 };
 
 template <typename PointType>
 typename SparseValueModel<PointType>::PointList
 IntervalModel<PointType>::getPoints(sv_frame_t start, sv_frame_t end) const
 {
-    typedef IntervalModel<PointType> I;
-
-    if (start > end) return typename I::PointList();
-
-    QMutex &mutex(I::m_mutex);
-    QMutexLocker locker(&mutex);
+    // calls our visitPointsWithin
+    return SparseValueModel<PointType>::getPoints(start, end);
+}
 
-    PointType endPoint(end);
-    
-    typename I::PointListConstIterator endItr = I::m_points.upper_bound(endPoint);
+template <typename PointType>
+typename SparseValueModel<PointType>::PointList
+IntervalModel<PointType>::getPoints(sv_frame_t frame) const
+{
+    // calls our visitPointsAt
+    return SparseValueModel<PointType>::getPoints(frame);
+}
 
-    if (endItr != I::m_points.end()) ++endItr;
-    if (endItr != I::m_points.end()) ++endItr;
+template <typename PointType>
+void
+IntervalModel<PointType>::visitPointsWithin(sv_frame_t start, sv_frame_t end,
+                                            const typename SparseModel<PointType>::PointVisitor &visitor) const
+{
+    typedef IntervalModel<PointType> I;
 
-    typename I::PointList rv;
+    if (start > end) return;
 
-    for (typename I::PointListConstIterator i = endItr; i != I::m_points.begin(); ) {
-        --i;
-        if (i->frame < start) {
-            if (i->frame + i->duration >= start) {
-                rv.insert(*i);
-            }
-        } else if (i->frame <= end) {
-            rv.insert(*i);
-        }
-    }
+    QReadWriteLock &lock(I::m_lock);
+    QReadLocker locker(&lock);
 
-    return rv;
+    visitSpanning(start, end, visitor);
 }
 
 template <typename PointType>
-typename SparseValueModel<PointType>::PointList
-IntervalModel<PointType>::getPoints(sv_frame_t frame) const
+void
+IntervalModel<PointType>::visitPointsAt(sv_frame_t frame,
+                                        const typename SparseModel<PointType>::PointVisitor &visitor) const
 {
     typedef IntervalModel<PointType> I;
 
-    QMutex &mutex(I::m_mutex);
-    QMutexLocker locker(&mutex);
+    QReadWriteLock &lock(I::m_lock);
+    QReadLocker locker(&lock);
 
-    if (I::m_resolution == 0) return typename I::PointList();
+    if (I::m_resolution == 0) return;
 
     sv_frame_t start = (frame / I::m_resolution) * I::m_resolution;
     sv_frame_t end = start + I::m_resolution;
 
-    PointType endPoint(end);
-    
-    typename I::PointListConstIterator endItr = I::m_points.upper_bound(endPoint);
+    visitSpanning(start, end, visitor);
+}
+
+template <typename PointType>
+size_t
+IntervalModel<PointType>::getMemoryUsage() const
+{
+    typedef IntervalModel<PointType> I;
 
-    typename I::PointList rv;
+    size_t bytes = SparseValueModel<PointType>::getMemoryUsage();
 
-    for (typename I::PointListConstIterator i = endItr; i != I::m_points.begin(); ) {
-        --i;
-        if (i->frame < start) {
-            if (i->frame + i->duration >= start) {
-                rv.insert(*i);
+    QReadWriteLock &lock(I::m_lock);
+    QReadLocker locker(&lock);
+
+    return bytes + m_intervals.getMemoryUsage();
+}
+
+template <typename PointType>
+void
+IntervalModel<PointType>::visitSpanning(sv_frame_t start, sv_frame_t end,
+                                        const typename SparseModel<PointType>::PointVisitor &visitor) const
+{
+    typedef IntervalModel<PointType> I;
+
+    // First the points that start before the range and reach into
+    // it. The index gives their start frames in order, but other
+    // points may share those frames without reaching the range
+
+    sv_frame_t prevFrame = start;
+
+    m_intervals.visitOverlapping
+        (start, start - 1, [&](sv_frame_t frame, sv_frame_t) {
+            if (frame == prevFrame) return;
+            prevFrame = frame;
+            PointType framePoint(frame);
+            typename I::PointListConstIterator i =
+                I::m_points.lower_bound(framePoint);
+            while (i != I::m_points.end() && i->frame == frame) {
+                if (i->frame + i->duration >= start) {
+                    visitor(*i);
+                }
+                ++i;
             }
-        } else if (i->frame <= end) {
-            rv.insert(*i);
-        }
-    }
+        });
+
+    // Then those that start within it
 
-    return rv;
+    PointType startPoint(start), endPoint(end);
+    
+    typename I::PointListConstIterator startItr =
+        I::m_points.lower_bound(startPoint);
+    typename I::PointListConstIterator endItr =
+        I::m_points.upper_bound(endPoint);
+
+    for (typename I::PointListConstIterator i = startItr; i != endItr; ++i) {
+        visitor(*i);
+    }
 }
 
 #endif
@@ -180,8 +180,8 @@ public:
     template <typename PointType>
     Command *labelAll(SparseModel<PointType> &model, MultiSelection *ms) {
 
-        auto points(model.getPoints());
-        auto command = new typename SparseModel<PointType>::EditCommand
+        auto points(model.getPointsCopy());
+        auto command = new typename SparseModel<PointType>::BatchEditCommand
             (&model, tr("Label Points"));
 
         PointType prevPoint(0);
@@ -227,8 +227,8 @@ public:
     template <typename PointType>
     Command *subdivide(SparseModel<PointType> &model, MultiSelection *ms, int n) {
         
-        auto points(model.getPoints());
-        auto command = new typename SparseModel<PointType>::EditCommand
+        auto points(model.getPointsCopy());
+        auto command = new typename SparseModel<PointType>::BatchEditCommand
             (&model, tr("Subdivide Points"));
 
         for (auto i = points.begin(); i != points.end(); ++i) {
@@ -271,8 +271,8 @@ public:
     template <typename PointType>
     Command *winnow(SparseModel<PointType> &model, MultiSelection *ms, int n) {
         
-        auto points(model.getPoints());
-        auto command = new typename SparseModel<PointType>::EditCommand
+        auto points(model.getPointsCopy());
+        auto command = new typename SparseModel<PointType>::BatchEditCommand
             (&model, tr("Winnow Points"));
 
         int counter = 0;
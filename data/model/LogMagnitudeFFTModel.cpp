@@ -0,0 +1,429 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+
+/*
+    Sonic Visualiser
+    An audio file viewer and annotation editor.
+    Centre for Digital Music, Queen Mary, University of London.
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation; either version 2 of the
+    License, or (at your option) any later version.  See the file
+    COPYING included with this distribution for more information.
+*/
+
+#include "LogMagnitudeFFTModel.h"
+#include "FFTModel.h"
+
+#include "base/Profiler.h"
+#include "base/HitCount.h"
+
+#include <cmath>
+
+//#define DEBUG_LOG_MAGNITUDE_FFT_MODEL 1
+
+using namespace std;
+
+LogMagnitudeFFTModel::LogMagnitudeFFTModel(const DenseTimeValueModel *model,
+                                           int channel,
+                                           WindowType windowType,
+                                           int windowSize,
+                                           int windowIncrement,
+                                           int fftSize,
+                                           Precision precision) :
+    m_model(model),
+    m_channel(channel),
+    m_windowType(windowType),
+    m_windowSize(windowSize),
+    m_windowIncrement(windowIncrement),
+    m_fftSize(fftSize),
+    m_precision(precision),
+    m_fillFFT(0),
+    m_readFFT(0),
+    m_partialFFT(0),
+    m_filledCount(0),
+    m_fillProgress(0),
+    m_fillThread(0),
+    m_exiting(false)
+{
+    // The largest magnitude an FFT of this size can return (for a
+    // full-scale input) is the FFT size itself, and that is the top
+    // of our scale. Code 0 is reserved for magnitudes below the floor.
+
+    if (m_precision == EightBit) {
+        m_maxCode = 255;
+        m_stepDb = 0.5;
+    } else {
+        m_maxCode = 65535;
+        m_stepDb = 0.003;
+    }
+
+    double ceilingDb = 20.0 * log10(double(m_fftSize));
+    m_floorDb = ceilingDb - m_stepDb * m_maxCode;
+
+    m_decode.resize(m_maxCode + 1, 0.f);
+    for (int code = 1; code <= m_maxCode; ++code) {
+        m_decode[code] = float(pow(10.0, (m_floorDb + m_stepDb * code) / 20.0));
+    }
+
+    // These throw if the window and FFT sizes are incompatible
+    m_fillFFT = new FFTModel(model, channel, windowType, windowSize,
+                             windowIncrement, fftSize);
+    m_readFFT = new FFTModel(model, channel, windowType, windowSize,
+                             windowIncrement, fftSize);
+    m_partialFFT = new FFTModel(model, channel, windowType, windowSize,
+                                windowIncrement, fftSize);
+
+    connect(model, SIGNAL(modelChanged()), this, SIGNAL(modelChanged()));
+    connect(model, SIGNAL(aboutToBeDeleted()),
+            this, SLOT(sourceModelAboutToBeDeleted()));
+
+    // Register before the fill thread starts, as it may call on the
+    // budget at any time after that
+    CacheBudget::getInstance()->registerCache(this);
+
+    m_fillThread = new FillThread(*this);
+    m_fillThread->start();
+
+    registerModel(this);
+}
+
+LogMagnitudeFFTModel::~LogMagnitudeFFTModel()
+{
+    unregisterModel(this);
+    CacheBudget::getInstance()->unregisterCache(this);
+
+    m_exiting = true;
+    if (m_fillThread) {
+        m_fillThread->wait();
+        delete m_fillThread;
+    }
+    delete m_fillFFT;
+    delete m_readFFT;
+    delete m_partialFFT;
+}
+
+void
+LogMagnitudeFFTModel::sourceModelAboutToBeDeleted()
+{
+    m_exiting = true;
+    if (m_fillThread) {
+        m_fillThread->wait();
+    }
+    QMutexLocker locker(&m_readMutex);
+    m_model = 0;
+}
+
+bool
+LogMagnitudeFFTModel::isOK() const
+{
+    return m_model && m_model->isOK();
+}
+
+sv_samplerate_t
+LogMagnitudeFFTModel::getSampleRate() const
+{
+    return isOK() ? m_model->getSampleRate() : 0;
+}
+
+int
+LogMagnitudeFFTModel::getWidth() const
+{
+    if (!m_model) return 0;
+    return int((m_model->getEndFrame() - m_model->getStartFrame())
+               / m_windowIncrement) + 1;
+}
+
+QString
+LogMagnitudeFFTModel::getBinName(int n) const
+{
+    sv_samplerate_t sr = getSampleRate();
+    if (!sr) return "";
+    QString name = tr("%1 Hz").arg((n * sr) / ((getHeight()-1) * 2));
+    return name;
+}
+
+int
+LogMagnitudeFFTModel::getCompletion() const
+{
+    int c = 100;
+    if (m_model) {
+        if (!m_model->isReady(&c)) return c;
+    }
+    int width = getWidth();
+    if (width == 0) return 100;
+    QMutexLocker locker(&m_mutex);
+    int filled = max(m_filledCount, m_fillProgress.load());
+    return int((100.0 * filled) / width);
+}
+
+size_t
+LogMagnitudeFFTModel::getStoreSize() const
+{
+    QMutexLocker locker(&m_mutex);
+    return getStoreSizeLocked();
+}
+
+size_t
+LogMagnitudeFFTModel::getStoreSizeLocked() const
+{
+    size_t bytes = m_coverage.capacity() / 8 +
+        m_store8.capacity() * sizeof(vector<uint8_t>) +
+        m_store16.capacity() * sizeof(vector<uint16_t>);
+    for (const auto &block : m_store8) {
+        bytes += block.capacity() * sizeof(uint8_t);
+    }
+    for (const auto &block : m_store16) {
+        bytes += block.capacity() * sizeof(uint16_t);
+    }
+    return bytes;
+}
+
+size_t
+LogMagnitudeFFTModel::getEvictableSize() const
+{
+    // While the fill thread is running it would only fill the store
+    // again
+    if (!m_fillThread || !m_fillThread->isFinished()) return 0;
+    return getStoreSize();
+}
+
+size_t
+LogMagnitudeFFTModel::evict(size_t)
+{
+    if (!m_fillThread || !m_fillThread->isFinished()) return 0;
+
+    QMutexLocker locker(&m_mutex);
+    size_t bytes = getStoreSizeLocked();
+    vector<vector<uint8_t>>().swap(m_store8);
+    vector<vector<uint16_t>>().swap(m_store16);
+    vector<bool>().swap(m_coverage);
+    m_filledCount = 0;
+    return bytes;
+}
+
+LogMagnitudeFFTModel::Column
+LogMagnitudeFFTModel::getColumn(int x) const
+{
+    static HitCount count("LogMagnitudeFFTModel");
+
+    if (x < 0 || x >= getWidth()) return Column();
+
+    markUsed();
+
+    {
+        QMutexLocker locker(&m_mutex);
+        if (haveColumn(x)) {
+            count.hit();
+            return decodeColumn(x);
+        }
+    }
+
+    count.miss();
+
+    // Not reached by the fill thread yet, calculate it here
+    Column magnitudes;
+    bool safe = false;
+    {
+        QMutexLocker locker(&m_readMutex);
+        if (!m_model || !m_readFFT) return Column();
+        // Check before reading, in case more samples arrive during
+        safe = (x < getSafeWidth());
+        if (safe) magnitudes = m_readFFT->getColumn(x);
+        else magnitudes = m_partialFFT->getColumn(x);
+    }
+
+    vector<int> codes = encodeColumn(magnitudes);
+
+    // Some of the source samples for this column may have yet to
+    // arrive, in which case it will change and we mustn't keep it
+    if (safe) storeColumn(x, codes);
+
+    // Decode what we have rather than reading it back from the
+    // store, which may have been evicted in the meantime
+    return decodeCodes(codes);
+}
+
+float
+LogMagnitudeFFTModel::getValueAt(int x, int y) const
+{
+    if (y < 0 || y >= getHeight()) return 0.f;
+    {
+        QMutexLocker locker(&m_mutex);
+        if (haveColumn(x)) {
+            int block = x / blockColumns;
+            size_t ix = size_t(x % blockColumns) * getHeight() + y;
+            if (m_precision == EightBit) return m_decode[m_store8[block][ix]];
+            else return m_decode[m_store16[block][ix]];
+        }
+    }
+    Column col = getColumn(x);
+    if (!in_range_for(col, y)) return 0.f;
+    return col[y];
+}
+
+int
+LogMagnitudeFFTModel::encode(float magnitude) const
+{
+    if (!(magnitude > 0.f)) return 0;
+    double db = 20.0 * log10(double(magnitude));
+    long code = lrint((db - m_floorDb) / m_stepDb);
+    if (code < 1) return 0;
+    if (code > m_maxCode) return m_maxCode;
+    return int(code);
+}
+
+vector<int>
+LogMagnitudeFFTModel::encodeColumn(const Column &magnitudes) const
+{
+    int h = getHeight();
+    vector<int> codes(h, 0);
+    int n = min(h, int(magnitudes.size()));
+    for (int i = 0; i < n; ++i) {
+        codes[i] = encode(magnitudes[i]);
+    }
+    return codes;
+}
+
+LogMagnitudeFFTModel::Column
+LogMagnitudeFFTModel::decodeCodes(const vector<int> &codes) const
+{
+    Column col(codes.size());
+    for (size_t i = 0; i < codes.size(); ++i) {
+        col[i] = m_decode[codes[i]];
+    }
+    return col;
+}
+
+bool
+LogMagnitudeFFTModel::haveColumn(int x) const
+{
+    return in_range_for(m_coverage, x) && m_coverage[x];
+}
+
+void
+LogMagnitudeFFTModel::storeColumn(int x, const vector<int> &codes) const
+{
+    int h = getHeight();
+
+    QMutexLocker locker(&m_mutex);
+
+    if (haveColumn(x)) return;
+
+    int block = x / blockColumns;
+    size_t blockSize = size_t(blockColumns) * h;
+    size_t base = size_t(x % blockColumns) * h;
+
+    if (m_precision == EightBit) {
+        if (int(m_store8.size()) <= block) m_store8.resize(block + 1);
+        vector<uint8_t> &b = m_store8[block];
+        if (b.empty()) b.resize(blockSize, 0);
+        for (int i = 0; i < h; ++i) b[base + i] = uint8_t(codes[i]);
+    } else {
+        if (int(m_store16.size()) <= block) m_store16.resize(block + 1);
+        vector<uint16_t> &b = m_store16[block];
+        if (b.empty()) b.resize(blockSize, 0);
+        for (int i = 0; i < h; ++i) b[base + i] = uint16_t(codes[i]);
+    }
+
+    if (!in_range_for(m_coverage, x)) {
+        m_coverage.resize(x + 1, false);
+    }
+    m_coverage[x] = true;
+    ++m_filledCount;
+}
+
+LogMagnitudeFFTModel::Column
+LogMagnitudeFFTModel::decodeColumn(int x) const
+{
+    int h = getHeight();
+    int block = x / blockColumns;
+    size_t base = size_t(x % blockColumns) * h;
+    Column col(h);
+    if (m_precision == EightBit) {
+        const vector<uint8_t> &b = m_store8[block];
+        for (int i = 0; i < h; ++i) col[i] = m_decode[b[base + i]];
+    } else {
+        const vector<uint16_t> &b = m_store16[block];
+        for (int i = 0; i < h; ++i) col[i] = m_decode[b[base + i]];
+    }
+    return col;
+}
+
+int
+LogMagnitudeFFTModel::getSafeWidth() const
+{
+    // The number of columns whose source samples are all available.
+    // While the source is still loading, the final columns may only
+    // be partially present and would need recalculating later, so we
+    // leave those alone until it's complete
+    if (!m_model) return 0;
+    int width = getWidth();
+    if (m_model->isReady()) return width;
+    sv_frame_t available = m_model->getEndFrame() - m_windowSize / 2;
+    if (available < 0) return 0;
+    int safe = int(available / m_windowIncrement) + 1;
+    return min(safe, width);
+}
+
+void
+LogMagnitudeFFTModel::FillThread::run()
+{
+    Profiler profiler("LogMagnitudeFFTModel::FillThread::run");
+
+    const int notifyInterval = 256;
+    int x = 0;
+
+    while (!m_model.m_exiting) {
+
+        bool complete = m_model.m_model->isReady();
+        int width = m_model.getSafeWidth();
+        int changedFrom = -1;
+
+        for ( ; x < width && !m_model.m_exiting; ++x) {
+
+            bool have = false;
+            {
+                QMutexLocker locker(&m_model.m_mutex);
+                have = m_model.haveColumn(x);
+            }
+            if (have) continue;
+
+            m_model.storeColumn
+                (x, m_model.encodeColumn(m_model.m_fillFFT->getColumn(x)));
+            if (changedFrom < 0) changedFrom = x;
+
+            if (x + 1 - changedFrom >= notifyInterval) {
+                emit m_model.modelChangedWithin
+                    (sv_frame_t(changedFrom) * m_model.m_windowIncrement,
+                     sv_frame_t(x + 1) * m_model.m_windowIncrement);
+                emit m_model.completionChanged();
+                changedFrom = -1;
+            }
+        }
+
+        m_model.m_fillProgress = x;
+
+        if (changedFrom >= 0) {
+            emit m_model.modelChangedWithin
+                (sv_frame_t(changedFrom) * m_model.m_windowIncrement,
+                 sv_frame_t(x) * m_model.m_windowIncrement);
+            emit m_model.completionChanged();
+        }
+
+        CacheBudget::getInstance()->check();
+
+        if (complete && x >= width) break;
+
+        msleep(100);
+    }
+
+#ifdef DEBUG_LOG_MAGNITUDE_FFT_MODEL
+    SVDEBUG << "LogMagnitudeFFTModel::FillThread::run: filled " << x
+            << " columns, store size " << m_model.getStoreSize() << endl;
+#endif
+
+    if (!m_model.m_exiting) {
+        emit m_model.ready();
+    }
+}
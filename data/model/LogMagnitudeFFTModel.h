@@ -0,0 +1,204 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+
+/*
+    Sonic Visualiser
+    An audio file viewer and annotation editor.
+    Centre for Digital Music, Queen Mary, University of London.
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation; either version 2 of the
+    License, or (at your option) any later version.  See the file
+    COPYING included with this distribution for more information.
+*/
+
+#ifndef SV_LOG_MAGNITUDE_FFT_MODEL_H
+#define SV_LOG_MAGNITUDE_FFT_MODEL_H
+
+#include "DenseThreeDimensionalModel.h"
+#include "DenseTimeValueModel.h"
+
+#include "base/Window.h"
+#include "base/Thread.h"
+#include "base/CacheBudget.h"
+
+#include <QMutex>
+
+#include <vector>
+#include <cstdint>
+#include <atomic>
+
+class FFTModel;
+
+/**
+ * An implementation of DenseThreeDimensionalModel that makes FFT
+ * magnitudes derived from a DenseTimeValueModel available at display
+ * precision, storing every column in a compact quantised form.
+ *
+ * Magnitudes are stored as 8- or 16-bit codes on a fixed decibel
+ * scale whose ceiling is the largest magnitude the FFT can produce,
+ * so that a column takes one-eighth (or one-quarter) of the memory
+ * of the complex float column it is calculated from. That is small
+ * enough to keep a whole high-resolution spectrogram of a long file
+ * in memory.
+ *
+ * Columns are calculated in a background thread, in order, as the
+ * source model becomes available. A column that is requested before
+ * the background thread has reached it is calculated immediately on
+ * the reader's thread, and stored unless the source samples it needs
+ * are still loading.
+ *
+ * The values returned are linear magnitudes, as from FFTModel's
+ * getValueAt and getColumn, but quantised: the step between
+ * adjacent codes is 0.5dB at 8 bits and 0.003dB at 16 bits, and
+ * magnitudes below the floor of the scale are returned as zero.
+ *
+ * Once every column has been calculated, the store may be discarded
+ * at the request of CacheBudget, after which columns are calculated
+ * again as they are requested.
+ */
+class LogMagnitudeFFTModel : public DenseThreeDimensionalModel,
+                             public BudgetedCache
+{
+    Q_OBJECT
+
+public:
+    enum Precision {
+        EightBit,
+        SixteenBit
+    };
+
+    /**
+     * Construct a log-magnitude model with the given precision from
+     * the given DenseTimeValueModel, with parameters as for FFTModel.
+     */
+    LogMagnitudeFFTModel(const DenseTimeValueModel *model,
+                         int channel,
+                         WindowType windowType,
+                         int windowSize,
+                         int windowIncrement,
+                         int fftSize,
+                         Precision precision = EightBit);
+    ~LogMagnitudeFFTModel();
+
+    // DenseThreeDimensionalModel and Model methods:
+    //
+    virtual int getWidth() const;
+    virtual int getHeight() const { return m_fftSize / 2 + 1; }
+    virtual float getValueAt(int x, int y) const;
+    virtual bool isOK() const;
+    virtual sv_frame_t getStartFrame() const { return 0; }
+    virtual sv_frame_t getEndFrame() const {
+        return sv_frame_t(getWidth()) * getResolution() + getResolution();
+    }
+    virtual sv_samplerate_t getSampleRate() const;
+    virtual int getResolution() const { return m_windowIncrement; }
+    virtual int getYBinCount() const { return getHeight(); }
+    virtual float getMinimumLevel() const { return 0.f; }
+    virtual float getMaximumLevel() const { return m_decode[m_maxCode]; }
+    virtual Column getColumn(int x) const; // magnitudes
+    virtual QString getBinName(int n) const;
+    virtual bool shouldUseLogValueScale() const { return true; }
+    virtual int getCompletion() const;
+
+    QString getTypeName() const { return tr("Log Magnitude FFT"); }
+
+    virtual size_t getMemoryUsage() const { return getStoreSize(); }
+
+    // BudgetedCache methods:
+    //
+    virtual size_t getEvictableSize() const;
+    virtual size_t evict(size_t bytes);
+
+    // LogMagnitudeFFTModel methods:
+    //
+    int getChannel() const { return m_channel; }
+    WindowType getWindowType() const { return m_windowType; }
+    int getWindowSize() const { return m_windowSize; }
+    int getWindowIncrement() const { return m_windowIncrement; }
+    int getFFTSize() const { return m_fftSize; }
+    Precision getPrecision() const { return m_precision; }
+
+    /**
+     * Return the dB values of the lowest and highest non-zero
+     * magnitudes that can be represented.
+     */
+    double getFloorDb() const { return m_floorDb; }
+    double getCeilingDb() const { return m_floorDb + m_stepDb * m_maxCode; }
+
+    /**
+     * Return the number of bytes used to store the columns
+     * calculated so far.
+     */
+    size_t getStoreSize() const;
+
+public slots:
+    void sourceModelAboutToBeDeleted();
+
+protected:
+    class FillThread : public Thread
+    {
+    public:
+        FillThread(LogMagnitudeFFTModel &model) : m_model(model) { }
+        virtual void run();
+
+    protected:
+        LogMagnitudeFFTModel &m_model;
+    };
+
+private:
+    LogMagnitudeFFTModel(const LogMagnitudeFFTModel &); // not implemented
+    LogMagnitudeFFTModel &operator=(const LogMagnitudeFFTModel &); // not implemented
+
+    const DenseTimeValueModel *m_model;
+    int m_channel;
+    WindowType m_windowType;
+    int m_windowSize;
+    int m_windowIncrement;
+    int m_fftSize;
+    Precision m_precision;
+
+    double m_floorDb;
+    double m_stepDb;
+    int m_maxCode;
+    std::vector<float> m_decode; // code -> linear magnitude
+
+    // Only m_fillThread uses m_fillFFT; readers use m_readFFT, with
+    // m_readMutex held, for columns that have not been filled yet.
+    // Columns whose source samples are still loading are calculated
+    // with m_partialFFT instead, so that the partial source data it
+    // caches can never find its way into a column that is stored
+    FFTModel *m_fillFFT;
+    mutable FFTModel *m_readFFT;
+    mutable FFTModel *m_partialFFT;
+    mutable QMutex m_readMutex;
+
+    // m_mutex protects the stores and m_coverage. Columns are stored
+    // in blocks of blockColumns each, so that while the source loads
+    // the store grows a block at a time, without copying what it
+    // already has
+    enum { blockColumns = 256 };
+    mutable QMutex m_mutex;
+    mutable std::vector<std::vector<uint8_t>> m_store8;
+    mutable std::vector<std::vector<uint16_t>> m_store16;
+    mutable std::vector<bool> m_coverage; // vector of bool uses 1-bit elements
+    mutable int m_filledCount;
+
+    // The column the fill thread has reached, so that completion
+    // doesn't go backwards when the stores are evicted
+    std::atomic<int> m_fillProgress;
+
+    FillThread *m_fillThread;
+    std::atomic<bool> m_exiting;
+
+    int encode(float magnitude) const;
+    std::vector<int> encodeColumn(const Column &magnitudes) const;
+    Column decodeCodes(const std::vector<int> &codes) const;
+    void storeColumn(int x, const std::vector<int> &codes) const;
+    Column decodeColumn(int x) const; // call with m_mutex held
+    size_t getStoreSizeLocked() const; // call with m_mutex held
+    bool haveColumn(int x) const; // call with m_mutex held
+    int getSafeWidth() const;
+};
+
+#endif
@@ -0,0 +1,137 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+
+/*
+    Sonic Visualiser
+    An audio file viewer and annotation editor.
+    Centre for Digital Music, Queen Mary, University of London.
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation; either version 2 of the
+    License, or (at your option) any later version.  See the file
+    COPYING included with this distribution for more information.
+*/
+
+#include "MappedChunkFile.h"
+
+#include "base/TempDirectory.h"
+#include "base/Exceptions.h"
+#include "base/Debug.h"
+
+#include <QDir>
+
+#include <cstring>
+#include <cstdint>
+#include <vector>
+#include <algorithm>
+
+#if !defined(_WIN32) && !defined(__APPLE__)
+#include <fcntl.h>
+#endif
+
+// Map the file in segments of at least this many bytes. Segment
+// offsets and sizes are kept to multiples of segmentAlignment, which
+// is the mapping granularity on Windows and a multiple of the page
+// size elsewhere
+static const size_t segmentSize = 64 * 1024 * 1024;
+static const size_t segmentAlignment = 65536;
+
+// Extend the file by size bytes from the given offset, making sure
+// the disc blocks for the new part are allocated. A plain resize may
+// leave a sparse file, and then a full disc shows up only as a bus
+// error when the mapping is written to
+static bool
+reserve(QFile &file, qint64 from, qint64 size)
+{
+#if defined(_WIN32)
+    // Extending a file on Windows allocates its blocks
+    return file.resize(from + size);
+#elif defined(__APPLE__)
+    // No posix_fallocate here, so write the zeros ourselves
+    if (!file.seek(from)) return false;
+    std::vector<char> zeros(segmentAlignment, 0);
+    for (qint64 done = 0; done < size; ) {
+        qint64 n = std::min(qint64(zeros.size()), size - done);
+        if (file.write(zeros.data(), n) != n) return false;
+        done += n;
+    }
+    return file.flush();
+#else
+    return posix_fallocate(file.handle(), from, size) == 0;
+#endif
+}
+
+MappedChunkFile::MappedChunkFile(QString label) :
+    m_fileSize(0),
+    m_used(0)
+{
+    QDir dir(TempDirectory::getInstance()->getPath());
+    m_fileName = dir.filePath(QString("%1_%2.dat")
+                              .arg(label).arg((intptr_t)this));
+
+    m_file.setFileName(m_fileName);
+    if (!m_file.open(QIODevice::ReadWrite | QIODevice::Truncate)) {
+        throw FileOperationFailed(m_fileName, "open");
+    }
+
+    SVDEBUG << "MappedChunkFile: created " << m_fileName << endl;
+}
+
+MappedChunkFile::~MappedChunkFile()
+{
+    for (const Segment &s : m_segments) {
+        m_file.unmap(s.base);
+    }
+    m_file.close();
+
+    if (!QFile(m_fileName).remove()) {
+        SVDEBUG << "WARNING: MappedChunkFile::~MappedChunkFile: Failed to delete file \"" << m_fileName << "\"" << endl;
+    }
+}
+
+void *
+MappedChunkFile::append(const void *data, size_t bytes)
+{
+    if (bytes == 0) return 0;
+
+    if (m_segments.empty() ||
+        m_segments.back().size - m_segments.back().used < bytes) {
+
+        size_t size = segmentSize;
+        if (bytes > size) {
+            size = ((bytes + segmentAlignment - 1) / segmentAlignment)
+                * segmentAlignment;
+        }
+
+        if (!reserve(m_file, m_fileSize, qint64(size))) {
+            SVDEBUG << "WARNING: MappedChunkFile::append: Failed to extend \""
+                    << m_fileName << "\" to " << (m_fileSize + qint64(size))
+                    << " bytes" << endl;
+            m_file.resize(m_fileSize);
+            return 0;
+        }
+
+        uchar *base = m_file.map(m_fileSize, qint64(size));
+        if (!base) {
+            SVDEBUG << "WARNING: MappedChunkFile::append: Failed to map \""
+                    << m_fileName << "\" at offset " << m_fileSize
+                    << ": " << m_file.errorString() << endl;
+            m_file.resize(m_fileSize);
+            return 0;
+        }
+
+        m_segments.push_back({ base, size, 0 });
+        m_fileSize += qint64(size);
+    }
+
+    Segment &s = m_segments.back();
+    unsigned char *ptr = s.base + s.used;
+    memcpy(ptr, data, bytes);
+
+    // Keep each block aligned for any element type
+    s.used += ((bytes + 15) / 16) * 16;
+    if (s.used > s.size) s.used = s.size;
+
+    m_used += bytes;
+    return ptr;
+}
@@ -0,0 +1,85 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+
+/*
+    Sonic Visualiser
+    An audio file viewer and annotation editor.
+    Centre for Digital Music, Queen Mary, University of London.
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation; either version 2 of the
+    License, or (at your option) any later version.  See the file
+    COPYING included with this distribution for more information.
+*/
+
+#ifndef SV_MAPPED_CHUNK_FILE_H
+#define SV_MAPPED_CHUNK_FILE_H
+
+#include <QFile>
+#include <QString>
+
+#include <vector>
+#include <cstddef>
+
+/**
+ * A file in the TempDirectory to which blocks of memory can be moved
+ * ("paged out"), and which is memory-mapped so that they remain
+ * directly readable and writable at their new address. This is used
+ * by DenseColumnStore and EncodedColumnStore to move cold chunks of
+ * a very large model out of the heap, leaving the operating system
+ * to decide how much of them to keep resident.
+ *
+ * The file is mapped in large segments, so as to keep the number of
+ * mappings small. Blocks are never freed individually: the file grows
+ * until the object is destroyed, at which point all blocks become
+ * invalid and the file is removed.
+ *
+ * This class is not thread-safe; the owner must serialise access.
+ */
+class MappedChunkFile
+{
+public:
+    /**
+     * Create a file in the TempDirectory whose name starts with the
+     * given label. Throw DirectoryCreationFailed if the temporary
+     * directory cannot be created, or FileOperationFailed if the file
+     * cannot be.
+     */
+    MappedChunkFile(QString label);
+    ~MappedChunkFile();
+
+    /**
+     * Copy the given number of bytes from data into the file and
+     * return a writable pointer to the mapped copy, which remains
+     * valid until this object is destroyed. Return 0 if the file
+     * could not be extended or mapped (for example if the disc is
+     * full), in which case the caller should carry on using the
+     * original.
+     */
+    void *append(const void *data, size_t bytes);
+
+    /**
+     * Return the number of bytes appended so far.
+     */
+    size_t getSize() const { return m_used; }
+
+    QString getFileName() const { return m_fileName; }
+
+private:
+    MappedChunkFile(const MappedChunkFile &); // not implemented
+    MappedChunkFile &operator=(const MappedChunkFile &); // not implemented
+
+    QString m_fileName;
+    QFile m_file;
+
+    struct Segment {
+        unsigned char *base;
+        size_t size;
+        size_t used;
+    };
+    std::vector<Segment> m_segments;
+    qint64 m_fileSize;
+    size_t m_used;
+};
+
+#endif
@@ -17,13 +17,44 @@
 #include "AlignmentModel.h"
 
 #include <QTextStream>
+#include <QMutex>
+#include <QMutexLocker>
 
 #include <iostream>
+#include <set>
 
 const int Model::COMPLETION_UNKNOWN = -1;
 
+static QMutex registryMutex;
+static std::set<Model *> registry;
+
+void
+Model::registerModel(Model *model)
+{
+    QMutexLocker locker(&registryMutex);
+    registry.insert(model);
+}
+
+void
+Model::unregisterModel(Model *model)
+{
+    QMutexLocker locker(&registryMutex);
+    registry.erase(model);
+}
+
+void
+Model::visitModels(std::function<void(const Model *)> f)
+{
+    QMutexLocker locker(&registryMutex);
+    for (const Model *model : registry) {
+        f(model);
+    }
+}
+
 Model::~Model()
 {
+    unregisterModel(this);
+
 //    SVDEBUG << "Model::~Model(" << this << ")" << endl;
 
     if (!m_aboutToDelete) {
@@ -75,6 +106,7 @@ Model::aboutToDelete()
 
     emit aboutToBeDeleted();
     m_aboutToDelete = true;
+    unregisterModel(this);
 }
 
 void
@@ -17,7 +17,9 @@
 #define _MODEL_H_
 
 #include <vector>
+#include <functional>
 #include <QObject>
+#include <QTextStream>
 
 #include "base/XmlExportable.h"
 #include "base/Playable.h"
@@ -90,6 +92,45 @@ public:
      */
     virtual QString getTypeName() const = 0;
 
+    /**
+     * Return an estimate of the number of bytes of memory used by
+     * this model's own data and caches. Data in memory-mapped files
+     * and in other models is not counted. The default is 0, for
+     * models that hold nothing of any size.
+     */
+    virtual size_t getMemoryUsage() const { return 0; }
+
+    /**
+     * Call f(model) for every model that has been registered with
+     * registerModel() and has been neither deleted nor notified
+     * through aboutToDelete(). The set of models is locked meanwhile,
+     * so f must not register, unregister or delete any. See
+     * ModelMemoryReport.
+     */
+    static void visitModels(std::function<void(const Model *)> f);
+
+    /**
+     * Add a model to the set visited by visitModels(). The model
+     * must be fully constructed, as visitors call its virtual methods
+     * from any thread. So this is called either by the code that
+     * hands a new model on to its owner (such as ModelTransformer
+     * when its output models are detached), or at the end of the
+     * constructor of a class that nothing derives from (such as
+     * ReadOnlyWaveFileModel and FFTModel, which are created in
+     * places that do not otherwise know about the registry). It is
+     * harmless to register a model more than once.
+     */
+    static void registerModel(Model *);
+
+    /**
+     * Remove a model from the set visited by visitModels(), if it is
+     * there. This is called by aboutToDelete() and by ~Model, and must
+     * also be called at the start of the destructor of any class that
+     * reimplements getMemoryUsage(), before that class's data is torn
+     * down.
+     */
+    static void unregisterModel(Model *);
+
     /**
      * Mark the model as abandoning. This means that the application
      * no longer needs it, so it can stop doing any background
@@ -234,6 +275,27 @@ public:
         return toDelimitedDataStringSubset(delimiter, f0, f1);
     }
 
+    /**
+     * Write the same text as toDelimitedDataStringWithOptions to the
+     * given stream. Models that may hold very many items override
+     * this to write one row at a time, so that the whole text never
+     * needs to be held in memory.
+     */
+    virtual void writeDelimitedData(QTextStream &out, QString delimiter,
+                                    DataExportOptions opts) const {
+        out << toDelimitedDataStringWithOptions(delimiter, opts);
+    }
+
+    /**
+     * Write the same text as toDelimitedDataStringSubsetWithOptions
+     * to the given stream, as writeDelimitedData does.
+     */
+    virtual void writeDelimitedDataSubset(QTextStream &out, QString delimiter,
+                                          DataExportOptions opts,
+                                          sv_frame_t f0, sv_frame_t f1) const {
+        out << toDelimitedDataStringSubsetWithOptions(delimiter, opts, f0, f1);
+    }
+
 public slots:
     void aboutToDelete();
     void sourceModelAboutToBeDeleted();
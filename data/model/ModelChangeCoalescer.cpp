@@ -0,0 +1,139 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+
+/*
+    Sonic Visualiser
+    An audio file viewer and annotation editor.
+    Centre for Digital Music, Queen Mary, University of London.
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation; either version 2 of the
+    License, or (at your option) any later version.  See the file
+    COPYING included with this distribution for more information.
+*/
+
+#include "ModelChangeCoalescer.h"
+
+#include "Model.h"
+
+std::atomic<long> ModelChangeCoalescer::m_totalReceived(0);
+std::atomic<long> ModelChangeCoalescer::m_totalDelivered(0);
+
+ModelChangeCoalescer *
+ModelChangeCoalescer::getFor(const Model *model, int intervalMs)
+{
+    ModelChangeCoalescer *c = model->findChild<ModelChangeCoalescer *>
+        (QString(), Qt::FindDirectChildrenOnly);
+    if (!c) c = new ModelChangeCoalescer(model, intervalMs);
+    return c;
+}
+
+ModelChangeCoalescer::ModelChangeCoalescer(const Model *model, int intervalMs) :
+    // Parented to the model only so as to be deleted with it, which
+    // doesn't change the model as far as its users are concerned
+    QObject(const_cast<Model *>(model)),
+    m_model(model),
+    m_changed(false),
+    m_changedWithin(false),
+    m_startFrame(0),
+    m_endFrame(0),
+    m_completionChanged(false),
+    m_received(0),
+    m_delivered(0)
+{
+    m_timer.setSingleShot(true);
+    m_timer.setInterval(intervalMs);
+    connect(&m_timer, SIGNAL(timeout()), this, SLOT(deliver()));
+
+    connect(model, SIGNAL(modelChanged()),
+            this, SLOT(modelChangedReceived()));
+    connect(model, SIGNAL(modelChangedWithin(sv_frame_t, sv_frame_t)),
+            this, SLOT(modelChangedWithinReceived(sv_frame_t, sv_frame_t)));
+    connect(model, SIGNAL(completionChanged()),
+            this, SLOT(completionChangedReceived()));
+}
+
+ModelChangeCoalescer::~ModelChangeCoalescer()
+{
+}
+
+void
+ModelChangeCoalescer::flush()
+{
+    m_timer.stop();
+    deliver();
+}
+
+void
+ModelChangeCoalescer::modelChangedReceived()
+{
+    m_changed = true;
+    m_changedWithin = false;
+    received();
+}
+
+void
+ModelChangeCoalescer::modelChangedWithinReceived(sv_frame_t startFrame,
+                                                 sv_frame_t endFrame)
+{
+    if (!m_changed) {
+        if (!m_changedWithin) {
+            m_startFrame = startFrame;
+            m_endFrame = endFrame;
+            m_changedWithin = true;
+        } else {
+            if (startFrame < m_startFrame) m_startFrame = startFrame;
+            if (endFrame > m_endFrame) m_endFrame = endFrame;
+        }
+    }
+    received();
+}
+
+void
+ModelChangeCoalescer::completionChangedReceived()
+{
+    m_completionChanged = true;
+    received();
+}
+
+void
+ModelChangeCoalescer::received()
+{
+    ++m_received;
+    ++m_totalReceived;
+
+    // Not restarted if already running, so that a steady stream of
+    // notifications is still delivered once per interval
+    if (!m_timer.isActive()) m_timer.start();
+}
+
+void
+ModelChangeCoalescer::deliver()
+{
+    // Clear the pending state first, as listeners may cause more
+    // notifications
+
+    bool changed = m_changed;
+    bool changedWithin = m_changedWithin;
+    bool completionChanged = m_completionChanged;
+    sv_frame_t startFrame = m_startFrame, endFrame = m_endFrame;
+
+    m_changed = m_changedWithin = m_completionChanged = false;
+
+    int delivered = 0;
+    
+    if (changed) {
+        emit modelChanged();
+        ++delivered;
+    } else if (changedWithin) {
+        emit modelChangedWithin(startFrame, endFrame);
+        ++delivered;
+    }
+    if (completionChanged) {
+        emit this->completionChanged();
+        ++delivered;
+    }
+
+    m_delivered += delivered;
+    m_totalDelivered += delivered;
+}
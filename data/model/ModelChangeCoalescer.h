@@ -0,0 +1,106 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+
+/*
+    Sonic Visualiser
+    An audio file viewer and annotation editor.
+    Centre for Digital Music, Queen Mary, University of London.
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation; either version 2 of the
+    License, or (at your option) any later version.  See the file
+    COPYING included with this distribution for more information.
+*/
+
+#ifndef _MODEL_CHANGE_COALESCER_H_
+#define _MODEL_CHANGE_COALESCER_H_
+
+#include "base/BaseTypes.h"
+
+#include <QObject>
+#include <QTimer>
+
+#include <atomic>
+
+class Model;
+
+/**
+ * Relays the change notifications of a model to any number of
+ * listeners at a bounded rate. Notifications that arrive between
+ * deliveries are merged, with the frame ranges of modelChangedWithin
+ * being combined into one range covering them all, and a modelChanged
+ * superseding any ranges.
+ *
+ * Connect to the coalescer's signals instead of the model's. Use
+ * getFor to share one coalescer among all listeners to a model; it
+ * is owned by, and deleted with, the model.
+ */
+class ModelChangeCoalescer : public QObject
+{
+    Q_OBJECT
+
+public:
+    /**
+     * Return the coalescer for the given model, creating it (with
+     * the given delivery interval in milliseconds) if there isn't one
+     * yet. An interval of zero delivers once per turn of the event
+     * loop.
+     */
+    static ModelChangeCoalescer *getFor(const Model *model, int intervalMs = 0);
+
+    ModelChangeCoalescer(const Model *model, int intervalMs = 0);
+    virtual ~ModelChangeCoalescer();
+
+    const Model *getModel() const { return m_model; }
+    int getInterval() const { return m_timer.interval(); }
+
+    /**
+     * Deliver any pending notifications now.
+     */
+    void flush();
+
+    /**
+     * Return the number of notifications received from the model,
+     * and the number delivered to listeners, by this coalescer.
+     */
+    int getReceivedCount() const { return m_received; }
+    int getDeliveredCount() const { return m_delivered; }
+
+    /**
+     * Return the numbers of notifications received and delivered by
+     * all coalescers since the program started.
+     */
+    static long getTotalReceivedCount() { return m_totalReceived; }
+    static long getTotalDeliveredCount() { return m_totalDelivered; }
+
+signals:
+    void modelChanged();
+    void modelChangedWithin(sv_frame_t startFrame, sv_frame_t endFrame);
+    void completionChanged();
+
+protected slots:
+    void modelChangedReceived();
+    void modelChangedWithinReceived(sv_frame_t startFrame, sv_frame_t endFrame);
+    void completionChangedReceived();
+    void deliver();
+
+protected:
+    const Model *m_model;
+    QTimer m_timer;
+
+    bool m_changed;
+    bool m_changedWithin;
+    sv_frame_t m_startFrame;
+    sv_frame_t m_endFrame;
+    bool m_completionChanged;
+
+    int m_received;
+    int m_delivered;
+
+    static std::atomic<long> m_totalReceived;
+    static std::atomic<long> m_totalDelivered;
+
+    void received();
+};
+
+#endif
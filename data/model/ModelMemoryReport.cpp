@@ -0,0 +1,68 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+
+/*
+    Sonic Visualiser
+    An audio file viewer and annotation editor.
+    Centre for Digital Music, Queen Mary, University of London.
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation; either version 2 of the
+    License, or (at your option) any later version.  See the file
+    COPYING included with this distribution for more information.
+*/
+
+#include "ModelMemoryReport.h"
+
+#include "Model.h"
+
+#include "base/StorageAdviser.h"
+
+#include <algorithm>
+
+ModelMemoryReport::ModelMemoryReport() :
+    m_modelTotal(0)
+{
+    Model::visitModels([this](const Model *model) {
+            size_t bytes = model->getMemoryUsage();
+            if (bytes == 0) return;
+            Entry e;
+            e.model = model;
+            e.typeName = model->getTypeName();
+            e.name = model->objectName();
+            e.bytes = bytes;
+            m_entries.push_back(e);
+            m_modelTotal += bytes;
+        });
+
+    std::stable_sort(m_entries.begin(), m_entries.end(),
+                     [](const Entry &a, const Entry &b) {
+                         return a.bytes > b.bytes;
+                     });
+
+    m_plannedMemory = StorageAdviser::getPlannedAllocation
+        (StorageAdviser::MemoryAllocation) * 1024;
+    m_plannedDisc = StorageAdviser::getPlannedAllocation
+        (StorageAdviser::DiscAllocation) * 1024;
+}
+
+static QString
+toKB(size_t bytes)
+{
+    return QString("%1K").arg((bytes + 1023) / 1024);
+}
+
+QString
+ModelMemoryReport::toString() const
+{
+    QString s;
+    for (const Entry &e : m_entries) {
+        s += QString("%1 \"%2\": %3\n")
+            .arg(e.typeName).arg(e.name).arg(toKB(e.bytes));
+    }
+    s += QString("Total for %1 model(s): %2\n")
+        .arg(m_entries.size()).arg(toKB(m_modelTotal));
+    s += QString("Planned through StorageAdviser: memory %1, disc %2\n")
+        .arg(toKB(m_plannedMemory)).arg(toKB(m_plannedDisc));
+    return s;
+}
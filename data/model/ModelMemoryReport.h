@@ -0,0 +1,84 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+
+/*
+    Sonic Visualiser
+    An audio file viewer and annotation editor.
+    Centre for Digital Music, Queen Mary, University of London.
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation; either version 2 of the
+    License, or (at your option) any later version.  See the file
+    COPYING included with this distribution for more information.
+*/
+
+#ifndef _MODEL_MEMORY_REPORT_H_
+#define _MODEL_MEMORY_REPORT_H_
+
+#include <QString>
+
+#include <vector>
+
+class Model;
+
+/**
+ * A snapshot of the memory used by every registered model (see
+ * Model::registerModel()), as estimated by Model::getMemoryUsage(),
+ * together with the storage
+ * that StorageAdviser has been told is planned but not yet
+ * allocated.
+ *
+ * The planned amounts are reported separately rather than added to
+ * the model total, as memory is normally planned for a model that
+ * will count it once allocated.
+ */
+class ModelMemoryReport
+{
+public:
+    struct Entry {
+        Entry() : model(0), bytes(0) { }
+        const Model *model; // for identification only; may since be deleted
+        QString typeName;
+        QString name;
+        size_t bytes;
+    };
+
+    /**
+     * Take a report of the memory in use now. See
+     * Model::visitModels() for the models included.
+     */
+    ModelMemoryReport();
+
+    /**
+     * Return one entry for each model using any memory, largest
+     * first.
+     */
+    const std::vector<Entry> &getEntries() const { return m_entries; }
+
+    /**
+     * Return the number of bytes used by all models together.
+     */
+    size_t getModelTotal() const { return m_modelTotal; }
+
+    /**
+     * Return the number of bytes of memory and of disc space planned
+     * through StorageAdviser::notifyPlannedAllocation and not yet
+     * allocated.
+     */
+    size_t getPlannedMemory() const { return m_plannedMemory; }
+    size_t getPlannedDisc() const { return m_plannedDisc; }
+
+    /**
+     * Return the report as text, with a line for each model followed
+     * by the totals.
+     */
+    QString toString() const;
+
+private:
+    std::vector<Entry> m_entries;
+    size_t m_modelTotal;
+    size_t m_plannedMemory;
+    size_t m_plannedDisc;
+};
+
+#endif
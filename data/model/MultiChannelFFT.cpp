@@ -0,0 +1,178 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+
+/*
+    Sonic Visualiser
+    An audio file viewer and annotation editor.
+    Centre for Digital Music, Queen Mary, University of London.
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation; either version 2 of the
+    License, or (at your option) any later version.  See the file
+    COPYING included with this distribution for more information.
+*/
+
+#include "MultiChannelFFT.h"
+#include "DenseTimeValueModel.h"
+
+#include "base/Profiler.h"
+#include "base/HitCount.h"
+
+#include <bqvec/VectorOps.h>
+#include <bqvec/Allocators.h>
+
+#include <stdexcept>
+
+using namespace std;
+
+static HitCount inSourceCache("MultiChannelFFT: Source data cache");
+
+MultiChannelFFT::MultiChannelFFT(const DenseTimeValueModel *model,
+                                 int channel,
+                                 int channelCount,
+                                 WindowType windowType,
+                                 int windowSize,
+                                 int windowIncrement,
+                                 int fftSize) :
+    m_model(model),
+    m_channel(channel),
+    m_channelCount(channelCount < 1 ? 1 : channelCount),
+    m_windowSize(windowSize),
+    m_windowIncrement(windowIncrement),
+    m_fftSize(fftSize),
+    m_windower(windowType, windowSize),
+    m_fft(fftSize),
+    m_timeBuffer(0),
+    m_savedRange(0, 0)
+{
+    if (m_windowSize > m_fftSize) {
+        cerr << "ERROR: MultiChannelFFT::MultiChannelFFT: window size ("
+             << m_windowSize << ") must be at least FFT size ("
+             << m_fftSize << ")" << endl;
+        throw invalid_argument("MultiChannelFFT window size must be at least FFT size");
+    }
+
+    m_fft.initFloat();
+    m_timeBuffer = breakfastquay::allocate_and_zero<float>(m_fftSize);
+}
+
+MultiChannelFFT::~MultiChannelFFT()
+{
+    breakfastquay::deallocate(m_timeBuffer);
+}
+
+bool
+MultiChannelFFT::getInterleavedColumn(int column, float **buffers)
+{
+    if (!m_model || !m_model->isOK()) {
+        for (int c = 0; c < m_channelCount; ++c) {
+            breakfastquay::v_zero(buffers[c], m_fftSize + 2);
+        }
+        return false;
+    }
+
+    Profiler profiler("MultiChannelFFT::getInterleavedColumn");
+
+    // Columns are centred on the audio sample, as in FFTModel
+    sv_frame_t startFrame =
+        m_windowIncrement * sv_frame_t(column) - m_windowSize / 2;
+    readSourceData({ startFrame, startFrame + m_windowSize });
+
+    int off = (m_fftSize - m_windowSize) / 2;
+
+    for (int c = 0; c < m_channelCount; ++c) {
+        if (off > 0) breakfastquay::v_zero(m_timeBuffer, m_fftSize);
+        m_windower.cut(m_savedData[c].data(), m_timeBuffer + off);
+        breakfastquay::v_fftshift(m_timeBuffer, m_fftSize);
+        m_fft.forwardInterleaved(m_timeBuffer, buffers[c]);
+    }
+
+    return true;
+}
+
+void
+MultiChannelFFT::readSourceData(pair<sv_frame_t, sv_frame_t> range)
+{
+    if (m_savedRange == range && !m_savedData.empty()) {
+        inSourceCache.hit();
+        return;
+    }
+
+    if (!m_savedData.empty() &&
+        range.first < m_savedRange.second &&
+        range.first >= m_savedRange.first &&
+        range.second > m_savedRange.second) {
+
+        inSourceCache.partial();
+
+        sv_frame_t discard = range.first - m_savedRange.first;
+
+        auto rest = readSourceDataUncached({ m_savedRange.second, range.second });
+
+        for (int c = 0; c < m_channelCount; ++c) {
+            floatvec_t &saved = m_savedData[c];
+            saved.erase(saved.begin(), saved.begin() + discard);
+            saved.insert(saved.end(), rest[c].begin(), rest[c].end());
+        }
+
+    } else {
+
+        inSourceCache.miss();
+
+        m_savedData = readSourceDataUncached(range);
+    }
+
+    m_savedRange = range;
+}
+
+vector<floatvec_t>
+MultiChannelFFT::readSourceDataUncached(pair<sv_frame_t, sv_frame_t> range) const
+{
+    sv_frame_t count = range.second - range.first;
+
+    sv_frame_t pfx = 0;
+    if (range.first < 0) {
+        pfx = -range.first;
+        if (pfx > count) pfx = count;
+        range = { 0, range.second };
+    }
+
+    vector<floatvec_t> data;
+
+    if (range.second > range.first) {
+        if (m_channelCount == 1) {
+            data.push_back(m_model->getData(m_channel,
+                                            range.first,
+                                            range.second - range.first));
+        } else {
+            // one read for all channels, rather than one per channel
+            data = m_model->getMultiChannelData(0, m_channelCount - 1,
+                                                range.first,
+                                                range.second - range.first);
+        }
+    }
+
+    data.resize(m_channelCount);
+
+    float factor = 1.f;
+    if (m_channelCount == 1 && m_channel == -1) {
+        int channels = m_model->getChannelCount();
+        if (channels > 1) {
+            // use mean instead of sum, as for FFTModel
+            factor = 1.f / float(channels);
+        }
+    }
+
+    for (auto &d: data) {
+        // don't return a partial frame
+        d.resize(count - pfx, 0.f);
+        if (pfx > 0) {
+            d.insert(d.begin(), size_t(pfx), 0.f);
+        }
+        if (factor != 1.f) {
+            breakfastquay::v_scale(d.data(), factor, int(d.size()));
+        }
+    }
+
+    return data;
+}
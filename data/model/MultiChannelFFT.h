@@ -0,0 +1,99 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+
+/*
+    Sonic Visualiser
+    An audio file viewer and annotation editor.
+    Centre for Digital Music, Queen Mary, University of London.
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation; either version 2 of the
+    License, or (at your option) any later version.  See the file
+    COPYING included with this distribution for more information.
+*/
+
+#ifndef SV_MULTI_CHANNEL_FFT_H
+#define SV_MULTI_CHANNEL_FFT_H
+
+#include "base/BaseTypes.h"
+#include "base/Window.h"
+
+#include <bqfft/FFT.h>
+
+#include <vector>
+
+class DenseTimeValueModel;
+
+/**
+ * Calculate short-time FFT columns for several channels of a
+ * DenseTimeValueModel at once. Each column's source frames are read
+ * from the model in a single multi-channel request (and overlapping
+ * frames from the previous column are retained rather than re-read),
+ * and the results are written directly into caller-supplied
+ * interleaved real/imaginary buffers, in the layout expected by Vamp
+ * frequency-domain plugins.
+ *
+ * Columns are centred on their audio sample in the same way as those
+ * of FFTModel, so column n of this object for a given channel has the
+ * same values as column n of an FFTModel with the same parameters.
+ *
+ * This is intended for sequential consumers such as the feature
+ * extraction transformer, which need every channel of every column
+ * exactly once; unlike FFTModel it does no column caching and is not
+ * a model. It is not thread-safe.
+ */
+class MultiChannelFFT
+{
+public:
+    /**
+     * Construct an FFT provider for the given model. If channelCount
+     * is 1, compute only the given channel (which may be -1 to use a
+     * mean of all channels, as for FFTModel). Otherwise compute
+     * channels 0 to channelCount-1, ignoring the channel argument.
+     */
+    MultiChannelFFT(const DenseTimeValueModel *model,
+                    int channel,
+                    int channelCount,
+                    WindowType windowType,
+                    int windowSize,
+                    int windowIncrement,
+                    int fftSize);
+    ~MultiChannelFFT();
+
+    int getChannelCount() const { return m_channelCount; }
+    int getWindowSize() const { return m_windowSize; }
+    int getWindowIncrement() const { return m_windowIncrement; }
+    int getFFTSize() const { return m_fftSize; }
+
+    /**
+     * Calculate the FFT of the given column for all channels,
+     * writing the output for channel c into buffers[c] as
+     * interleaved real and imaginary values. Each buffer must have
+     * room for fftSize + 2 floats. Return false (with zero-filled
+     * buffers) if the model is not available.
+     */
+    bool getInterleavedColumn(int column, float **buffers);
+
+private:
+    MultiChannelFFT(const MultiChannelFFT &); // not implemented
+    MultiChannelFFT &operator=(const MultiChannelFFT &); // not implemented
+
+    const DenseTimeValueModel *m_model;
+    int m_channel;
+    int m_channelCount;
+    int m_windowSize;
+    int m_windowIncrement;
+    int m_fftSize;
+    Window<float> m_windower;
+    breakfastquay::FFT m_fft;
+    float *m_timeBuffer;
+
+    std::pair<sv_frame_t, sv_frame_t> m_savedRange;
+    std::vector<floatvec_t> m_savedData; // per channel
+
+    void readSourceData(std::pair<sv_frame_t, sv_frame_t> range);
+    std::vector<floatvec_t> readSourceDataUncached
+    (std::pair<sv_frame_t, sv_frame_t> range) const;
+};
+
+#endif
@@ -81,6 +81,8 @@ ReadOnlyWaveFileModel::ReadOnlyWaveFileModel(FileSource source, sv_samplerate_t
     if (m_reader) setObjectName(m_reader->getTitle());
     if (objectName() == "") setObjectName(QFileInfo(m_path).fileName());
     if (isOK()) fillCache();
+
+    registerModel(this);
 }
 
 ReadOnlyWaveFileModel::ReadOnlyWaveFileModel(FileSource source, AudioFileReader *reader) :
@@ -98,10 +100,14 @@ ReadOnlyWaveFileModel::ReadOnlyWaveFileModel(FileSource source, AudioFileReader
     if (m_reader) setObjectName(m_reader->getTitle());
     if (objectName() == "") setObjectName(QFileInfo(m_path).fileName());
     fillCache();
+
+    registerModel(this);
 }
 
 ReadOnlyWaveFileModel::~ReadOnlyWaveFileModel()
 {
+    unregisterModel(this);
+
     m_exiting = true;
     if (m_fillThread) m_fillThread->wait();
     if (m_myReader) delete m_reader;
@@ -205,6 +211,22 @@ ReadOnlyWaveFileModel::getLocalFilename() const
     if (m_reader) return m_reader->getLocalFilename();
     return "";
 }
+
+size_t
+ReadOnlyWaveFileModel::getMemoryUsage() const
+{
+    size_t bytes = 0;
+    {
+        QMutexLocker locker(&m_mutex);
+        bytes += (m_cache[0].capacity() + m_cache[1].capacity()) * sizeof(Range);
+    }
+    {
+        QMutexLocker locker(&m_directReadMutex);
+        bytes += m_directRead.capacity() * sizeof(float);
+    }
+    if (m_reader) bytes += m_reader->getMemoryUsage();
+    return bytes;
+}
     
 floatvec_t
 ReadOnlyWaveFileModel::getData(int channel, sv_frame_t start, sv_frame_t count) const
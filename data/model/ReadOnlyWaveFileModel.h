@@ -78,6 +78,8 @@ public:
 
     QString getTypeName() const { return tr("Wave File"); }
 
+    virtual size_t getMemoryUsage() const;
+
     virtual void toXml(QTextStream &out,
                        QString indent = "",
                        QString extraAttributes = "") const;
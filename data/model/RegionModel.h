@@ -165,11 +165,11 @@ public:
             return IntervalModel<RegionRec>::getData(row, column, role);
         }
 
-        PointListConstIterator i = getPointListIteratorForRow(row);
-        if (i == m_points.end()) return QVariant();
+        Point point(0);
+        if (!getPointForRow(row, point)) return QVariant();
 
         switch (column) {
-        case 4: return i->label;
+        case 4: return point.label;
         default: return QVariant();
         }
     }
@@ -182,11 +182,10 @@ public:
         }
 
         if (role != Qt::EditRole) return 0;
-        PointListIterator i = getPointListIteratorForRow(row);
-        if (i == m_points.end()) return 0;
+        Point point(0);
+        if (!getPointForRow(row, point)) return 0;
         EditCommand *command = new EditCommand(this, tr("Edit Data"));
 
-        Point point(*i);
         command->deletePoint(point);
 
         switch (column) {
@@ -208,6 +207,14 @@ public:
         if (point.value != 0.f) m_haveDistinctValues = true;
         IntervalModel<RegionRec>::addPoint(point);
     }
+
+    virtual void addPoints(const std::vector<Point> &points)
+    {
+        for (const auto &p : points) {
+            if (p.value != 0.f) m_haveDistinctValues = true;
+        }
+        IntervalModel<RegionRec>::addPoints(points);
+    }
     
 protected:
     float m_valueQuantization;
@@ -20,20 +20,59 @@
 #include "TabularModel.h"
 #include "base/Command.h"
 #include "base/RealTime.h"
+#include "base/ChunkedMultiset.h"
 #include "system/System.h"
 
 #include <iostream>
 
 #include <set>
+#include <functional>
 #include <vector>
 #include <algorithm>
 #include <iterator>
 
 #include <cmath>
 
-#include <QMutex>
+#include <QReadWriteLock>
+#include <QReadLocker>
+#include <QWriteLocker>
 #include <QTextStream>
 
+/**
+ * The container type used for the points of a SparseModel. By default
+ * this is a std::multiset ordered by PointType::OrderComparator. A
+ * point type of which models commonly hold very many points may
+ * specialise this to use a ChunkedMultiset instead, which has the
+ * same ordering and read API but much better locality of reference.
+ * Note that modifying a ChunkedMultiset invalidates its iterators.
+ */
+template <typename PointType>
+struct SparseModelPointList
+{
+    typedef std::multiset<PointType,
+                          typename PointType::OrderComparator> Type;
+};
+
+/**
+ * Return an estimate of the number of bytes allocated for the points
+ * in a SparseModel point list, for either container type.
+ */
+template <typename PointType, typename Compare>
+size_t
+getPointListMemoryUsage(const std::multiset<PointType, Compare> &points)
+{
+    // Each tree node holds three pointers and a colour beside the point
+    return points.size() * (sizeof(PointType) + 4 * sizeof(void *));
+}
+
+template <typename PointType, typename Compare, int chunkSize>
+size_t
+getPointListMemoryUsage(const ChunkedMultiset<PointType, Compare,
+                                              chunkSize> &points)
+{
+    return points.getMemoryUsage();
+}
+
 /**
  * Model containing sparse data (points with some properties).  The
  * properties depend on the point type.
@@ -46,7 +85,7 @@ class SparseModel : public Model,
 public:
     SparseModel(sv_samplerate_t sampleRate, int resolution,
 		bool notifyOnAdd = true);
-    virtual ~SparseModel() { }
+    virtual ~SparseModel() { Model::unregisterModel(this); }
     
     virtual bool isOK() const { return true; }
     virtual sv_frame_t getStartFrame() const;
@@ -70,8 +109,7 @@ public:
     virtual void extendEndFrame(sv_frame_t to) { m_extendTo = to; }
     
     typedef PointType Point;
-    typedef std::multiset<PointType,
-			  typename PointType::OrderComparator> PointList;
+    typedef typename SparseModelPointList<PointType>::Type PointList;
     typedef typename PointList::iterator PointListIterator;
     typedef typename PointList::const_iterator PointListConstIterator;
 
@@ -86,9 +124,17 @@ public:
     virtual int getPointCount() const;
 
     /**
-     * Get all points.
+     * Get a copy of all points, taken with the model's lock held, so
+     * that it can be iterated over while another thread (such as a
+     * running transform) adds to the model. It costs time and memory
+     * in proportion to the size of the model, so prefer
+     * visitAllPoints where a copy isn't needed.
+     *
+     * There is deliberately no method returning a reference to the
+     * points themselves, as any change to the model may invalidate
+     * iterators into them.
      */
-    virtual const PointList &getPoints() const;
+    virtual PointList getPointsCopy() const;
 
     /**
      * Get all of the points in this model between the given
@@ -116,6 +162,50 @@ public:
      */
     virtual PointList getNextPoints(sv_frame_t frame) const;
 
+    /**
+     * Function called for each point by the visit methods below.
+     */
+    typedef std::function<void (const PointType &)> PointVisitor;
+
+    /**
+     * Call the given visitor for every point in the model, in order.
+     *
+     * The visit methods do not copy the points, and hold the model's
+     * lock for reading throughout. Other threads may read the model
+     * at the same time, but the visitor must not call back into the
+     * model (except for methods such as getSampleRate that need no
+     * lock) and must not retain references to the points.
+     */
+    virtual void visitAllPoints(const PointVisitor &visitor) const;
+
+    /**
+     * Call the given visitor for each of the points that getPoints
+     * with the same arguments would return, in order.
+     */
+    virtual void visitPointsWithin(sv_frame_t start, sv_frame_t end,
+                                   const PointVisitor &visitor) const;
+
+    /**
+     * Call the given visitor for each of the points that getPoints
+     * with the same frame would return, in order.
+     */
+    virtual void visitPointsAt(sv_frame_t frame,
+                               const PointVisitor &visitor) const;
+
+    /**
+     * Call the given visitor for each of the points that
+     * getPreviousPoints would return, in order.
+     */
+    virtual void visitPreviousPoints(sv_frame_t frame,
+                                     const PointVisitor &visitor) const;
+
+    /**
+     * Call the given visitor for each of the points that
+     * getNextPoints would return, in order.
+     */
+    virtual void visitNextPoints(sv_frame_t frame,
+                                 const PointVisitor &visitor) const;
+
     /**
      * Remove all points.
      */
@@ -126,6 +216,15 @@ public:
      */
     virtual void addPoint(const PointType &point);
 
+    /**
+     * Add all of the given points, which need not be in order. This
+     * has the same result as calling addPoint for each in turn, but
+     * takes the lock once and sends at most one change notification
+     * covering them all. A batch that is large compared with the
+     * model is merged with the existing points in a single pass.
+     */
+    virtual void addPoints(const std::vector<PointType> &points);
+
     /** 
      * Remove a point.  Points are not necessarily unique, so this
      * function will remove the first point that compares equal to the
@@ -134,6 +233,14 @@ public:
      */
     virtual void deletePoint(const PointType &point);
 
+    /**
+     * Remove each of the given points, as deletePoint would, taking
+     * the lock once and sending one change notification covering
+     * them all. The points need not be in order. A batch that is
+     * large compared with the model is removed in a single pass.
+     */
+    virtual void deletePoints(const std::vector<PointType> &points);
+
     /**
      * Return true if the given point is found in this model, false
      * otherwise.
@@ -153,6 +260,12 @@ public:
 
     QString getTypeName() const { return tr("Sparse"); }
 
+    /**
+     * The points and the row index, not counting any text or other
+     * data that the points themselves refer to.
+     */
+    virtual size_t getMemoryUsage() const;
+
     virtual QString getXmlOutputType() const { return "sparse"; }
 
     virtual void toXml(QTextStream &out,
@@ -177,19 +290,24 @@ public:
     }
 
     virtual QString toDelimitedDataStringSubsetWithOptions(QString delimiter, DataExportOptions opts, sv_frame_t f0, sv_frame_t f1) const {
-        if (opts & DataExportFillGaps) {
-            return toDelimitedDataStringSubsetFilled(delimiter, opts, f0, f1);
-        } else {
-            QString s;
-            for (PointListConstIterator i = m_points.begin(); i != m_points.end(); ++i) {
-                if (i->frame >= f0 && i->frame < f1) {
-                    s += i->toDelimitedDataString(delimiter, opts, m_sampleRate) + "\n";
-                }
-            }
-            return s;
-        }
+        QString s;
+        QTextStream out(&s);
+        writeDelimitedDataSubset(out, delimiter, opts, f0, f1);
+        out.flush();
+        return s;
     }
 
+    virtual void writeDelimitedData(QTextStream &out, QString delimiter,
+                                    DataExportOptions opts) const {
+        writeDelimitedDataSubset
+            (out, delimiter, opts,
+             std::min(getStartFrame(), sv_frame_t(0)), getEndFrame() + 1);
+    }
+
+    virtual void writeDelimitedDataSubset(QTextStream &out, QString delimiter,
+                                          DataExportOptions opts,
+                                          sv_frame_t f0, sv_frame_t f1) const;
+
     /**
      * Command to add a point, with undo.
      */
@@ -271,6 +389,56 @@ public:
     };
 
 
+    /**
+     * Command to add or remove any number of points, with undo, for
+     * edits too large for EditCommand. It stores only the points
+     * themselves, in two sorted arrays, and applies and reverts them
+     * with addPoints and deletePoints.
+     *
+     * Unlike EditCommand, this does not change the model until
+     * finish() is called. Points to delete are then removed from the
+     * model as it was before the command, and points to add are added
+     * afterwards. Deleting a point just after adding it cancels the
+     * addition, as with EditCommand, but otherwise a point added by
+     * the command cannot also be deleted by it.
+     */
+    class BatchEditCommand : public Command
+    {
+    public:
+	BatchEditCommand(SparseModel<PointType> *model, QString commandName) :
+	    m_model(model), m_name(commandName) { }
+
+	void addPoint(const PointType &point);
+	void deletePoint(const PointType &point);
+
+	virtual QString getName() const { return m_name; }
+
+	virtual void execute() {
+	    m_model->deletePoints(m_deleted);
+	    m_model->addPoints(m_added);
+	}
+
+	virtual void unexecute() {
+	    m_model->deletePoints(m_added);
+	    m_model->addPoints(m_deleted);
+	}
+
+	/**
+	 * If any points are to be added or deleted, execute this
+	 * command and return it (so the caller can add it to the
+	 * command history). Otherwise delete the command and return
+	 * NULL.
+	 */
+	BatchEditCommand *finish();
+
+    private:
+	SparseModel<PointType> *m_model;
+	QString m_name;
+	std::vector<PointType> m_added;
+	std::vector<PointType> m_deleted;
+    };
+
+
     /**
      * Command to relabel a point.
      */
@@ -311,29 +479,28 @@ public:
 
     virtual sv_frame_t getFrameForRow(int row) const
     {
-        PointListConstIterator i = getPointListIteratorForRow(row);
-        if (i == m_points.end()) return 0;
-        return i->frame;
+        Point point(0);
+        if (!getPointForRow(row, point)) return 0;
+        return point.frame;
     }
 
     virtual int getRowForFrame(sv_frame_t frame) const
     {
-        if (m_rows.empty()) rebuildRowVector();
-        std::vector<sv_frame_t>::iterator i =
-            std::lower_bound(m_rows.begin(), m_rows.end(), frame);
-        ssize_t row = std::distance(m_rows.begin(), i);
+        QReadLocker locker(&m_lock);
+        RowIndex::const_iterator i = m_rows.lower_bound(frame);
+        int row = int(m_rows.rank(i));
         if (i != m_rows.begin() && (i == m_rows.end() || *i != frame)) {
             --row;
         }
-        return int(row);
+        return row;
     }
 
     virtual int getColumnCount() const { return 1; }
     virtual QVariant getData(int row, int column, int role) const
     {
-        PointListConstIterator i = getPointListIteratorForRow(row);
-        if (i == m_points.end()) {
-//            cerr << "no iterator for row " << row << " (have " << getRowCount() << " rows)" << endl;
+        Point point(0);
+        if (!getPointForRow(row, point)) {
+//            cerr << "no point for row " << row << " (have " << getRowCount() << " rows)" << endl;
             return QVariant();
         }
 
@@ -341,12 +508,12 @@ public:
         
         switch (column) {
         case 0: {
-            if (role == SortRole) return int(i->frame);
-            RealTime rt = RealTime::frame2RealTime(i->frame, getSampleRate());
+            if (role == SortRole) return int(point.frame);
+            RealTime rt = RealTime::frame2RealTime(point.frame, getSampleRate());
             if (role == Qt::EditRole) return rt.toString().c_str();
             else return rt.toText().c_str();
         }
-        case 1: return int(i->frame);
+        case 1: return int(point.frame);
         }
 
         return QVariant();
@@ -356,11 +523,10 @@ public:
                                        const QVariant &value, int role)
     {
         if (role != Qt::EditRole) return 0;
-        PointListIterator i = getPointListIteratorForRow(row);
-        if (i == m_points.end()) return 0;
+        Point point(0);
+        if (!getPointForRow(row, point)) return 0;
         EditCommand *command = new EditCommand(this, tr("Edit Data"));
 
-        Point point(*i);
         command->deletePoint(point);
 
         switch (column) {
@@ -376,19 +542,20 @@ public:
     {
         EditCommand *command = new EditCommand(this, tr("Insert Data Point"));
         Point point(0);
-        PointListIterator i = getPointListIteratorForRow(row);
-        if (i == m_points.end() && i != m_points.begin()) --i;
-        if (i != m_points.end()) point = *i;
+        if (!getPointForRow(row, point)) {
+            // past the end: copy the last point, if there is one
+            getPointForRow(getRowCount() - 1, point);
+        }
         command->addPoint(point);
         return command->finish();
     }
             
     virtual Command *getRemoveRowCommand(int row)
     {
-        PointListIterator i = getPointListIteratorForRow(row);
-        if (i == m_points.end()) return 0;
+        Point point(0);
+        if (!getPointForRow(row, point)) return 0;
         EditCommand *command = new EditCommand(this, tr("Delete Data Point"));
-        command->deletePoint(*i);
+        command->deletePoint(point);
         return command->finish();
     }
             
@@ -403,134 +570,69 @@ protected:
 
     PointList m_points;
     int m_pointCount;
-    mutable QMutex m_mutex;
+    // Held for reading by queries, so that several threads can read
+    // at once, and for writing by anything that changes the points
+    // or the indexes built from them
+    mutable QReadWriteLock m_lock;
     int m_completion;
 
-    void getPointIterators(sv_frame_t frame,
-                           PointListIterator &startItr,
-                           PointListIterator &endItr);
-    void getPointIterators(sv_frame_t frame,
-                           PointListConstIterator &startItr,
-                           PointListConstIterator &endItr) const;
-
-    // This is only used if the model is called on to act in
-    // TabularModel mode
-    mutable std::vector<sv_frame_t> m_rows; // map from row number to frame
-
-    void rebuildRowVector() const
+    // Remove the first point that compares equal to the given one,
+    // returning true if there was one. Call with m_lock held for
+    // writing
+    bool removePoint(const PointType &point);
+
+    // Called with m_lock held for writing after a point has been
+    // added to or removed from m_points, and after it has been
+    // cleared, so that subclasses can keep indexes of their own
+    virtual void pointAdded(const PointType &) { }
+    virtual void pointRemoved(const PointType &) { }
+    virtual void pointsCleared() { }
+
+    // This is used when the model is called on to act in TabularModel
+    // mode. It holds the frame of every point, and maps between row
+    // numbers and frames in logarithmic time. It is kept up to date
+    // with m_points whenever points are added or removed, with m_lock
+    // held for writing, so that row lookups need only a read lock
+    typedef ChunkedMultiset<sv_frame_t> RowIndex;
+    RowIndex m_rows;
+
+    void rebuildRowIndex()
     {
         m_rows.clear();
         for (PointListConstIterator i = m_points.begin(); i != m_points.end(); ++i) {
-//            std::cerr << "rebuildRowVector: row " << m_rows.size() << " -> " << i->frame << std::endl;
-            m_rows.push_back(i->frame);
+            m_rows.insert(i->frame);
         }
     }
 
-    PointListIterator getPointListIteratorForRow(int row)
+    // Return the number of points before the given row that have the
+    // same frame as it, setting frame. Call with m_lock held
+    int getRowPosition(int row, sv_frame_t &frame) const
     {
-        if (m_rows.empty()) rebuildRowVector();
-        if (row < 0 || row + 1 > int(m_rows.size())) return m_points.end();
-
-        sv_frame_t frame = m_rows[row];
-        int indexAtFrame = 0;
-        int ri = row;
-        while (ri > 0 && m_rows[ri-1] == m_rows[row]) { --ri; ++indexAtFrame; }
-        int initialIndexAtFrame = indexAtFrame;
-
-        PointListIterator i0, i1;
-        getPointIterators(frame, i0, i1);
-        PointListIterator i = i0;
-
-        for (i = i0; i != i1; ++i) {
-            if (i->frame < (int)frame) { continue; }
-            if (indexAtFrame > 0) { --indexAtFrame; continue; }
-            return i;
-        }
-
-        if (indexAtFrame > 0) {
-            std::cerr << "WARNING: SparseModel::getPointListIteratorForRow: No iterator available for row " << row << " (frame = " << frame << ", index at frame = " << initialIndexAtFrame << ", leftover index " << indexAtFrame << ")" << std::endl;
-        }
-        return i;
+        RowIndex::const_iterator i = m_rows.nth(size_t(row));
+        frame = *i;
+        return row - int(m_rows.rank(m_rows.lower_bound(frame)));
     }
 
-    PointListConstIterator getPointListIteratorForRow(int row) const
+    // Copy the point at the given row into point, returning false if
+    // there is no such row. The point is copied out before the lock
+    // is released, because any change to m_points may invalidate
+    // iterators into it
+    bool getPointForRow(int row, PointType &point) const
     {
-        if (m_rows.empty()) rebuildRowVector();
-        if (row < 0 || row + 1 > int(m_rows.size())) return m_points.end();
-
-        sv_frame_t frame = m_rows[row];
-        int indexAtFrame = 0;
-        int ri = row;
-        while (ri > 0 && m_rows[ri-1] == m_rows[row]) { --ri; ++indexAtFrame; }
-        int initialIndexAtFrame = indexAtFrame;
-
-//        std::cerr << "getPointListIteratorForRow " << row << ": initialIndexAtFrame = " << initialIndexAtFrame << " for frame " << frame << std::endl;
-
-        PointListConstIterator i0, i1;
-        getPointIterators(frame, i0, i1);
-        PointListConstIterator i = i0;
-
-        for (i = i0; i != i1; ++i) {
-//            std::cerr << "i->frame is " << i->frame << ", wanting " << frame << std::endl;
-
-            if (i->frame < (int)frame) { continue; }
-            if (indexAtFrame > 0) { --indexAtFrame; continue; }
-            return i;
-        }
-/*
-        if (i == m_points.end()) {
-            std::cerr << "returning i at end" << std::endl;
-        } else {
-            std::cerr << "returning i with i->frame = " << i->frame << std::endl;
-        }
-*/
-        if (indexAtFrame > 0) {
-            std::cerr << "WARNING: SparseModel::getPointListIteratorForRow: No iterator available for row " << row << " (frame = " << frame << ", index at frame = " << initialIndexAtFrame << ", leftover index " << indexAtFrame << ")" << std::endl;
-        }
-        return i;
-    }
+        QReadLocker locker(&m_lock);
+        if (row < 0 || row >= int(m_points.size())) return false;
 
-    QString toDelimitedDataStringSubsetFilled(QString delimiter,
-                                              DataExportOptions opts,
-                                              sv_frame_t f0,
-                                              sv_frame_t f1) const {
-
-        QString s;
-        opts &= ~DataExportFillGaps;
-
-        // find frame time of first point in range (if any)
-        sv_frame_t first = f0;
-        for (auto &p: m_points) {
-            if (p.frame >= f0) {
-                first = p.frame;
-                break;
-            }
-        }
+        sv_frame_t frame = 0;
+        int indexAtFrame = getRowPosition(row, frame);
 
-        // project back to first frame time in range according to
-        // resolution.  e.g. if f0 = 2, first = 9, resolution = 4 then
-        // we start at 5 (because 1 is too early and we need to arrive
-        // at 9 to match the first actual point). This method is
-        // stupid but easy to understand:
-        sv_frame_t f = first;
-        while (f >= f0 + m_resolution) f -= m_resolution;
-        
-        // now progress, either writing the next point (if within
-        // distance) or a default point
-        PointListConstIterator itr = m_points.begin();
-
-        while (f < f1) {
-            if (itr != m_points.end() && itr->frame <= f) {
-                s += itr->toDelimitedDataString(delimiter, opts, m_sampleRate);
-                ++itr;
-            } else {
-                s += Point(f).toDelimitedDataString(delimiter, opts, m_sampleRate);
-            }
-            s += "\n";
-            f += m_resolution;
+        PointListConstIterator i = m_points.lower_bound(PointType(frame));
+        while (indexAtFrame > 0 && i != m_points.end()) {
+            ++i;
+            --indexAtFrame;
         }
-
-        return s;
+        if (i == m_points.end()) return false;
+        point = *i;
+        return true;
     }
 };
 
@@ -555,7 +657,7 @@ template <typename PointType>
 sv_frame_t
 SparseModel<PointType>::getStartFrame() const
 {
-    QMutexLocker locker(&m_mutex);
+    QReadLocker locker(&m_lock);
     sv_frame_t f = 0;
     if (!m_points.empty()) {
 	f = m_points.begin()->frame;
@@ -567,7 +669,7 @@ template <typename PointType>
 sv_frame_t
 SparseModel<PointType>::getEndFrame() const
 {
-    QMutexLocker locker(&m_mutex);
+    QReadLocker locker(&m_lock);
     sv_frame_t f = 0;
     if (!m_points.empty()) {
 	PointListConstIterator i(m_points.end());
@@ -592,9 +694,20 @@ SparseModel<PointType>::getPointCount() const
 }
 
 template <typename PointType>
-const typename SparseModel<PointType>::PointList &
-SparseModel<PointType>::getPoints() const
+size_t
+SparseModel<PointType>::getMemoryUsage() const
 {
+    QReadLocker locker(&m_lock);
+    size_t bytes = getPointListMemoryUsage(m_points);
+    bytes += m_rows.getMemoryUsage();
+    return bytes;
+}
+
+template <typename PointType>
+typename SparseModel<PointType>::PointList
+SparseModel<PointType>::getPointsCopy() const
+{
+    QReadLocker locker(&m_lock);
     return m_points;
 }
 
@@ -602,25 +715,8 @@ template <typename PointType>
 typename SparseModel<PointType>::PointList
 SparseModel<PointType>::getPoints(sv_frame_t start, sv_frame_t end) const
 {
-    if (start > end) return PointList();
-    QMutexLocker locker(&m_mutex);
-
-    PointType startPoint(start), endPoint(end);
-    
-    PointListConstIterator startItr = m_points.lower_bound(startPoint);
-    PointListConstIterator   endItr = m_points.upper_bound(endPoint);
-
-    if (startItr != m_points.begin()) --startItr;
-    if (startItr != m_points.begin()) --startItr;
-    if (endItr != m_points.end()) ++endItr;
-    if (endItr != m_points.end()) ++endItr;
-
     PointList rv;
-
-    for (PointListConstIterator i = startItr; i != endItr; ++i) {
-	rv.insert(*i);
-    }
-
+    visitPointsWithin(start, end, [&rv](const PointType &p) { rv.insert(p); });
     return rv;
 }
 
@@ -628,109 +724,185 @@ template <typename PointType>
 typename SparseModel<PointType>::PointList
 SparseModel<PointType>::getPoints(sv_frame_t frame) const
 {
-    PointListConstIterator startItr, endItr;
-    getPointIterators(frame, startItr, endItr);
-
     PointList rv;
-
-    for (PointListConstIterator i = startItr; i != endItr; ++i) {
-	rv.insert(*i);
-    }
-
+    visitPointsAt(frame, [&rv](const PointType &p) { rv.insert(p); });
     return rv;
 }
 
 template <typename PointType>
 void
-SparseModel<PointType>::getPointIterators(sv_frame_t frame,
-                                          PointListIterator &startItr,
-                                          PointListIterator &endItr)
+SparseModel<PointType>::visitAllPoints(const PointVisitor &visitor) const
 {
-    QMutexLocker locker(&m_mutex);
+    QReadLocker locker(&m_lock);
 
-    if (m_resolution == 0) {
-        startItr = m_points.end();
-        endItr = m_points.end();
-        return;
+    for (PointListConstIterator i = m_points.begin(); i != m_points.end(); ++i) {
+        visitor(*i);
     }
+}
 
-    sv_frame_t start = (frame / m_resolution) * m_resolution;
-    sv_frame_t end = start + m_resolution;
+template <typename PointType>
+void
+SparseModel<PointType>::visitPointsWithin(sv_frame_t start, sv_frame_t end,
+                                          const PointVisitor &visitor) const
+{
+    if (start > end) return;
+    QReadLocker locker(&m_lock);
 
     PointType startPoint(start), endPoint(end);
+    
+    PointListConstIterator startItr = m_points.lower_bound(startPoint);
+    PointListConstIterator   endItr = m_points.upper_bound(endPoint);
 
-    startItr = m_points.lower_bound(startPoint);
-      endItr = m_points.upper_bound(endPoint);
+    if (startItr != m_points.begin()) --startItr;
+    if (startItr != m_points.begin()) --startItr;
+    if (endItr != m_points.end()) ++endItr;
+    if (endItr != m_points.end()) ++endItr;
+
+    for (PointListConstIterator i = startItr; i != endItr; ++i) {
+        visitor(*i);
+    }
 }
 
 template <typename PointType>
 void
-SparseModel<PointType>::getPointIterators(sv_frame_t frame,
-                                          PointListConstIterator &startItr,
-                                          PointListConstIterator &endItr) const
+SparseModel<PointType>::visitPointsAt(sv_frame_t frame,
+                                      const PointVisitor &visitor) const
 {
-    QMutexLocker locker(&m_mutex);
+    QReadLocker locker(&m_lock);
 
-    if (m_resolution == 0) {
-//        std::cerr << "getPointIterators: resolution == 0, returning end()" << std::endl;
-        startItr = m_points.end();
-        endItr = m_points.end();
-        return;
-    }
+    if (m_resolution == 0) return;
 
     sv_frame_t start = (frame / m_resolution) * m_resolution;
     sv_frame_t end = start + m_resolution;
 
     PointType startPoint(start), endPoint(end);
-    
-//    std::cerr << "getPointIterators: start frame " << start << ", end frame " << end << ", m_resolution " << m_resolution << std::endl;
 
-    startItr = m_points.lower_bound(startPoint);
-      endItr = m_points.upper_bound(endPoint);
+    PointListConstIterator startItr = m_points.lower_bound(startPoint);
+    PointListConstIterator   endItr = m_points.upper_bound(endPoint);
+
+    for (PointListConstIterator i = startItr; i != endItr; ++i) {
+        visitor(*i);
+    }
 }
 
 template <typename PointType>
 typename SparseModel<PointType>::PointList
 SparseModel<PointType>::getPreviousPoints(sv_frame_t originFrame) const
 {
-    QMutexLocker locker(&m_mutex);
+    PointList rv;
+    visitPreviousPoints(originFrame, [&rv](const PointType &p) { rv.insert(p); });
+    return rv;
+}
+ 
+template <typename PointType>
+typename SparseModel<PointType>::PointList
+SparseModel<PointType>::getNextPoints(sv_frame_t originFrame) const
+{
+    PointList rv;
+    visitNextPoints(originFrame, [&rv](const PointType &p) { rv.insert(p); });
+    return rv;
+}
+
+template <typename PointType>
+void
+SparseModel<PointType>::visitPreviousPoints(sv_frame_t originFrame,
+                                            const PointVisitor &visitor) const
+{
+    QReadLocker locker(&m_lock);
 
     PointType lookupPoint(originFrame);
-    PointList rv;
 
     PointListConstIterator i = m_points.lower_bound(lookupPoint);
-    if (i == m_points.begin()) return rv;
+    if (i == m_points.begin()) return;
 
+    // Step back to the first of the points at the nearest earlier
+    // frame, then visit them forwards
+    PointListConstIterator end = i;
     --i;
     sv_frame_t frame = i->frame;
-    while (i->frame == frame) {
-	rv.insert(*i);
-	if (i == m_points.begin()) break;
-	--i;
+    while (i != m_points.begin()) {
+        PointListConstIterator j = i;
+        if ((--j)->frame != frame) break;
+        i = j;
     }
 
-    return rv;
+    for ( ; i != end; ++i) {
+        visitor(*i);
+    }
 }
  
 template <typename PointType>
-typename SparseModel<PointType>::PointList
-SparseModel<PointType>::getNextPoints(sv_frame_t originFrame) const
+void
+SparseModel<PointType>::visitNextPoints(sv_frame_t originFrame,
+                                        const PointVisitor &visitor) const
 {
-    QMutexLocker locker(&m_mutex);
+    QReadLocker locker(&m_lock);
 
     PointType lookupPoint(originFrame);
-    PointList rv;
 
     PointListConstIterator i = m_points.upper_bound(lookupPoint);
-    if (i == m_points.end()) return rv;
+    if (i == m_points.end()) return;
 
     sv_frame_t frame = i->frame;
     while (i != m_points.end() && i->frame == frame) {
-	rv.insert(*i);
+        visitor(*i);
 	++i;
     }
+}
 
-    return rv;
+template <typename PointType>
+void
+SparseModel<PointType>::writeDelimitedDataSubset(QTextStream &out,
+                                                 QString delimiter,
+                                                 DataExportOptions opts,
+                                                 sv_frame_t f0,
+                                                 sv_frame_t f1) const
+{
+    QReadLocker locker(&m_lock);
+
+    PointListConstIterator i = m_points.lower_bound(PointType(f0));
+
+    if (!(opts & DataExportFillGaps) || m_resolution == 0) {
+        opts &= ~DataExportFillGaps;
+        for ( ; i != m_points.end() && i->frame < f1; ++i) {
+            out << i->toDelimitedDataString(delimiter, opts, m_sampleRate)
+                << "\n";
+        }
+        return;
+    }
+
+    opts &= ~DataExportFillGaps;
+
+    // Start at the first frame in range that is a whole number of
+    // resolution steps before the first point in range (if any).
+    // e.g. if f0 = 2, the first point is at 9, and resolution = 4,
+    // then we start at 5 (because 1 is too early and we need to
+    // arrive at 9 to match the first actual point)
+    sv_frame_t f = f0;
+    if (i != m_points.end()) {
+        f = i->frame - ((i->frame - f0) / m_resolution) * m_resolution;
+    }
+
+    // now progress, either writing the next point (if within
+    // distance) or a default point
+    for ( ; i != m_points.end() && f < f1; ++i) {
+        while (f < f1 && i->frame > f) {
+            out << Point(f).toDelimitedDataString(delimiter, opts, m_sampleRate)
+                << "\n";
+            f += m_resolution;
+        }
+        if (f < f1) {
+            out << i->toDelimitedDataString(delimiter, opts, m_sampleRate)
+                << "\n";
+            f += m_resolution;
+        }
+    }
+
+    while (f < f1) {
+        out << Point(f).toDelimitedDataString(delimiter, opts, m_sampleRate)
+            << "\n";
+        f += m_resolution;
+    }
 }
 
 template <typename PointType>
@@ -738,9 +910,8 @@ void
 SparseModel<PointType>::setResolution(int resolution)
 {
     {
-	QMutexLocker locker(&m_mutex);
+	QWriteLocker locker(&m_lock);
 	m_resolution = resolution;
-        m_rows.clear();
     }
     emit modelChanged();
 }
@@ -750,10 +921,11 @@ void
 SparseModel<PointType>::clear()
 {
     {
-	QMutexLocker locker(&m_mutex);
+	QWriteLocker locker(&m_lock);
 	m_points.clear();
         m_pointCount = 0;
         m_rows.clear();
+        pointsCleared();
     }
     emit modelChanged();
 }
@@ -762,10 +934,12 @@ template <typename PointType>
 void
 SparseModel<PointType>::addPoint(const PointType &point)
 {
-    QMutexLocker locker(&m_mutex);
+    QWriteLocker locker(&m_lock);
 
     m_points.insert(point);
     m_pointCount++;
+    pointAdded(point);
+    m_rows.insert(point.frame);
     if (point.getLabel() != "") m_hasTextLabels = true;
 
     // Even though this model is nominally sparse, there may still be
@@ -775,7 +949,6 @@ SparseModel<PointType>::addPoint(const PointType &point)
     // alternative is to notify on setCompletion).
 
     if (m_notifyOnAdd) {
-        m_rows.clear(); //!!! inefficient
 	emit modelChangedWithin(point.frame, point.frame + m_resolution);
     } else {
 	if (m_sinceLastNotifyMin == -1 ||
@@ -789,11 +962,80 @@ SparseModel<PointType>::addPoint(const PointType &point)
     }
 }
 
+template <typename PointType>
+void
+SparseModel<PointType>::addPoints(const std::vector<PointType> &points)
+{
+    if (points.empty()) return;
+
+    // Stable, so that points at the same frame are added in the order
+    // given, as they would be by addPoint
+    std::vector<PointType> sorted(points);
+    std::stable_sort(sorted.begin(), sorted.end(),
+                     typename PointType::OrderComparator());
+
+    QWriteLocker locker(&m_lock);
+
+    typedef typename std::vector<PointType>::const_iterator SortedIterator;
+
+    if (sorted.size() > m_points.size() / 4) {
+
+        // Merge into a new list, taking existing points first where
+        // frames are equal. Each insert is at the end of the new
+        // list, which is the fast case for the list types we use
+        typename PointType::OrderComparator comparator;
+        PointList merged;
+        PointListConstIterator i = m_points.begin();
+        SortedIterator j = sorted.begin();
+        while (i != m_points.end() || j != sorted.end()) {
+            if (j == sorted.end() ||
+                (i != m_points.end() && !comparator(*j, *i))) {
+                merged.insert(merged.end(), *i);
+                ++i;
+            } else {
+                merged.insert(merged.end(), *j);
+                ++j;
+            }
+        }
+        m_points.swap(merged);
+
+        // Cheaper to rebuild the row index than to insert into it
+        rebuildRowIndex();
+
+    } else {
+        for (SortedIterator j = sorted.begin(); j != sorted.end(); ++j) {
+            m_points.insert(*j);
+            m_rows.insert(j->frame);
+        }
+    }
+
+    m_pointCount += int(sorted.size());
+
+    for (SortedIterator j = sorted.begin(); j != sorted.end(); ++j) {
+        pointAdded(*j);
+        if (j->getLabel() != "") m_hasTextLabels = true;
+    }
+
+    sv_frame_t first = sorted.begin()->frame;
+    sv_frame_t last = sorted.rbegin()->frame;
+
+    if (m_notifyOnAdd) {
+	emit modelChangedWithin(first, last + m_resolution);
+    } else {
+	if (m_sinceLastNotifyMin == -1 || first < m_sinceLastNotifyMin) {
+	    m_sinceLastNotifyMin = first;
+	}
+	if (m_sinceLastNotifyMax == -1 || last > m_sinceLastNotifyMax) {
+	    m_sinceLastNotifyMax = last;
+	}
+    }
+}
+
 template <typename PointType>
 bool
 SparseModel<PointType>::containsPoint(const PointType &point)
 {
-    QMutexLocker locker(&m_mutex);
+    QReadLocker locker(&m_lock);
 
     PointListIterator i = m_points.lower_bound(point);
     typename PointType::Comparator comparator;
@@ -812,24 +1054,97 @@ template <typename PointType>
 void
 SparseModel<PointType>::deletePoint(const PointType &point)
 {
-    QMutexLocker locker(&m_mutex);
+    QWriteLocker locker(&m_lock);
+
+    removePoint(point);
+
+//    std::cout << "SparseOneDimensionalModel: emit modelChanged("
+//	      << point.frame << ")" << std::endl;
+    emit modelChangedWithin(point.frame, point.frame + m_resolution);
+}
+
+template <typename PointType>
+void
+SparseModel<PointType>::deletePoints(const std::vector<PointType> &points)
+{
+    if (points.empty()) return;
+
+    std::vector<PointType> sorted(points);
+    std::stable_sort(sorted.begin(), sorted.end(),
+                     typename PointType::OrderComparator());
+
+    QWriteLocker locker(&m_lock);
+
+    typedef typename std::vector<PointType>::const_iterator SortedIterator;
+
+    if (sorted.size() > m_points.size() / 4) {
+
+        // Copy the points we are keeping into a new list. At each
+        // frame, each point is matched against those still to be
+        // deleted at that frame, and dropped if one compares equal
+        typename PointType::Comparator comparator;
+        PointList kept;
+        SortedIterator j = sorted.begin();
+        std::vector<PointType> pending, removed;
+        for (PointListConstIterator i = m_points.begin(); i != m_points.end(); ++i) {
+            if (i == m_points.begin() || i->frame != std::prev(i)->frame) {
+                pending.clear();
+                while (j != sorted.end() && j->frame < i->frame) ++j;
+                while (j != sorted.end() && j->frame == i->frame) {
+                    pending.push_back(*j);
+                    ++j;
+                }
+            }
+            typename std::vector<PointType>::iterator k = pending.begin();
+            while (k != pending.end() &&
+                   (comparator(*k, *i) || comparator(*i, *k))) {
+                ++k;
+            }
+            if (k == pending.end()) {
+                kept.insert(kept.end(), *i);
+            } else {
+                removed.push_back(*i);
+                m_pointCount--;
+                pending.erase(k);
+            }
+        }
+        m_points.swap(kept);
 
+        for (SortedIterator r = removed.begin(); r != removed.end(); ++r) {
+            pointRemoved(*r);
+        }
+
+        rebuildRowIndex();
+
+    } else {
+        for (SortedIterator j = sorted.begin(); j != sorted.end(); ++j) {
+            removePoint(*j);
+        }
+    }
+
+    emit modelChangedWithin(sorted.begin()->frame,
+                            sorted.rbegin()->frame + m_resolution);
+}
+
+template <typename PointType>
+bool
+SparseModel<PointType>::removePoint(const PointType &point)
+{
     PointListIterator i = m_points.lower_bound(point);
     typename PointType::Comparator comparator;
     while (i != m_points.end()) {
         if (i->frame > point.frame) break;
         if (!comparator(*i, point) && !comparator(point, *i)) {
+            PointType removed(*i);
             m_points.erase(i);
             m_pointCount--;
-            break;
+            m_rows.erase(m_rows.find(point.frame));
+            pointRemoved(removed);
+            return true;
 	    }
         ++i;
     }
-
-//    std::cout << "SparseOneDimensionalModel: emit modelChanged("
-//	      << point.frame << ")" << std::endl;
-    m_rows.clear(); //!!! inefficient
-    emit modelChangedWithin(point.frame, point.frame + m_resolution);
+    return false;
 }
 
 template <typename PointType>
@@ -838,7 +1153,7 @@ SparseModel<PointType>::setCompletion(int completion, bool update)
 {
 //    std::cerr << "SparseModel::setCompletion(" << completion << ")" << std::endl;
 
-    QMutexLocker locker(&m_mutex);
+    QWriteLocker locker(&m_lock);
 
     if (m_completion != completion) {
 	m_completion = completion;
@@ -850,7 +1165,6 @@ SparseModel<PointType>::setCompletion(int completion, bool update)
             }
 
 	    m_notifyOnAdd = true; // henceforth
-            m_rows.clear(); //!!! inefficient
 	    emit modelChanged();
 
 	} else if (!m_notifyOnAdd) {
@@ -858,7 +1172,6 @@ SparseModel<PointType>::setCompletion(int completion, bool update)
 	    if (update &&
                 m_sinceLastNotifyMin >= 0 &&
 		m_sinceLastNotifyMax >= 0) {
-                m_rows.clear(); //!!! inefficient
 		emit modelChangedWithin(m_sinceLastNotifyMin, m_sinceLastNotifyMax);
 		m_sinceLastNotifyMin = m_sinceLastNotifyMax = -1;
 	    } else {
@@ -965,6 +1278,47 @@ SparseModel<PointType>::EditCommand::addCommand(Command *command,
     MacroCommand::addCommand(command);
 }
 
+template <typename PointType>
+void
+SparseModel<PointType>::BatchEditCommand::addPoint(const PointType &point)
+{
+    m_added.push_back(point);
+}
+
+template <typename PointType>
+void
+SparseModel<PointType>::BatchEditCommand::deletePoint(const PointType &point)
+{
+    if (!m_added.empty()) {
+        typename PointType::Comparator comparator;
+        const PointType &last = m_added[m_added.size() - 1];
+        if (!comparator(last, point) && !comparator(point, last)) {
+            m_added.pop_back();
+            return;
+        }
+    }
+    m_deleted.push_back(point);
+}
+
+template <typename PointType>
+typename SparseModel<PointType>::BatchEditCommand *
+SparseModel<PointType>::BatchEditCommand::finish()
+{
+    if (m_added.empty() && m_deleted.empty()) {
+        delete this;
+        return 0;
+    }
+
+    typename PointType::OrderComparator comparator;
+    std::stable_sort(m_added.begin(), m_added.end(), comparator);
+    std::stable_sort(m_deleted.begin(), m_deleted.end(), comparator);
+    m_added.shrink_to_fit();
+    m_deleted.shrink_to_fit();
+
+    execute();
+    return this;
+}
+
 
 #endif
 
@@ -69,6 +69,13 @@ public:
     };
 };
 
+// Onset and beat detectors can produce many millions of these
+template <>
+struct SparseModelPointList<OneDimensionalPoint>
+{
+    typedef ChunkedMultiset<OneDimensionalPoint,
+                            OneDimensionalPoint::OrderComparator> Type;
+};
 
 class SparseOneDimensionalModel : public SparseModel<OneDimensionalPoint>,
                                   public NoteExportable
@@ -135,11 +142,11 @@ public:
                 (row, column, role);
         }
 
-        PointListConstIterator i = getPointListIteratorForRow(row);
-        if (i == m_points.end()) return QVariant();
+        Point point(0);
+        if (!getPointForRow(row, point)) return QVariant();
 
         switch (column) {
-        case 2: return i->label;
+        case 2: return point.label;
         default: return QVariant();
         }
     }
@@ -152,11 +159,10 @@ public:
         }
 
         if (role != Qt::EditRole) return 0;
-        PointListConstIterator i = getPointListIteratorForRow(row);
-        if (i == m_points.end()) return 0;
+        Point point(0);
+        if (!getPointForRow(row, point)) return 0;
         EditCommand *command = new EditCommand(this, tr("Edit Data"));
 
-        Point point(*i);
         command->deletePoint(point);
 
         switch (column) {
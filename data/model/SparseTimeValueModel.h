@@ -19,6 +19,8 @@
 #include "SparseValueModel.h"
 #include "base/PlayParameterRepository.h"
 #include "base/RealTime.h"
+#include "base/SummaryPyramid.h"
+#include "base/CacheBudget.h"
 
 /**
  * Time/value point type for use in a SparseModel or SparseValueModel.
@@ -75,8 +77,17 @@ public:
     };
 };
 
+// Pitch trackers and other per-frame extractors can produce many
+// millions of these
+template <>
+struct SparseModelPointList<TimeValuePoint>
+{
+    typedef ChunkedMultiset<TimeValuePoint,
+                            TimeValuePoint::OrderComparator> Type;
+};
 
-class SparseTimeValueModel : public SparseValueModel<TimeValuePoint>
+class SparseTimeValueModel : public SparseValueModel<TimeValuePoint>,
+                             public BudgetedCache
 {
     Q_OBJECT
     
@@ -84,11 +95,14 @@ public:
     SparseTimeValueModel(sv_samplerate_t sampleRate, int resolution,
 			 bool notifyOnAdd = true) :
 	SparseValueModel<TimeValuePoint>(sampleRate, resolution,
-					 notifyOnAdd)
+					 notifyOnAdd),
+        m_summaries(getSummaryShift(resolution)),
+        m_summariesValid(true)
     {
         // Model is playable, but may not sound (if units not Hz or
         // range unsuitable)
 	PlayParameterRepository::getInstance()->addPlayable(this);
+        CacheBudget::getInstance()->registerCache(this);
     }
 
     SparseTimeValueModel(sv_samplerate_t sampleRate, int resolution,
@@ -96,15 +110,20 @@ public:
 			 bool notifyOnAdd = true) :
 	SparseValueModel<TimeValuePoint>(sampleRate, resolution,
 					 valueMinimum, valueMaximum,
-					 notifyOnAdd)
+					 notifyOnAdd),
+        m_summaries(getSummaryShift(resolution)),
+        m_summariesValid(true)
     {
         // Model is playable, but may not sound (if units not Hz or
         // range unsuitable)
 	PlayParameterRepository::getInstance()->addPlayable(this);
+        CacheBudget::getInstance()->registerCache(this);
     }
 
     virtual ~SparseTimeValueModel()
     {
+        unregisterModel(this);
+        CacheBudget::getInstance()->unregisterCache(this);
 	PlayParameterRepository::getInstance()->removePlayable(this);
     }
 
@@ -113,6 +132,67 @@ public:
     virtual bool canPlay() const { return true; }
     virtual bool getDefaultPlayAudible() const { return false; } // user must unmute
 
+    typedef SummaryPyramid::Summary Summary;
+
+    /**
+     * Return the minimum, maximum, mean and count of the point values
+     * in consecutive buckets covering [start, end), using the widest
+     * power-of-two bucket width no wider than resolution frames (but
+     * at least 16 times the model resolution). Empty buckets have a
+     * count of zero. This takes time proportional to the number of
+     * buckets returned rather than the number of points in the range,
+     * so it suits views that are zoomed out too far to show every
+     * point, except on the first call after the summaries have been
+     * evicted, which rebuilds them.
+     */
+    std::vector<Summary> getSummaries(sv_frame_t start, sv_frame_t end,
+                                      sv_frame_t resolution) const
+    {
+        markUsed();
+        {
+            QReadLocker locker(&m_lock);
+            if (m_summariesValid) {
+                return m_summaries.getSummaries(start, end, resolution);
+            }
+        }
+        QWriteLocker locker(&m_lock);
+        if (!m_summariesValid) {
+            for (PointListConstIterator i = m_points.begin();
+                 i != m_points.end(); ++i) {
+                m_summaries.add(i->frame, i->value);
+            }
+            m_summariesValid = true;
+        }
+        return m_summaries.getSummaries(start, end, resolution);
+    }
+
+    /**
+     * The points, row index and summaries.
+     */
+    virtual size_t getMemoryUsage() const
+    {
+        size_t bytes = SparseValueModel<TimeValuePoint>::getMemoryUsage();
+        QReadLocker locker(&m_lock);
+        return bytes + m_summaries.getMemoryUsage();
+    }
+
+    // BudgetedCache methods. The summaries are rebuilt from the
+    // points when next asked for
+    virtual size_t getEvictableSize() const
+    {
+        QReadLocker locker(&m_lock);
+        return m_summaries.getMemoryUsage();
+    }
+
+    virtual size_t evict(size_t)
+    {
+        QWriteLocker locker(&m_lock);
+        size_t bytes = m_summaries.getMemoryUsage();
+        m_summaries.clear();
+        m_summariesValid = false;
+        return bytes;
+    }
+
     /**
      * TabularModel methods.  
      */
@@ -140,14 +220,14 @@ public:
                 (row, column, role);
         }
 
-        PointListConstIterator i = getPointListIteratorForRow(row);
-        if (i == m_points.end()) return QVariant();
+        Point point(0);
+        if (!getPointForRow(row, point)) return QVariant();
 
         switch (column) {
         case 2:
-            if (role == Qt::EditRole || role == SortRole) return i->value;
-            else return QString("%1 %2").arg(i->value).arg(getScaleUnits());
-        case 3: return i->label;
+            if (role == Qt::EditRole || role == SortRole) return point.value;
+            else return QString("%1 %2").arg(point.value).arg(getScaleUnits());
+        case 3: return point.label;
         default: return QVariant();
         }
     }
@@ -160,11 +240,10 @@ public:
         }
 
         if (role != Qt::EditRole) return 0;
-        PointListConstIterator i = getPointListIteratorForRow(row);
-        if (i == m_points.end()) return 0;
+        Point point(0);
+        if (!getPointForRow(row, point)) return 0;
         EditCommand *command = new EditCommand(this, tr("Edit Data"));
 
-        Point point(*i);
         command->deletePoint(point);
 
         switch (column) {
@@ -186,6 +265,49 @@ public:
         if (column == 3) return SortAlphabetical;
         return SortNumeric;
     }
+
+protected:
+    // Summaries of the point values at power-of-two resolutions, not
+    // kept up to date while m_summariesValid is false. Access only
+    // with m_lock held
+    mutable SummaryPyramid m_summaries;
+    mutable bool m_summariesValid;
+
+    static int getSummaryShift(int resolution) {
+        // The narrowest buckets are the smallest power of two at
+        // least 16 times the resolution
+        int shift = 4;
+        while ((1 << shift) < resolution * 16) ++shift;
+        return shift;
+    }
+
+    virtual void pointAdded(const TimeValuePoint &point) {
+        if (!m_summariesValid) return;
+        m_summaries.add(point.frame, point.value);
+    }
+
+    virtual void pointRemoved(const TimeValuePoint &point) {
+        if (!m_summariesValid) return;
+        m_summaries.remove
+            (point.frame, point.value,
+             [this](sv_frame_t start, sv_frame_t end) {
+                Summary s;
+                for (PointListConstIterator i =
+                         m_points.lower_bound(TimeValuePoint(start));
+                     i != m_points.end() && i->frame < end; ++i) {
+                    if (s.count == 0 || i->value < s.min) s.min = i->value;
+                    if (s.count == 0 || i->value > s.max) s.max = i->value;
+                    s.sum += i->value;
+                    ++s.count;
+                }
+                return s;
+            });
+    }
+
+    virtual void pointsCleared() {
+        m_summaries.clear();
+        m_summariesValid = true;
+    }
 };
 
 
@@ -66,21 +66,19 @@ public:
 
     virtual void addPoint(const PointType &point)
     {
-	bool allChange = false;
+	bool allChange = extendExtents(point);
+	SparseModel<PointType>::addPoint(point);
+	if (allChange) emit modelChanged();
+    }
 
-        if (!ISNAN(point.value) && !ISINF(point.value)) {
-            if (!m_haveExtents || point.value < m_valueMinimum) {
-                m_valueMinimum = point.value; allChange = true;
-//                std::cerr << "addPoint: value min = " << m_valueMinimum << std::endl;
-            }
-            if (!m_haveExtents || point.value > m_valueMaximum) {
-                m_valueMaximum = point.value; allChange = true;
-//                std::cerr << "addPoint: value max = " << m_valueMaximum << " (min = " << m_valueMinimum << ")" << std::endl;
-            }
-            m_haveExtents = true;
+    virtual void addPoints(const std::vector<PointType> &points)
+    {
+	bool allChange = false;
+        for (typename std::vector<PointType>::const_iterator i = points.begin();
+             i != points.end(); ++i) {
+            if (extendExtents(*i)) allChange = true;
         }
-
-	SparseModel<PointType>::addPoint(point);
+	SparseModel<PointType>::addPoints(points);
 	if (allChange) emit modelChanged();
     }
 
@@ -90,27 +88,22 @@ public:
 
 	if (point.value == m_valueMinimum ||
 	    point.value == m_valueMaximum) {
+            recalculateExtents();
+        }
+    }
 
-	    float formerMin = m_valueMinimum, formerMax = m_valueMaximum;
-
-	    for (typename SparseModel<PointType>::PointList::const_iterator i
-		     = m_points.begin();
-		 i != m_points.end(); ++i) {
-
-		if (i == m_points.begin() || i->value < m_valueMinimum) {
-		    m_valueMinimum = i->value;
-//                    std::cerr << "deletePoint: value min = " << m_valueMinimum << std::endl;
-		} 
-		if (i == m_points.begin() || i->value > m_valueMaximum) {
-		    m_valueMaximum = i->value;
-//                    std::cerr << "deletePoint: value max = " << m_valueMaximum << std::endl;
-		} 
-	    }
-
-	    if (formerMin != m_valueMinimum || formerMax != m_valueMaximum) {
-		emit modelChanged();
-	    }
-	}
+    virtual void deletePoints(const std::vector<PointType> &points)
+    {
+	SparseModel<PointType>::deletePoints(points);
+
+        for (typename std::vector<PointType>::const_iterator i = points.begin();
+             i != points.end(); ++i) {
+            if (i->value == m_valueMinimum ||
+                i->value == m_valueMaximum) {
+                recalculateExtents();
+                break;
+            }
+        }
     }
 
     virtual void toXml(QTextStream &stream,
@@ -133,6 +126,52 @@ protected:
     float m_valueMaximum;
     bool m_haveExtents;
     QString m_units;
+
+    // Recalculate the value extents from all points, after removing
+    // one that was at an extreme
+    void recalculateExtents()
+    {
+        float formerMin = m_valueMinimum, formerMax = m_valueMaximum;
+
+        for (typename SparseModel<PointType>::PointList::const_iterator i
+                 = m_points.begin();
+             i != m_points.end(); ++i) {
+
+            if (i == m_points.begin() || i->value < m_valueMinimum) {
+                m_valueMinimum = i->value;
+//                std::cerr << "deletePoint: value min = " << m_valueMinimum << std::endl;
+            } 
+            if (i == m_points.begin() || i->value > m_valueMaximum) {
+                m_valueMaximum = i->value;
+//                std::cerr << "deletePoint: value max = " << m_valueMaximum << std::endl;
+            } 
+        }
+
+        if (formerMin != m_valueMinimum || formerMax != m_valueMaximum) {
+            emit modelChanged();
+        }
+    }
+
+    // Widen the value extents to include the given point, returning
+    // true if they changed
+    bool extendExtents(const PointType &point)
+    {
+	bool changed = false;
+
+        if (!ISNAN(point.value) && !ISINF(point.value)) {
+            if (!m_haveExtents || point.value < m_valueMinimum) {
+                m_valueMinimum = point.value; changed = true;
+//                std::cerr << "addPoint: value min = " << m_valueMinimum << std::endl;
+            }
+            if (!m_haveExtents || point.value > m_valueMaximum) {
+                m_valueMaximum = point.value; changed = true;
+//                std::cerr << "addPoint: value max = " << m_valueMaximum << " (min = " << m_valueMinimum << ")" << std::endl;
+            }
+            m_haveExtents = true;
+        }
+
+        return changed;
+    }
 };
 
 
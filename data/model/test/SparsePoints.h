@@ -0,0 +1,62 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+
+/*
+    Sonic Visualiser
+    An audio file viewer and annotation editor.
+    Centre for Digital Music, Queen Mary, University of London.
+    
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation; either version 2 of the
+    License, or (at your option) any later version.  See the file
+    COPYING included with this distribution for more information.
+*/
+
+#ifndef TEST_SPARSE_POINTS_H
+#define TEST_SPARSE_POINTS_H
+
+// Helpers shared by the sparse model tests
+
+#include "../SparseTimeValueModel.h"
+#include "base/test/TestRandom.h"
+
+#include <vector>
+
+// Points in random order with repeated frames, labelled with
+// consecutive numbers from base in the order they are generated
+inline std::vector<TimeValuePoint>
+makeTimeValuePoints(TestRandom &rnd, int n, int base = 0)
+{
+    std::vector<TimeValuePoint> points;
+    for (int i = 0; i < n; ++i) {
+        points.push_back(TimeValuePoint(rnd() % 1000, float(rnd() % 50),
+                                        QString::number(base + i)));
+    }
+    return points;
+}
+
+// The points of a model, in order
+inline std::vector<TimeValuePoint>
+getTimeValuePoints(const SparseTimeValueModel &model)
+{
+    std::vector<TimeValuePoint> points;
+    model.visitAllPoints([&points](const TimeValuePoint &p) {
+            points.push_back(p);
+        });
+    return points;
+}
+
+inline bool
+sameTimeValuePoints(const std::vector<TimeValuePoint> &a,
+                    const std::vector<TimeValuePoint> &b)
+{
+    if (a.size() != b.size()) return false;
+    for (size_t i = 0; i < a.size(); ++i) {
+        if (a[i].frame != b[i].frame ||
+            a[i].value != b[i].value ||
+            a[i].label != b[i].label) return false;
+    }
+    return true;
+}
+
+#endif
@@ -0,0 +1,234 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+
+/*
+    Sonic Visualiser
+    An audio file viewer and annotation editor.
+    Centre for Digital Music, Queen Mary, University of London.
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation; either version 2 of the
+    License, or (at your option) any later version.  See the file
+    COPYING included with this distribution for more information.
+*/
+
+#ifndef TEST_ALIGNMENT_MODEL_H
+#define TEST_ALIGNMENT_MODEL_H
+
+#include "../AlignmentModel.h"
+#include "../SparseTimeValueModel.h"
+#include "../ModelChangeCoalescer.h"
+
+#include "MockWaveModel.h"
+#include "base/test/TestRandom.h"
+
+#include <QObject>
+#include <QtTest>
+
+#include <iostream>
+#include <vector>
+#include <cmath>
+#include <algorithm>
+
+using namespace std;
+
+class TestAlignmentModel : public QObject
+{
+    Q_OBJECT
+
+    // Lets us deliver the raw path's change notifications directly,
+    // as they would arrive (queued) from an aligner thread
+    class StreamedAlignmentModel : public AlignmentModel
+    {
+    public:
+        StreamedAlignmentModel(Model *reference, Model *aligned,
+                               SparseTimeValueModel *path) :
+            AlignmentModel(reference, aligned, 0, path) { }
+        void notify(sv_frame_t start, sv_frame_t end) {
+            pathChangedWithin(start, end);
+        }
+    };
+
+    TestRandom rnd;
+
+    // A raw path in which aligned frames run at a varying speed
+    // against the reference, with some repeated frames
+    SparseTimeValueModel *makeRawPath(int count) {
+        SparseTimeValueModel *raw = new SparseTimeValueModel(44100, 1, false);
+        sv_frame_t frame = 0;
+        double seconds = 0.0;
+        for (int i = 0; i < count; ++i) {
+            raw->addPoint(TimeValuePoint(frame, float(seconds), ""));
+            if (rnd() % 10 != 0) frame += 1 + rnd() % 1000;
+            seconds += double(rnd() % 1000) / 44100.0;
+        }
+        return raw;
+    }
+
+    // The mapping for one frame worked out the long way, by scanning
+    // the whole path
+    static sv_frame_t expected(const vector<PathPoint> &path, sv_frame_t frame) {
+        if (path.empty()) return frame;
+        size_t found = 0;
+        bool exact = false;
+        for (size_t i = 0; i < path.size(); ++i) {
+            if (path[i].frame == frame && !exact) {
+                found = i;
+                exact = true;
+            } else if (path[i].frame < frame) {
+                found = i;
+            }
+        }
+        const PathPoint &p = path[found];
+        if (p.mapframe < 0) return 0;
+        if (found + 1 == path.size() || frame <= p.frame) return p.mapframe;
+        const PathPoint &q = path[found + 1];
+        if (q.frame == p.frame) return p.mapframe;
+        double interp = double(frame - p.frame) / double(q.frame - p.frame);
+        return p.mapframe + lrint(double(q.mapframe - p.mapframe) * interp);
+    }
+
+    static vector<PathPoint> forwardPath(SparseTimeValueModel *raw) {
+        vector<PathPoint> path;
+        raw->visitAllPoints([&](const TimeValuePoint &p) {
+                path.push_back(PathPoint(p.frame, lrint(p.value * 44100)));
+            });
+        return path;
+    }
+
+private slots:
+    void noPath() {
+        MockWaveModel ref({ DC }, 1000, 0);
+        MockWaveModel aligned({ DC }, 1000, 0);
+        AlignmentModel model(&ref, &aligned, 0, 0);
+        QCOMPARE(model.toReference(500), sv_frame_t(500));
+        vector<sv_frame_t> frames { 3, 1, 2 };
+        QCOMPARE(model.fromReference(frames), frames);
+    }
+
+    void single() {
+        rnd.seed(3);
+        MockWaveModel ref({ DC }, 100000, 0);
+        MockWaveModel aligned({ DC }, 100000, 0);
+        SparseTimeValueModel *raw = makeRawPath(200);
+        vector<PathPoint> path = forwardPath(raw);
+        AlignmentModel model(&ref, &aligned, 0, raw);
+        for (sv_frame_t f = -10; f < path.rbegin()->frame + 2000; f += 37) {
+            QCOMPARE(model.toReference(f), expected(path, f));
+        }
+    }
+
+    void batch() {
+        rnd.seed(4);
+        MockWaveModel ref({ DC }, 100000, 0);
+        MockWaveModel aligned({ DC }, 100000, 0);
+        AlignmentModel model(&ref, &aligned, 0, makeRawPath(500));
+
+        vector<sv_frame_t> ascending, shuffled;
+        for (sv_frame_t f = 0; f < 300000; f += 1 + rnd() % 200) {
+            ascending.push_back(f);
+            shuffled.push_back(rnd() % 300000);
+        }
+
+        for (const vector<sv_frame_t> &frames : { ascending, shuffled }) {
+            vector<sv_frame_t> to = model.toReference(frames);
+            vector<sv_frame_t> from = model.fromReference(frames);
+            QCOMPARE(to.size(), frames.size());
+            QCOMPARE(from.size(), frames.size());
+            for (size_t i = 0; i < frames.size(); ++i) {
+                QCOMPARE(to[i], model.toReference(frames[i]));
+                QCOMPARE(from[i], model.fromReference(frames[i]));
+            }
+        }
+    }
+
+    void streamed() {
+        rnd.seed(6);
+        MockWaveModel ref({ DC }, 100000, 0);
+        MockWaveModel aligned({ DC }, 100000, 0);
+        SparseTimeValueModel *raw = new SparseTimeValueModel(44100, 1, false);
+        raw->setCompletion(0, false);
+        StreamedAlignmentModel model(&ref, &aligned, raw);
+
+        // Compare against the path as a whole after each batch of
+        // points arrives, including batches that revise the last
+        // few points already seen
+        sv_frame_t frame = 0;
+        double seconds = 0.0;
+        for (int batch = 0; batch < 30; ++batch) {
+            sv_frame_t start = frame;
+            if (batch % 5 == 4) {
+                vector<TimeValuePoint> tail;
+                raw->visitPointsWithin
+                    (frame - 2000, frame, [&](const TimeValuePoint &p) {
+                        if (p.frame >= frame - 2000) tail.push_back(p);
+                    });
+                for (const auto &p : tail) {
+                    raw->deletePoint(p);
+                    raw->addPoint(TimeValuePoint(p.frame, p.value + 0.01f, ""));
+                }
+                start = frame - 2000;
+            }
+            for (int i = 0; i < 20; ++i) {
+                raw->addPoint(TimeValuePoint(frame, float(seconds), ""));
+                frame += 1 + rnd() % 500;
+                seconds += double(rnd() % 500) / 44100.0;
+            }
+            model.notify(start, frame);
+
+            vector<PathPoint> forward = forwardPath(raw);
+            vector<PathPoint> reverse;
+            for (const PathPoint &p : forward) {
+                reverse.push_back(PathPoint(p.mapframe, p.frame));
+            }
+            stable_sort(reverse.begin(), reverse.end(),
+                        PathPoint::OrderComparator());
+
+            for (sv_frame_t f = 0; f < frame + 1000; f += 97) {
+                QCOMPARE(model.toReference(f), expected(forward, f));
+                QCOMPARE(model.fromReference(f), expected(reverse, f));
+            }
+        }
+    }
+
+    void wholeChangeSupersedesRanges() {
+        // A whole-model change arriving while ranges are pending
+        // replaces them in the coalescer, so the path must be rebuilt
+        // from that alone
+        rnd.seed(7);
+        MockWaveModel ref({ DC }, 100000, 0);
+        MockWaveModel aligned({ DC }, 100000, 0);
+        SparseTimeValueModel *raw = new SparseTimeValueModel(44100, 1, true);
+        raw->setCompletion(0, false);
+        AlignmentModel model(&ref, &aligned, 0, raw);
+
+        sv_frame_t frame = 0;
+        double seconds = 0.0;
+        for (int i = 0; i < 50; ++i) {
+            raw->addPoint(TimeValuePoint(frame, float(seconds), ""));
+            frame += 1 + rnd() % 500;
+            seconds += double(rnd() % 500) / 44100.0;
+        }
+        raw->setResolution(1); // emits modelChanged
+        ModelChangeCoalescer::getFor(raw)->flush();
+
+        vector<PathPoint> forward = forwardPath(raw);
+        for (sv_frame_t f = 0; f < frame + 1000; f += 97) {
+            QCOMPARE(model.toReference(f), expected(forward, f));
+        }
+    }
+
+    void exportedPath() {
+        rnd.seed(5);
+        MockWaveModel ref({ DC }, 1000, 0);
+        MockWaveModel aligned({ DC }, 1000, 0);
+        AlignmentModel model(&ref, &aligned, 0, makeRawPath(50));
+        QString s;
+        QTextStream out(&s);
+        model.toXml(out);
+        out.flush();
+        QCOMPARE(s.count("<point "), 50);
+    }
+};
+
+#endif
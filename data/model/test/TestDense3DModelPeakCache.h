@@ -0,0 +1,144 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+
+/*
+    Sonic Visualiser
+    An audio file viewer and annotation editor.
+    Centre for Digital Music, Queen Mary, University of London.
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation; either version 2 of the
+    License, or (at your option) any later version.  See the file
+    COPYING included with this distribution for more information.
+*/
+
+#ifndef TEST_DENSE_3D_MODEL_PEAK_CACHE_H
+#define TEST_DENSE_3D_MODEL_PEAK_CACHE_H
+
+#include "../Dense3DModelPeakCache.h"
+#include "../EditableDenseThreeDimensionalModel.h"
+
+#include <QObject>
+#include <QtTest>
+
+#include <iostream>
+#include <vector>
+
+using namespace std;
+
+class TestDense3DModelPeakCache : public QObject
+{
+    Q_OBJECT
+
+    typedef EditableDenseThreeDimensionalModel Model;
+    typedef vector<float> Column;
+
+    static const int height = 16;
+
+    static float value(int x, int i) {
+        return float(((x * 37 + i * 11) % 101) - 50);
+    }
+
+    static void addColumns(Model &model, int from, int to) {
+        for (int x = from; x < to; ++x) {
+            Column c(height);
+            for (int i = 0; i < height; ++i) c[i] = value(x, i);
+            model.setColumn(x, c);
+        }
+    }
+
+    static float expectedPeak(int cpp, int width, int col, int i) {
+        float peak = value(col * cpp, i);
+        for (int x = col * cpp + 1; x < (col + 1) * cpp && x < width; ++x) {
+            peak = std::max(peak, value(x, i));
+        }
+        return peak;
+    }
+
+    static void checkAll(const Dense3DModelPeakCache &cache, int width) {
+        for (int level = 0; level < cache.getLevelCount(); ++level) {
+            int cpp = cache.getColumnsPerPeak(level);
+            int pw = cache.getPeakWidth(level);
+            QCOMPARE(pw, (width + cpp - 1) / cpp);
+            for (int col = 0; col < pw; ++col) {
+                Column c = cache.getPeakColumn(level, col);
+                QCOMPARE(int(c.size()), height);
+                for (int i = 0; i < height; ++i) {
+                    QCOMPARE(c[i], expectedPeak(cpp, width, col, i));
+                }
+            }
+        }
+    }
+
+private slots:
+    void levels() {
+        Model model(44100, 512, height, Model::NoCompression, false);
+        addColumns(model, 0, 1000);
+        Dense3DModelPeakCache cache(&model, 4, 5);
+        QCOMPARE(cache.getLevelCount(), 5);
+        QCOMPARE(cache.getColumnsPerPeak(), 4);
+        QCOMPARE(cache.getColumnsPerPeak(3), 32);
+        QCOMPARE(cache.getResolution(), 512 * 4);
+        QCOMPARE(cache.getWidth(), 250);
+        QCOMPARE(cache.getLevelFor(1), 0);
+        QCOMPARE(cache.getLevelFor(15), 1);
+        QCOMPARE(cache.getLevelFor(16), 2);
+        QCOMPARE(cache.getLevelFor(10000), 4);
+        checkAll(cache, 1000);
+    }
+
+    void levelZero() {
+        Model model(44100, 512, height, Model::NoCompression, false);
+        addColumns(model, 0, 99);
+        Dense3DModelPeakCache cache(&model, 8, 1);
+        for (int col = 0; col < cache.getWidth(); ++col) {
+            for (int i = 0; i < height; ++i) {
+                QCOMPARE(cache.getValueAt(col, i),
+                         expectedPeak(8, 99, col, i));
+            }
+        }
+    }
+
+    void growingSource() {
+        Model model(44100, 512, height, Model::NoCompression, false);
+        model.setCompletion(0);
+        Dense3DModelPeakCache cache(&model, 4, 4);
+
+        // Read columns, including short final ones, before the source
+        // is complete, and check that they update as it grows
+        addColumns(model, 0, 37);
+        checkAll(cache, 37);
+        addColumns(model, 37, 130);
+        checkAll(cache, 130);
+        addColumns(model, 130, 131);
+        model.setCompletion(100);
+        checkAll(cache, 131);
+    }
+
+    void backgroundFill() {
+        Model model(44100, 512, height, Model::NoCompression, false);
+        addColumns(model, 0, 5000);
+        Dense3DModelPeakCache cache(&model, 2, 6);
+        // Give the fill thread a chance to get going, so that we read
+        // a mixture of filled and unfilled columns
+        QTest::qWait(50);
+        checkAll(cache, 5000);
+    }
+
+    void evicted() {
+        Model model(44100, 512, height, Model::NoCompression, false);
+        addColumns(model, 0, 1000);
+        Dense3DModelPeakCache cache(&model, 4, 3);
+        // Nothing can be evicted until the fill thread has finished
+        for (int i = 0; i < 100 && cache.getEvictableSize() == 0; ++i) {
+            QTest::qWait(50);
+        }
+        size_t size = cache.getEvictableSize();
+        QVERIFY(size > 0);
+        QVERIFY(cache.evict(size) > 0);
+        QVERIFY(cache.getMemoryUsage() < size);
+        checkAll(cache, 1000);
+    }
+};
+
+#endif
@@ -0,0 +1,169 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+
+/*
+    Sonic Visualiser
+    An audio file viewer and annotation editor.
+    Centre for Digital Music, Queen Mary, University of London.
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation; either version 2 of the
+    License, or (at your option) any later version.  See the file
+    COPYING included with this distribution for more information.
+*/
+
+#ifndef TEST_DENSE_APPEND_H
+#define TEST_DENSE_APPEND_H
+
+#include "../EditableDenseThreeDimensionalModel.h"
+#include "base/test/TestRandom.h"
+
+#include <QObject>
+#include <QtTest>
+
+#include <iostream>
+#include <vector>
+#include <thread>
+#include <atomic>
+
+using namespace std;
+
+class TestDenseAppend : public QObject
+{
+    Q_OBJECT
+
+    typedef EditableDenseThreeDimensionalModel Model;
+    typedef vector<float> Column;
+
+    static const int height = 64;
+    static const int width = 20000;
+    static const int readerCount = 4;
+
+    // Small integers, so as to be stored exactly in every encoding
+    static float expected(int x, int i) {
+        return float((x * 7 + i) % 1000);
+    }
+
+    static Column makeColumn(int x) {
+        Column c(height);
+        for (int i = 0; i < height; ++i) c[i] = expected(x, i);
+        return c;
+    }
+
+    // Read published columns repeatedly until the writer is done,
+    // counting any values that are not as written
+    static void read(const Model *model, const atomic<bool> *done,
+                     atomic<int> *errors, atomic<int> *reads, int seed) {
+
+        TestRandom rnd(unsigned(seed));
+
+        while (!done->load()) {
+
+            int w = model->getWidth();
+            if (w == 0) continue;
+
+            int x = rnd() % w;
+
+            Column c = model->getColumn(x);
+            if (int(c.size()) != height) {
+                ++*errors;
+                continue;
+            }
+            for (int i = 0; i < height; ++i) {
+                if (c[i] != expected(x, i)) ++*errors;
+            }
+
+            int n = rnd() % height;
+            if (model->getValueAt(x, n) != expected(x, n)) ++*errors;
+
+            int x0 = x > 10 ? x - 10 : 0;
+            Column slice = model->getRowSlice(n, x0, x - x0 + 1);
+            for (int j = 0; j < int(slice.size()); ++j) {
+                if (slice[j] != expected(x0 + j, n)) ++*errors;
+            }
+
+            ++*reads;
+        }
+    }
+
+    void checkAppend(Model::CompressionType type, bool leaveMidway) {
+
+        Model model(44100, 512, height, type, false);
+        model.setAppendOnly(true);
+
+        atomic<bool> done(false);
+        atomic<int> errors(0);
+        atomic<int> reads(0);
+
+        vector<thread> readers;
+        for (int r = 0; r < readerCount; ++r) {
+            readers.push_back(thread(read, &model, &done, &errors, &reads,
+                                     r + 1));
+        }
+
+        for (int x = 0; x < width; ++x) {
+            model.setColumn(x, makeColumn(x));
+            if (leaveMidway && x == width / 2) {
+                // Replacing an existing column ends the append-only
+                // mode; readers carry on with locking
+                model.setColumn(x / 2, makeColumn(x / 2));
+            }
+        }
+
+        done = true;
+        for (auto &t : readers) t.join();
+
+        QCOMPARE(errors.load(), 0);
+        QVERIFY(reads.load() > 0);
+        QCOMPARE(model.getWidth(), width);
+
+        for (int x = 0; x < width; x += 97) {
+            Column c = model.getColumn(x);
+            QCOMPARE(int(c.size()), height);
+            for (int i = 0; i < height; ++i) {
+                QCOMPARE(c[i], expected(x, i));
+            }
+        }
+    }
+
+private slots:
+    void appendNoCompression() {
+        checkAppend(Model::NoCompression, false);
+    }
+
+    void appendHalfPrecision() {
+        checkAppend(Model::HalfPrecisionCompression, false);
+    }
+
+    void appendDeltaBlock() {
+        checkAppend(Model::DeltaBlockCompression, false);
+    }
+
+    void leaveNoCompression() {
+        checkAppend(Model::NoCompression, true);
+    }
+
+    void leaveHalfPrecision() {
+        checkAppend(Model::HalfPrecisionCompression, true);
+    }
+
+    void leaveDeltaBlock() {
+        checkAppend(Model::DeltaBlockCompression, true);
+    }
+
+    void appendWithGaps() {
+        // Columns skipped over by the writer read as zeros, and do
+        // not end the mode
+        Model model(44100, 512, height, Model::NoCompression, false);
+        model.setAppendOnly(true);
+        model.setColumn(0, makeColumn(0));
+        model.setColumn(5, makeColumn(5));
+        QCOMPARE(model.getWidth(), 6);
+        Column c = model.getColumn(3);
+        QCOMPARE(int(c.size()), height);
+        QCOMPARE(c[1], 0.f);
+        QCOMPARE(model.getValueAt(5, 1), expected(5, 1));
+    }
+};
+
+#endif
@@ -0,0 +1,127 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+
+/*
+    Sonic Visualiser
+    An audio file viewer and annotation editor.
+    Centre for Digital Music, Queen Mary, University of London.
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation; either version 2 of the
+    License, or (at your option) any later version.  See the file
+    COPYING included with this distribution for more information.
+*/
+
+#ifndef TEST_DENSE_COLUMN_STORE_H
+#define TEST_DENSE_COLUMN_STORE_H
+
+#include "../DenseColumnStore.h"
+#include "base/test/TestRandom.h"
+
+#include <QObject>
+#include <QtTest>
+
+#include <iostream>
+#include <vector>
+
+using namespace std;
+
+class TestDenseColumnStore : public QObject
+{
+    Q_OBJECT
+
+    typedef DenseColumnStore::Column Column;
+
+    void compareWithReference(DenseColumnStore::Layout layout,
+                              bool appendOnly) {
+
+        // Set a lot of columns of varying length (some longer than
+        // the stride) in a pseudo-random order, overwriting many of
+        // them, and check everything reads back as expected
+
+        DenseColumnStore store(layout, 5);
+        vector<Column> ref;
+
+        TestRandom rnd(54321);
+
+        for (int i = 0; i < 50000; ++i) {
+            int x = (appendOnly ? int(ref.size()) : rnd() % 20000);
+            Column c(rnd() % 8);
+            for (auto &v: c) v = float(rnd() % 100);
+            store.setColumn(x, c);
+            if (int(ref.size()) <= x) ref.resize(x + 1);
+            ref[x] = c;
+        }
+
+        QCOMPARE(store.getWidth(), int(ref.size()));
+
+        for (int x = 0; x < int(ref.size()); ++x) {
+            QCOMPARE(store.getColumnLength(x), int(ref[x].size()));
+            QCOMPARE(store.getColumn(x), ref[x]);
+        }
+
+        for (int n = 0; n < 9; ++n) {
+            int count = int(ref.size()) + 20;
+            vector<float> slice(count, 0.f);
+            store.getRowSlice(n, -10, count, slice.data(), -1.f);
+            for (int i = 0; i < count; ++i) {
+                int x = i - 10;
+                float expected = -1.f;
+                if (x >= 0 && x < int(ref.size()) && n < int(ref[x].size())) {
+                    expected = ref[x][n];
+                }
+                QCOMPARE(slice[i], expected);
+                QCOMPARE(store.getValueAt(x, n, -1.f), expected);
+            }
+        }
+    }
+
+private slots:
+    void empty() {
+        DenseColumnStore store(DenseColumnStore::FixedStride, 4);
+        QCOMPARE(store.getWidth(), 0);
+        QCOMPARE(store.getColumn(0), Column());
+        QCOMPARE(store.getValueAt(0, 0, 2.f), 2.f);
+        QVERIFY(store.setStride(8));
+        QCOMPARE(store.getStride(), 8);
+    }
+
+    void gaps() {
+        DenseColumnStore store(DenseColumnStore::FixedStride, 4);
+        store.setColumn(3, { 1, 2, 3, 4 });
+        QCOMPARE(store.getWidth(), 4);
+        QCOMPARE(store.getColumn(0), Column());
+        QCOMPARE(store.getColumn(3), Column({ 1, 2, 3, 4 }));
+        QVERIFY(!store.setStride(8));
+        store.clear();
+        QCOMPARE(store.getWidth(), 0);
+    }
+
+    void overflow() {
+        DenseColumnStore store(DenseColumnStore::FixedStride, 2);
+        store.setColumn(0, { 1, 2, 3 });
+        store.setColumn(1, { 4 });
+        QCOMPARE(store.getColumn(0), Column({ 1, 2, 3 }));
+        QCOMPARE(store.getValueAt(0, 2), 3.f);
+        store.setColumn(0, { 5, 6 });
+        QCOMPARE(store.getColumn(0), Column({ 5, 6 }));
+        float row[2];
+        store.getRowSlice(0, 0, 2, row);
+        QCOMPARE(row[0], 5.f);
+        QCOMPARE(row[1], 4.f);
+    }
+
+    void fixedStrideRandom() {
+        compareWithReference(DenseColumnStore::FixedStride, false);
+    }
+
+    void packedRandom() {
+        compareWithReference(DenseColumnStore::Packed, false);
+    }
+
+    void packedAppend() {
+        compareWithReference(DenseColumnStore::Packed, true);
+    }
+};
+
+#endif
@@ -0,0 +1,222 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+
+/*
+    Sonic Visualiser
+    An audio file viewer and annotation editor.
+    Centre for Digital Music, Queen Mary, University of London.
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation; either version 2 of the
+    License, or (at your option) any later version.  See the file
+    COPYING included with this distribution for more information.
+*/
+
+#ifndef TEST_DENSE_COMPRESSION_H
+#define TEST_DENSE_COMPRESSION_H
+
+#include "../EncodedColumnStore.h"
+#include "../EditableDenseThreeDimensionalModel.h"
+#include "base/test/TestRandom.h"
+
+#include <QObject>
+#include <QtTest>
+
+#include <iostream>
+#include <vector>
+#include <cmath>
+
+using namespace std;
+
+class TestDenseCompression : public QObject
+{
+    Q_OBJECT
+
+    typedef vector<float> Column;
+
+    TestRandom rnd;
+
+    // A column of the sort of thing a feature extractor might
+    // produce: smooth, with some repeated values and some noise
+    Column makeColumn(int x, int h) {
+        Column c(h);
+        for (int i = 0; i < h; ++i) {
+            if (rnd() % 4 == 0) c[i] = float(rnd() % 3);
+            else c[i] = float(sin(x * 0.01 + i * 0.1) * 100.0 +
+                              (rnd() % 100) * 0.0001);
+        }
+        return c;
+    }
+
+    static bool withinHalfBounds(float original, float stored) {
+        float a = fabsf(original);
+        if (a > 65504.f) {
+            return stored == (original > 0.f ? 65504.f : -65504.f);
+        }
+        if (a < 6.103515625e-05f) { // 2^-14
+            return fabsf(stored - original) <= 2.98023224e-08f; // 2^-25
+        }
+        return fabsf(stored - original) <= a * 4.8828125e-04f; // 2^-11
+    }
+
+    void checkStore(EncodedColumnStore::Encoding encoding, bool inOrder) {
+
+        rnd.seed(1234);
+
+        EncodedColumnStore store(encoding);
+        vector<Column> ref;
+
+        for (int i = 0; i < 5000; ++i) {
+            int x = (inOrder ? i : rnd() % 2000);
+            Column c = makeColumn(x, rnd() % 100);
+            store.setColumn(x, c);
+            if (int(ref.size()) <= x) ref.resize(x + 1);
+            ref[x] = c;
+        }
+
+        QCOMPARE(store.getWidth(), int(ref.size()));
+
+        for (int x = 0; x < int(ref.size()); ++x) {
+            Column c = store.getColumn(x);
+            QCOMPARE(c.size(), ref[x].size());
+            for (int i = 0; i < int(c.size()); ++i) {
+                if (encoding == EncodedColumnStore::XorBlock) {
+                    QCOMPARE(c[i], ref[x][i]);
+                } else {
+                    QVERIFY(withinHalfBounds(ref[x][i], c[i]));
+                }
+                QCOMPARE(store.getValueAt(x, i), c[i]);
+            }
+        }
+    }
+
+    void checkModel(EditableDenseThreeDimensionalModel::CompressionType type) {
+
+        rnd.seed(4321);
+
+        const int h = 40;
+        EditableDenseThreeDimensionalModel model(44100, 512, h, type, false);
+
+        vector<Column> ref;
+        for (int x = 0; x < 300; ++x) {
+            ref.push_back(makeColumn(x, h));
+            model.setColumn(x, ref[x]);
+        }
+
+        // replace a few, including key columns
+        for (int x : { 0, 64, 65, 200 }) {
+            ref[x] = makeColumn(x + 1000, h);
+            model.setColumn(x, ref[x]);
+        }
+
+        QCOMPARE(model.getWidth(), 300);
+
+        for (int x = 0; x < 300; ++x) {
+            Column c = model.getColumn(x);
+            QCOMPARE(int(c.size()), h);
+            for (int i = 0; i < h; ++i) {
+                if (type == EditableDenseThreeDimensionalModel::
+                    HalfPrecisionCompression) {
+                    QVERIFY(withinHalfBounds(ref[x][i], c[i]));
+                } else {
+                    QCOMPARE(c[i], ref[x][i]);
+                }
+                QCOMPARE(model.getValueAt(x, i), c[i]);
+            }
+        }
+
+        Column slice = model.getRowSlice(7, -5, 310);
+        for (int i = 0; i < 310; ++i) {
+            int x = i - 5;
+            if (x < 0 || x >= 300) {
+                QCOMPARE(slice[i], model.getMinimumLevel());
+            } else {
+                QCOMPARE(slice[i], model.getValueAt(x, 7));
+            }
+        }
+    }
+
+private slots:
+    void halfRoundTrip() {
+        // Every half-precision value other than NaN converts to float
+        // and back exactly
+        for (int h = 0; h < 65536; ++h) {
+            float f = EncodedColumnStore::fromHalf(uint16_t(h));
+            if (f != f) continue;
+            QCOMPARE(int(EncodedColumnStore::toHalf(f)), h);
+        }
+    }
+
+    void halfAccuracy() {
+        rnd.seed(999);
+        for (int i = 0; i < 200000; ++i) {
+            float f = float(pow(2.0, (rnd() % 8000) / 200.0 - 25.0) *
+                            (1.0 + (rnd() % 1000) / 1000.0));
+            if (i % 2) f = -f;
+            float stored = EncodedColumnStore::fromHalf
+                (EncodedColumnStore::toHalf(f));
+            if (!withinHalfBounds(f, stored)) {
+                cerr << "value " << f << " stored as " << stored << endl;
+            }
+            QVERIFY(withinHalfBounds(f, stored));
+        }
+    }
+
+    void halfSpecials() {
+        float inf = INFINITY;
+        QCOMPARE(EncodedColumnStore::fromHalf(EncodedColumnStore::toHalf(inf)),
+                 inf);
+        QCOMPARE(EncodedColumnStore::fromHalf(EncodedColumnStore::toHalf(-inf)),
+                 -inf);
+        float nan = NAN;
+        float stored = EncodedColumnStore::fromHalf
+            (EncodedColumnStore::toHalf(nan));
+        QVERIFY(stored != stored);
+        QCOMPARE(EncodedColumnStore::fromHalf(EncodedColumnStore::toHalf(1e9f)),
+                 65504.f);
+        QCOMPARE(EncodedColumnStore::fromHalf(EncodedColumnStore::toHalf(0.f)),
+                 0.f);
+    }
+
+    void halfStoreInOrder() {
+        checkStore(EncodedColumnStore::HalfFloat, true);
+    }
+
+    void halfStoreRandom() {
+        checkStore(EncodedColumnStore::HalfFloat, false);
+    }
+
+    void xorStoreInOrder() {
+        checkStore(EncodedColumnStore::XorBlock, true);
+    }
+
+    void xorStoreRandom() {
+        checkStore(EncodedColumnStore::XorBlock, false);
+    }
+
+    void xorStoreSmaller() {
+        // Slowly-changing columns should take well under their plain size
+        EncodedColumnStore store(EncodedColumnStore::XorBlock);
+        int h = 256, w = 1024;
+        for (int x = 0; x < w; ++x) {
+            Column c(h);
+            for (int i = 0; i < h; ++i) c[i] = float(i / 8 + x / 256);
+            store.setColumn(x, c);
+        }
+        QVERIFY(store.getMemoryUsage() < size_t(w) * h * sizeof(float) / 2);
+    }
+
+    void modelHalfPrecision() {
+        checkModel(EditableDenseThreeDimensionalModel::HalfPrecisionCompression);
+    }
+
+    void modelDeltaBlock() {
+        checkModel(EditableDenseThreeDimensionalModel::DeltaBlockCompression);
+    }
+
+    void modelNoCompression() {
+        checkModel(EditableDenseThreeDimensionalModel::NoCompression);
+    }
+};
+
+#endif
@@ -0,0 +1,194 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+
+/*
+    Sonic Visualiser
+    An audio file viewer and annotation editor.
+    Centre for Digital Music, Queen Mary, University of London.
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation; either version 2 of the
+    License, or (at your option) any later version.  See the file
+    COPYING included with this distribution for more information.
+*/
+
+#ifndef TEST_DENSE_XML_H
+#define TEST_DENSE_XML_H
+
+#include "../EditableDenseThreeDimensionalModel.h"
+#include "base/test/TestRandom.h"
+
+#include <QObject>
+#include <QtTest>
+#include <QTextStream>
+#include <QXmlStreamReader>
+#include <QXmlAttributes>
+
+#include <iostream>
+#include <vector>
+#include <cmath>
+
+using namespace std;
+
+class TestDenseXml : public QObject
+{
+    Q_OBJECT
+
+    typedef EditableDenseThreeDimensionalModel Model;
+    typedef vector<float> Column;
+
+    static const int height = 24;
+
+    static void fill(Model &model, int width, bool smooth) {
+        TestRandom rnd(1234);
+        for (int x = 0; x < width; ++x) {
+            Column c(height);
+            for (int i = 0; i < height; ++i) {
+                int r = rnd();
+                if (smooth) c[i] = float(i % 5);
+                else c[i] = float(sin(x * 0.37 + i) * 1000.0 +
+                                  (r >> 8) * 1e-5);
+            }
+            model.setColumn(x, c);
+        }
+    }
+
+    static QString write(const Model &model) {
+        QString xml;
+        QTextStream out(&xml);
+        model.toXml(out);
+        out.flush();
+        return xml;
+    }
+
+    // Read the dataset back as a session reader would, with "row"
+    // elements split into values and "rows" passed to the model
+    static bool read(const QString &xml, Model &model) {
+        QXmlStreamReader reader(xml);
+        while (!reader.atEnd()) {
+            reader.readNext();
+            if (!reader.isStartElement()) continue;
+            if (reader.name() == "row") {
+                int n = reader.attributes().value("n").toString().toInt();
+                QStringList values = reader.readElementText()
+                    .split(' ', QString::SkipEmptyParts);
+                Column c;
+                for (QString v : values) c.push_back(v.toFloat());
+                model.setColumn(n, c);
+            } else if (reader.name() == "rows") {
+                QXmlAttributes attrs;
+                for (const QXmlStreamAttribute &a : reader.attributes()) {
+                    attrs.append(a.name().toString(), "", "",
+                                 a.value().toString());
+                }
+                if (!model.setColumnsFromXml(attrs, reader.readElementText())) {
+                    return false;
+                }
+            }
+        }
+        return !reader.hasError();
+    }
+
+    void checkRoundTrip(Model::CompressionType type,
+                        Model::DatasetEncoding encoding) {
+
+        Model original(44100, 512, height, type, false);
+        fill(original, 1000, false);
+        original.setDatasetEncoding(encoding);
+
+        QString xml = write(original);
+        QCOMPARE(xml.contains("<rows "), encoding == Model::BinaryDataset);
+
+        Model copy(44100, 512, height, type, false);
+        QVERIFY(read(xml, copy));
+        QCOMPARE(copy.getWidth(), original.getWidth());
+
+        for (int x = 0; x < original.getWidth(); ++x) {
+            Column a = original.getColumn(x);
+            Column b = copy.getColumn(x);
+            QCOMPARE(b.size(), a.size());
+            for (int i = 0; i < int(a.size()); ++i) {
+                if (encoding == Model::BinaryDataset) {
+                    QCOMPARE(b[i], a[i]);
+                } else {
+                    // Text is written at six significant figures
+                    QVERIFY(fabsf(b[i] - a[i]) <= fabsf(a[i]) * 1e-5f);
+                }
+            }
+        }
+    }
+
+private slots:
+    void binaryNoCompression() {
+        checkRoundTrip(Model::NoCompression, Model::BinaryDataset);
+    }
+
+    void binaryMultirate() {
+        checkRoundTrip(Model::BasicMultirateCompression, Model::BinaryDataset);
+    }
+
+    void binaryHalfPrecision() {
+        checkRoundTrip(Model::HalfPrecisionCompression, Model::BinaryDataset);
+    }
+
+    void binaryDeltaBlock() {
+        checkRoundTrip(Model::DeltaBlockCompression, Model::BinaryDataset);
+    }
+
+    void text() {
+        checkRoundTrip(Model::NoCompression, Model::TextDataset);
+    }
+
+    void textByDefault() {
+        // Binary datasets can't be read by older loaders
+        Model model(44100, 512, height, Model::NoCompression, false);
+        QCOMPARE(model.getDatasetEncoding(), Model::TextDataset);
+        fill(model, 10, false);
+        QString xml = write(model);
+        QVERIFY(xml.contains("<row "));
+        QVERIFY(!xml.contains("<rows "));
+    }
+
+    void binarySmaller() {
+        Model model(44100, 512, height, Model::NoCompression, false);
+        fill(model, 1000, false);
+        model.setDatasetEncoding(Model::TextDataset);
+        int textSize = write(model).size();
+        model.setDatasetEncoding(Model::BinaryDataset);
+        QString xml = write(model);
+        QVERIFY(xml.size() < textSize);
+
+        // Repetitive data is compressed
+        Model smooth(44100, 512, height, Model::NoCompression, false);
+        fill(smooth, 1000, true);
+        smooth.setDatasetEncoding(Model::BinaryDataset);
+        QString sxml = write(smooth);
+        QVERIFY(sxml.contains("compression=\"qcompress\""));
+        QVERIFY(sxml.size() < xml.size() / 4);
+    }
+
+    void malformed() {
+        Model model(44100, 512, height, Model::NoCompression, false);
+
+        QXmlAttributes attrs;
+        attrs.append("n", "", "", "0");
+        attrs.append("count", "", "", "2");
+        attrs.append("encoding", "", "", "base64");
+
+        // One column of one value, where two columns are promised
+        QByteArray bytes(8, '\0');
+        bytes[0] = 1;
+        QVERIFY(!model.setColumnsFromXml(attrs, QString::fromLatin1
+                                         (bytes.toBase64())));
+        QCOMPARE(model.getWidth(), 0);
+
+        QXmlAttributes other;
+        other.append("n", "", "", "0");
+        other.append("count", "", "", "1");
+        other.append("encoding", "", "", "hex");
+        QVERIFY(!model.setColumnsFromXml(other, ""));
+        QCOMPARE(model.getWidth(), 0);
+    }
+};
+
+#endif
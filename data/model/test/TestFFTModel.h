@@ -16,6 +16,7 @@
 #define TEST_FFT_MODEL_H
 
 #include "../FFTModel.h"
+#include "../MultiChannelFFT.h"
 
 #include "MockWaveModel.h"
 
@@ -86,6 +87,44 @@ private:
                 QCOMPARE(imags[hs1], 999.f);
             }
         }
+        testMultiChannel(model, window, windowSize, windowIncrement, fftSize,
+                         columnNo, expectedValues);
+    }
+
+    void testMultiChannel(DenseTimeValueModel *model,
+                          WindowType window, int windowSize,
+                          int windowIncrement, int fftSize, int columnNo,
+                          vector<vector<complex<float>>> expectedValues) {
+        // MultiChannelFFT should produce the same values as FFTModel
+        // for every channel, in a single pass
+        int channels = int(expectedValues.size());
+        int hs1 = fftSize/2 + 1;
+        vector<vector<float>> buffers
+            (channels, vector<float>(hs1 * 2 + 1, 0.f));
+        vector<float *> ptrs;
+        for (int ch = 0; ch < channels; ++ch) {
+            buffers[ch][hs1 * 2] = 999.f; // overrun guard
+            ptrs.push_back(buffers[ch].data());
+        }
+        for (int stepThrough = 0; stepThrough <= 1; ++stepThrough) {
+            MultiChannelFFT mcfft(model, 0, channels, window, windowSize,
+                                  windowIncrement, fftSize);
+            if (stepThrough) {
+                for (int sc = 0; sc < columnNo; ++sc) {
+                    mcfft.getInterleavedColumn(sc, ptrs.data());
+                }
+            }
+            QVERIFY(mcfft.getInterleavedColumn(columnNo, ptrs.data()));
+            for (int ch = 0; ch < channels; ++ch) {
+                for (int i = 0; i < hs1; ++i) {
+                    COMPARE_FUZZIER_F(buffers[ch][i*2],
+                                      expectedValues[ch][i].real());
+                    COMPARE_FUZZIER_F(buffers[ch][i*2+1],
+                                      expectedValues[ch][i].imag());
+                }
+                QCOMPARE(buffers[ch][hs1 * 2], 999.f);
+            }
+        }
     }
 
 private slots:
@@ -0,0 +1,186 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+
+/*
+    Sonic Visualiser
+    An audio file viewer and annotation editor.
+    Centre for Digital Music, Queen Mary, University of London.
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation; either version 2 of the
+    License, or (at your option) any later version.  See the file
+    COPYING included with this distribution for more information.
+*/
+
+#ifndef TEST_LOG_MAGNITUDE_FFT_MODEL_H
+#define TEST_LOG_MAGNITUDE_FFT_MODEL_H
+
+#include "../LogMagnitudeFFTModel.h"
+#include "../FFTModel.h"
+
+#include "MockWaveModel.h"
+
+#include <QObject>
+#include <QtTest>
+
+#include <iostream>
+#include <vector>
+#include <atomic>
+#include <cmath>
+
+using namespace std;
+
+class TestLogMagnitudeFFTModel : public QObject
+{
+    Q_OBJECT
+
+    typedef LogMagnitudeFFTModel::Column Column;
+
+    static const int fftSize = 64;
+    static const int increment = 16;
+
+    // A sine wave whose samples become available a block at a time,
+    // as from a file that is still being decoded
+    class LoadingWaveModel : public DenseTimeValueModel
+    {
+    public:
+        LoadingWaveModel(int length) : m_available(0), m_complete(false) {
+            for (int i = 0; i < length; ++i) {
+                m_data.push_back(float(sin(i * 0.3) * 0.5));
+            }
+        }
+
+        void setAvailable(sv_frame_t n) { m_available = n; }
+        void setComplete() {
+            m_available = sv_frame_t(m_data.size());
+            m_complete = true;
+        }
+
+        virtual float getValueMinimum() const { return -1.f; }
+        virtual float getValueMaximum() const { return  1.f; }
+        virtual int getChannelCount() const { return 1; }
+
+        virtual floatvec_t getData(int, sv_frame_t start,
+                                   sv_frame_t count) const {
+            floatvec_t data;
+            sv_frame_t end = m_available;
+            for (sv_frame_t i = start; i < start + count && i < end; ++i) {
+                if (i >= 0) data.push_back(m_data[i]);
+            }
+            return data;
+        }
+        virtual vector<floatvec_t> getMultiChannelData(int, int,
+                                                       sv_frame_t start,
+                                                       sv_frame_t count) const {
+            return vector<floatvec_t>(1, getData(0, start, count));
+        }
+
+        virtual sv_frame_t getStartFrame() const { return 0; }
+        virtual sv_frame_t getEndFrame() const { return m_available; }
+        virtual sv_samplerate_t getSampleRate() const { return 44100; }
+        virtual bool isOK() const { return true; }
+        virtual bool isReady(int *completion = 0) const {
+            if (completion) *completion = (m_complete ? 100 : 50);
+            return m_complete;
+        }
+
+        QString getTypeName() const { return "Loading Wave"; }
+
+    private:
+        vector<float> m_data;
+        atomic<sv_frame_t> m_available;
+        atomic<bool> m_complete;
+    };
+
+    static double toDb(float magnitude) {
+        return 20.0 * log10(double(magnitude));
+    }
+
+    // Every magnitude that is within the scale must come back within
+    // half a step of the unquantised value, and every one below it
+    // (allowing for rounding at the floor) must come back as zero
+    void checkQuantisation(LogMagnitudeFFTModel::Precision precision) {
+        MockWaveModel mwm({ Sine, Dirac }, 2000, 100);
+        for (int ch = 0; ch < 2; ++ch) {
+            FFTModel fftm(&mwm, ch, HanningWindow, fftSize, increment, fftSize);
+            LogMagnitudeFFTModel lm(&mwm, ch, HanningWindow, fftSize,
+                                    increment, fftSize, precision);
+            QCOMPARE(lm.getWidth(), fftm.getWidth());
+            QCOMPARE(lm.getHeight(), fftm.getHeight());
+            double step = (lm.getCeilingDb() - lm.getFloorDb()) /
+                (precision == LogMagnitudeFFTModel::EightBit ? 255 : 65535);
+            QVERIFY(fabs(lm.getCeilingDb() - toDb(float(fftSize))) < 1e-9);
+            int nonzero = 0;
+            for (int x = 0; x < lm.getWidth(); ++x) {
+                Column expected = fftm.getColumn(x);
+                Column actual = lm.getColumn(x);
+                QCOMPARE(actual.size(), expected.size());
+                for (int y = 0; y < int(actual.size()); ++y) {
+                    if (actual[y] == 0.f) {
+                        QVERIFY(expected[y] == 0.f ||
+                                toDb(expected[y]) <
+                                lm.getFloorDb() + step / 2 + 1e-4);
+                    } else {
+                        double error = fabs(toDb(actual[y]) - toDb(expected[y]));
+                        if (error > step / 2 + 1e-4) {
+                            cerr << "precision " << precision << ", channel "
+                                 << ch << ", column " << x << ", bin " << y
+                                 << ": expected " << expected[y] << ", got "
+                                 << actual[y] << endl;
+                        }
+                        QVERIFY(error <= step / 2 + 1e-4);
+                        ++nonzero;
+                    }
+                    QCOMPARE(lm.getValueAt(x, y), actual[y]);
+                }
+            }
+            QVERIFY(nonzero > 0);
+        }
+    }
+
+private slots:
+    void eightBitQuantisation() {
+        checkQuantisation(LogMagnitudeFFTModel::EightBit);
+    }
+
+    void sixteenBitQuantisation() {
+        checkQuantisation(LogMagnitudeFFTModel::SixteenBit);
+    }
+
+    void partialSource() {
+        // A column read while its source samples are still arriving
+        // must not be kept, but recalculated once they are all there
+
+        const int length = 4000;
+
+        LoadingWaveModel complete(length);
+        complete.setComplete();
+        LogMagnitudeFFTModel reference(&complete, 0, HanningWindow, fftSize,
+                                       increment, fftSize);
+
+        LoadingWaveModel loading(length);
+        loading.setAvailable(length / 2);
+        LogMagnitudeFFTModel lm(&loading, 0, HanningWindow, fftSize,
+                                increment, fftSize);
+
+        // The last column, which is centred on the last sample so far
+        int x = lm.getWidth() - 1;
+        Column partial = lm.getColumn(x);
+        QCOMPARE(int(partial.size()), lm.getHeight());
+        QVERIFY(partial != reference.getColumn(x));
+
+        loading.setComplete();
+
+        for (int i = 0; i < 100 && lm.getCompletion() < 100; ++i) {
+            QTest::qWait(50);
+        }
+        QCOMPARE(lm.getCompletion(), 100);
+        QCOMPARE(lm.getWidth(), reference.getWidth());
+
+        for (int c = 0; c < lm.getWidth(); ++c) {
+            QCOMPARE(lm.getColumn(c), reference.getColumn(c));
+        }
+    }
+};
+
+#endif
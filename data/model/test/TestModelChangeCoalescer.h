@@ -0,0 +1,125 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+
+/*
+    Sonic Visualiser
+    An audio file viewer and annotation editor.
+    Centre for Digital Music, Queen Mary, University of London.
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation; either version 2 of the
+    License, or (at your option) any later version.  See the file
+    COPYING included with this distribution for more information.
+*/
+
+#ifndef TEST_MODEL_CHANGE_COALESCER_H
+#define TEST_MODEL_CHANGE_COALESCER_H
+
+#include "../ModelChangeCoalescer.h"
+#include "../SparseTimeValueModel.h"
+
+#include <QObject>
+#include <QtTest>
+
+#include <iostream>
+
+using namespace std;
+
+class TestModelChangeCoalescer : public QObject
+{
+    Q_OBJECT
+
+    // What a listener to the coalescer has seen
+    struct Seen {
+        Seen() : changed(0), changedWithin(0), completion(0),
+                 start(0), end(0) { }
+        int changed;
+        int changedWithin;
+        int completion;
+        sv_frame_t start;
+        sv_frame_t end;
+    };
+
+    static void listen(ModelChangeCoalescer *c, Seen *seen) {
+        connect(c, &ModelChangeCoalescer::modelChanged,
+                [seen]() { ++seen->changed; });
+        connect(c, &ModelChangeCoalescer::modelChangedWithin,
+                [seen](sv_frame_t start, sv_frame_t end) {
+                    ++seen->changedWithin;
+                    seen->start = start;
+                    seen->end = end;
+                });
+        connect(c, &ModelChangeCoalescer::completionChanged,
+                [seen]() { ++seen->completion; });
+    }
+
+private slots:
+    void shared() {
+        SparseTimeValueModel model(44100, 10, true);
+        ModelChangeCoalescer *c = ModelChangeCoalescer::getFor(&model, 0);
+        QCOMPARE(ModelChangeCoalescer::getFor(&model, 100), c);
+        QCOMPARE(c->getInterval(), 0);
+    }
+
+    void mergedRange() {
+        SparseTimeValueModel model(44100, 10, true);
+        ModelChangeCoalescer *c = ModelChangeCoalescer::getFor(&model);
+        Seen seen;
+        listen(c, &seen);
+
+        long totalReceived = ModelChangeCoalescer::getTotalReceivedCount();
+
+        for (int i = 0; i < 100; ++i) {
+            model.addPoint(TimeValuePoint(1000 + (i * 37) % 500, 1.f, ""));
+        }
+        QCOMPARE(c->getReceivedCount(), 100);
+        QCOMPARE(c->getDeliveredCount(), 0);
+        QCOMPARE(ModelChangeCoalescer::getTotalReceivedCount(),
+                 totalReceived + 100);
+
+        QTest::qWait(20);
+
+        QCOMPARE(c->getDeliveredCount(), 1);
+        QCOMPARE(seen.changedWithin, 1);
+        QCOMPARE(seen.start, sv_frame_t(1000));
+        QCOMPARE(seen.end, sv_frame_t(1499 + 10));
+        QCOMPARE(seen.changed, 0);
+    }
+
+    void wholeModelSupersedes() {
+        SparseTimeValueModel model(44100, 10, true);
+        ModelChangeCoalescer *c = ModelChangeCoalescer::getFor(&model);
+        Seen seen;
+        listen(c, &seen);
+
+        model.addPoint(TimeValuePoint(100, 1.f, ""));
+        model.clear();
+        model.addPoint(TimeValuePoint(200, 1.f, ""));
+        c->flush();
+
+        QCOMPARE(seen.changed, 1);
+        QCOMPARE(seen.changedWithin, 0);
+        QCOMPARE(c->getReceivedCount(), 3);
+        QCOMPARE(c->getDeliveredCount(), 1);
+
+        // Nothing left to deliver
+        QTest::qWait(20);
+        QCOMPARE(c->getDeliveredCount(), 1);
+    }
+
+    void completion() {
+        SparseTimeValueModel model(44100, 10, false);
+        ModelChangeCoalescer *c = ModelChangeCoalescer::getFor(&model);
+        Seen seen;
+        listen(c, &seen);
+
+        for (int i = 1; i < 10; ++i) {
+            model.setCompletion(i * 10, false);
+        }
+        c->flush();
+        QCOMPARE(c->getReceivedCount(), 9);
+        QCOMPARE(seen.completion, 1);
+    }
+};
+
+#endif
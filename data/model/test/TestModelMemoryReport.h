@@ -0,0 +1,162 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+
+/*
+    Sonic Visualiser
+    An audio file viewer and annotation editor.
+    Centre for Digital Music, Queen Mary, University of London.
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation; either version 2 of the
+    License, or (at your option) any later version.  See the file
+    COPYING included with this distribution for more information.
+*/
+
+#ifndef TEST_MODEL_MEMORY_REPORT_H
+#define TEST_MODEL_MEMORY_REPORT_H
+
+#include "../ModelMemoryReport.h"
+#include "../SparseTimeValueModel.h"
+#include "../NoteModel.h"
+#include "../EditableDenseThreeDimensionalModel.h"
+#include "../FFTModel.h"
+
+#include "MockWaveModel.h"
+
+#include "base/StorageAdviser.h"
+
+#include <QObject>
+#include <QtTest>
+
+#include <iostream>
+#include <vector>
+
+using namespace std;
+
+class TestModelMemoryReport : public QObject
+{
+    Q_OBJECT
+
+    static const ModelMemoryReport::Entry *find(const ModelMemoryReport &r,
+                                                const Model *model) {
+        for (const auto &e : r.getEntries()) {
+            if (e.model == model) return &e;
+        }
+        return 0;
+    }
+
+private slots:
+    void sparse() {
+        SparseTimeValueModel model(44100, 10, false);
+        size_t empty = model.getMemoryUsage();
+        for (int i = 0; i < 10000; ++i) {
+            model.addPoint(TimeValuePoint(i * 10, float(i % 100), ""));
+        }
+        size_t full = model.getMemoryUsage();
+        QVERIFY(full >= empty + 10000 * sizeof(TimeValuePoint));
+    }
+
+    void intervals() {
+        NoteModel model(44100, 10, false);
+        for (int i = 0; i < 1000; ++i) {
+            model.addPoint(Note(i * 10, 60.f, 100, 1.f, ""));
+        }
+        size_t points = model.SparseValueModel<Note>::getMemoryUsage();
+        QVERIFY(points >= 1000 * sizeof(Note));
+        QVERIFY(model.getMemoryUsage() > points);
+    }
+
+    void dense() {
+        EditableDenseThreeDimensionalModel model
+            (44100, 512, 64, EditableDenseThreeDimensionalModel::NoCompression,
+             false);
+        vector<float> column(64, 1.f);
+        for (int x = 0; x < 1000; ++x) {
+            model.setColumn(x, column);
+        }
+        QVERIFY(model.getMemoryUsage() >= 1000 * 64 * sizeof(float));
+    }
+
+    void report() {
+        SparseTimeValueModel small(44100, 10, false);
+        small.setObjectName("small");
+        small.addPoint(TimeValuePoint(0, 1.f, ""));
+
+        SparseTimeValueModel large(44100, 10, false);
+        large.setObjectName("large");
+        for (int i = 0; i < 5000; ++i) {
+            large.addPoint(TimeValuePoint(i * 10, 1.f, ""));
+        }
+
+        // Models are only reported once registered
+        QVERIFY(!find(ModelMemoryReport(), &small));
+        Model::registerModel(&small);
+        Model::registerModel(&large);
+
+        ModelMemoryReport r;
+
+        const ModelMemoryReport::Entry *s = find(r, &small);
+        const ModelMemoryReport::Entry *l = find(r, &large);
+        QVERIFY(s);
+        QVERIFY(l);
+        QCOMPARE(s->bytes, small.getMemoryUsage());
+        QCOMPARE(l->bytes, large.getMemoryUsage());
+        QCOMPARE(l->name, QString("large"));
+        QCOMPARE(l->typeName, large.getTypeName());
+        QVERIFY(l < s); // largest first
+
+        size_t total = 0;
+        for (const auto &e : r.getEntries()) {
+            QVERIFY(e.bytes > 0);
+            total += e.bytes;
+        }
+        QCOMPARE(r.getModelTotal(), total);
+        QVERIFY(r.toString().contains("\"large\""));
+
+        large.aboutToDelete();
+        ModelMemoryReport after;
+        QVERIFY(!find(after, &large));
+        QVERIFY(find(after, &small));
+        small.aboutToDelete();
+    }
+
+    void destroyed() {
+        const Model *address = 0;
+        {
+            SparseTimeValueModel model(44100, 10, false);
+            model.addPoint(TimeValuePoint(0, 1.f, ""));
+            Model::registerModel(&model);
+            QVERIFY(find(ModelMemoryReport(), &model));
+            address = &model;
+        }
+        QVERIFY(!find(ModelMemoryReport(), address));
+    }
+
+    void selfRegistered() {
+        // Caches such as the FFT model register themselves once
+        // constructed, as nothing hands them on explicitly
+        MockWaveModel mwm({ Sine }, 1000, 0);
+        const Model *address = 0;
+        {
+            FFTModel fftm(&mwm, 0, HanningWindow, 64, 16, 64);
+            ModelMemoryReport r;
+            const ModelMemoryReport::Entry *e = find(r, &fftm);
+            QVERIFY(e);
+            QCOMPARE(e->bytes, fftm.getMemoryUsage());
+            address = &fftm;
+        }
+        QVERIFY(!find(ModelMemoryReport(), address));
+    }
+
+    void planned() {
+        size_t before = ModelMemoryReport().getPlannedMemory();
+        StorageAdviser::notifyPlannedAllocation
+            (StorageAdviser::MemoryAllocation, 100);
+        QCOMPARE(ModelMemoryReport().getPlannedMemory(), before + 100 * 1024);
+        StorageAdviser::notifyDoneAllocation
+            (StorageAdviser::MemoryAllocation, 100);
+        QCOMPARE(ModelMemoryReport().getPlannedMemory(), before);
+    }
+};
+
+#endif
@@ -0,0 +1,107 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+
+/*
+    Sonic Visualiser
+    An audio file viewer and annotation editor.
+    Centre for Digital Music, Queen Mary, University of London.
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation; either version 2 of the
+    License, or (at your option) any later version.  See the file
+    COPYING included with this distribution for more information.
+*/
+
+#ifndef TEST_SPARSE_MODEL_ADD_POINTS_H
+#define TEST_SPARSE_MODEL_ADD_POINTS_H
+
+#include "../SparseTimeValueModel.h"
+#include "../NoteModel.h"
+#include "SparsePoints.h"
+
+#include <QObject>
+#include <QtTest>
+
+#include <iostream>
+#include <vector>
+
+using namespace std;
+
+class TestSparseModelAddPoints : public QObject
+{
+    Q_OBJECT
+
+    TestRandom rnd;
+
+    // Add the points in batches of the given size to one model, and
+    // one at a time to another, and compare
+    void checkBatches(int count, int batch) {
+        rnd.seed(23);
+        SparseTimeValueModel bulk(44100, 10, true);
+        SparseTimeValueModel single(44100, 10, true);
+        for (int base = 0; base < count; base += batch) {
+            vector<TimeValuePoint> points =
+                makeTimeValuePoints(rnd, batch, base);
+            bulk.addPoints(points);
+            for (const auto &p : points) single.addPoint(p);
+            QVERIFY(sameTimeValuePoints(getTimeValuePoints(bulk),
+                                        getTimeValuePoints(single)));
+            QCOMPARE(bulk.getValueMinimum(), single.getValueMinimum());
+            QCOMPARE(bulk.getValueMaximum(), single.getValueMaximum());
+            QCOMPARE(bulk.hasTextLabels(), single.hasTextLabels());
+        }
+    }
+
+private slots:
+    void empty() {
+        SparseTimeValueModel model(44100, 10, true);
+        model.addPoints(vector<TimeValuePoint>());
+        QCOMPARE(model.getPointCount(), 0);
+    }
+
+    void mergeLargeBatches() {
+        // Each batch is large enough to merge in a single pass
+        checkBatches(4000, 1000);
+    }
+
+    void insertSmallBatches() {
+        // Later batches are small compared with the model
+        checkBatches(4000, 20);
+    }
+
+    void rowsAfterBatches() {
+        rnd.seed(5);
+        SparseTimeValueModel model(44100, 10, true);
+        model.addPoints(makeTimeValuePoints(rnd, 100, 0));
+        QCOMPARE(model.getRowCount(), 100);
+        // Row index is now built, and must be kept up to date
+        model.getFrameForRow(0);
+        model.addPoints(makeTimeValuePoints(rnd, 10, 100));
+        model.addPoints(makeTimeValuePoints(rnd, 500, 110));
+        int row = 0;
+        for (const auto &p : model.getPointsCopy()) {
+            QCOMPARE(model.getFrameForRow(row), p.frame);
+            ++row;
+        }
+        QCOMPARE(model.getRowCount(), 610);
+    }
+
+    void notesAfterBatches() {
+        // The interval index must see points added in bulk
+        NoteModel model(44100, 10, true);
+        vector<Note> notes;
+        notes.push_back(Note(5000, 60.f, 100, 1.f, ""));
+        notes.push_back(Note(0, 60.f, 10000, 1.f, ""));
+        model.addPoints(notes);
+        notes.clear();
+        for (int i = 0; i < 10; ++i) {
+            notes.push_back(Note(i * 1000 + 10, 60.f, 10, 1.f, ""));
+        }
+        model.addPoints(notes);
+        QCOMPARE(model.getPointCount(), 12);
+        QCOMPARE(int(model.getPoints(5050, 5060).size()), 2);
+        QCOMPARE(int(model.getPoints(3015, 3016).size()), 2);
+    }
+};
+
+#endif
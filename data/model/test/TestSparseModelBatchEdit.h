@@ -0,0 +1,154 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+
+/*
+    Sonic Visualiser
+    An audio file viewer and annotation editor.
+    Centre for Digital Music, Queen Mary, University of London.
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation; either version 2 of the
+    License, or (at your option) any later version.  See the file
+    COPYING included with this distribution for more information.
+*/
+
+#ifndef TEST_SPARSE_MODEL_BATCH_EDIT_H
+#define TEST_SPARSE_MODEL_BATCH_EDIT_H
+
+#include "../SparseTimeValueModel.h"
+#include "../NoteModel.h"
+#include "SparsePoints.h"
+
+#include <QObject>
+#include <QtTest>
+
+#include <iostream>
+#include <vector>
+
+using namespace std;
+
+class TestSparseModelBatchEdit : public QObject
+{
+    Q_OBJECT
+
+    typedef SparseTimeValueModel::BatchEditCommand Command;
+
+    TestRandom rnd;
+
+    // Relabel every nth point and delete the one after it, comparing
+    // against the same edits made with an EditCommand
+    void checkEdit(int count, int n) {
+        rnd.seed(17);
+        SparseTimeValueModel model(44100, 10, true);
+        model.addPoints(makeTimeValuePoints(rnd, count));
+        SparseTimeValueModel reference(44100, 10, true);
+        reference.addPoints(getTimeValuePoints(model));
+
+        vector<TimeValuePoint> before = getTimeValuePoints(model);
+
+        Command *command = new Command(&model, "Edit");
+        SparseTimeValueModel::EditCommand *refCommand =
+            new SparseTimeValueModel::EditCommand(&reference, "Edit");
+
+        int i = 0;
+        for (const auto &p : before) {
+            if (i % n == 0) {
+                TimeValuePoint q(p);
+                q.label = "relabelled";
+                command->deletePoint(p);
+                command->addPoint(q);
+                refCommand->deletePoint(p);
+                refCommand->addPoint(q);
+            } else if (i % n == 1) {
+                command->deletePoint(p);
+                refCommand->deletePoint(p);
+            }
+            ++i;
+        }
+
+        QVERIFY(command->finish() == command);
+        refCommand = refCommand->finish();
+
+        vector<TimeValuePoint> after = getTimeValuePoints(model);
+        QVERIFY(sameTimeValuePoints(after, getTimeValuePoints(reference)));
+        QCOMPARE(model.getValueMinimum(), reference.getValueMinimum());
+        QCOMPARE(model.getValueMaximum(), reference.getValueMaximum());
+
+        command->unexecute();
+        QVERIFY(sameTimeValuePoints(getTimeValuePoints(model), before));
+        command->execute();
+        QVERIFY(sameTimeValuePoints(getTimeValuePoints(model), after));
+
+        delete command;
+        delete refCommand;
+    }
+
+private slots:
+    void emptyFinish() {
+        SparseTimeValueModel model(44100, 10, true);
+        Command *command = new Command(&model, "Nothing");
+        QVERIFY(!command->finish());
+    }
+
+    void cancelledAdd() {
+        SparseTimeValueModel model(44100, 10, true);
+        Command *command = new Command(&model, "Cancelled");
+        TimeValuePoint p(100, 1.f, "a");
+        command->addPoint(p);
+        command->deletePoint(p);
+        QVERIFY(!command->finish());
+        QCOMPARE(model.getPointCount(), 0);
+    }
+
+    void largeEdit() {
+        // Deletions are a large part of the model, and are filtered
+        // out in a single pass
+        checkEdit(2000, 2);
+    }
+
+    void smallEdit() {
+        // Deletions are few enough to be removed one at a time
+        checkEdit(2000, 100);
+    }
+
+    void extentsAfterUndo() {
+        SparseTimeValueModel model(44100, 10, true);
+        model.addPoint(TimeValuePoint(10, 1.f, ""));
+        model.addPoint(TimeValuePoint(20, 5.f, ""));
+        model.addPoint(TimeValuePoint(30, 9.f, ""));
+        Command *command = new Command(&model, "Delete");
+        command->deletePoint(TimeValuePoint(10, 1.f, ""));
+        command->deletePoint(TimeValuePoint(30, 9.f, ""));
+        command = command->finish();
+        QCOMPARE(model.getValueMinimum(), 5.f);
+        QCOMPARE(model.getValueMaximum(), 5.f);
+        command->unexecute();
+        QCOMPARE(model.getValueMinimum(), 1.f);
+        QCOMPARE(model.getValueMaximum(), 9.f);
+        delete command;
+    }
+
+    void notesAfterUndo() {
+        // The interval index must follow the batch in both directions
+        NoteModel model(44100, 10, true);
+        Note longNote(0, 60.f, 10000, 1.f, "");
+        model.addPoint(longNote);
+        NoteModel::BatchEditCommand *command =
+            new NoteModel::BatchEditCommand(&model, "Notes");
+        command->deletePoint(longNote);
+        for (int i = 0; i < 10; ++i) {
+            command->addPoint(Note(i * 1000 + 10, 60.f, 10, 1.f, ""));
+        }
+        command = command->finish();
+        QCOMPARE(int(model.getPoints(5050, 5060).size()), 0);
+        QCOMPARE(int(model.getPoints(3015, 3016).size()), 1);
+        command->unexecute();
+        QCOMPARE(model.getPointCount(), 1);
+        QCOMPARE(int(model.getPoints(5050, 5060).size()), 1);
+        command->execute();
+        QCOMPARE(int(model.getPoints(3015, 3016).size()), 1);
+        delete command;
+    }
+};
+
+#endif
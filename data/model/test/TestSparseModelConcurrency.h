@@ -0,0 +1,149 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+
+/*
+    Sonic Visualiser
+    An audio file viewer and annotation editor.
+    Centre for Digital Music, Queen Mary, University of London.
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation; either version 2 of the
+    License, or (at your option) any later version.  See the file
+    COPYING included with this distribution for more information.
+*/
+
+#ifndef TEST_SPARSE_MODEL_CONCURRENCY_H
+#define TEST_SPARSE_MODEL_CONCURRENCY_H
+
+#include "../SparseTimeValueModel.h"
+#include "base/test/TestRandom.h"
+
+#include <QObject>
+#include <QtTest>
+
+#include <iostream>
+#include <vector>
+#include <thread>
+#include <atomic>
+
+using namespace std;
+
+class TestSparseModelConcurrency : public QObject
+{
+    Q_OBJECT
+
+    typedef SparseTimeValueModel Model;
+
+    // The writer adds the points for one block at a time, in a
+    // single batch, so that a reader should see all of a block or
+    // none of it
+    static const int blockPoints = 10;
+    static const int blockFrames = 100;
+    static const int blockCount = 2000;
+    static const int readerCount = 4;
+
+    static vector<TimeValuePoint> makeBlock(int b) {
+        vector<TimeValuePoint> points;
+        for (int i = 0; i < blockPoints; ++i) {
+            points.push_back(TimeValuePoint
+                             (b * blockFrames + i * (blockFrames / blockPoints),
+                              float(b), ""));
+        }
+        return points;
+    }
+
+    static void write(Model *model, int from, int to) {
+        for (int b = from; b < to; ++b) {
+            model->addPoints(makeBlock(b));
+        }
+    }
+
+    // Query random blocks until the writer is done, counting any
+    // that are incomplete or out of order
+    static void read(const Model *model, int blocks,
+                     const atomic<bool> *done,
+                     atomic<int> *errors, atomic<int> *reads, int seed) {
+
+        TestRandom rnd(unsigned(seed));
+
+        while (!done->load()) {
+
+            int b = rnd() % blocks;
+            sv_frame_t start = b * blockFrames;
+            sv_frame_t end = start + blockFrames - 1;
+
+            int count = 0;
+            sv_frame_t prev = -1;
+            model->visitPointsWithin
+                (start, end, [&](const TimeValuePoint &p) {
+                    if (p.frame < prev) ++*errors;
+                    prev = p.frame;
+                    if (p.frame >= start && p.frame <= end) ++count;
+                });
+            if (count != 0 && count != blockPoints) ++*errors;
+
+            Model::PointList points = model->getPoints(start, end);
+            count = 0;
+            for (const auto &p : points) {
+                if (p.frame >= start && p.frame <= end) ++count;
+            }
+            if (count != 0 && count != blockPoints) ++*errors;
+
+            ++*reads;
+        }
+    }
+
+    // Run readers against a model while a writer fills it, or with
+    // no writer if from == to
+    void contend(Model &model, int blocks, int from, int to) {
+
+        atomic<bool> done(false);
+        atomic<int> errors(0);
+        atomic<int> reads(0);
+
+        vector<thread> readers;
+        for (int r = 0; r < readerCount; ++r) {
+            readers.push_back(thread(read, &model, blocks, &done,
+                                     &errors, &reads, r + 1));
+        }
+
+        if (from < to) {
+            write(&model, from, to);
+        } else {
+            // Give the readers a fixed amount of work instead
+            while (reads.load() < 20000) {
+                this_thread::yield();
+            }
+        }
+
+        done = true;
+        for (auto &t : readers) t.join();
+
+        QCOMPARE(errors.load(), 0);
+    }
+
+private slots:
+    void consistentWhileFilling() {
+        Model model(44100, 1, false);
+        contend(model, blockCount, 0, blockCount);
+        QCOMPARE(model.getPointCount(), blockCount * blockPoints);
+    }
+
+    void benchReadersOnly() {
+        Model model(44100, 1, false);
+        write(&model, 0, blockCount);
+        QBENCHMARK {
+            contend(model, blockCount, 0, 0);
+        }
+    }
+
+    void benchReadersWithWriter() {
+        QBENCHMARK {
+            Model model(44100, 1, false);
+            write(&model, 0, blockCount / 2);
+            contend(model, blockCount / 2, blockCount / 2, blockCount);
+        }
+    }
+};
+
+#endif
@@ -0,0 +1,120 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+
+/*
+    Sonic Visualiser
+    An audio file viewer and annotation editor.
+    Centre for Digital Music, Queen Mary, University of London.
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation; either version 2 of the
+    License, or (at your option) any later version.  See the file
+    COPYING included with this distribution for more information.
+*/
+
+#ifndef TEST_SPARSE_MODEL_DELIMITED_H
+#define TEST_SPARSE_MODEL_DELIMITED_H
+
+#include "../SparseTimeValueModel.h"
+#include "../NoteModel.h"
+
+#include <QObject>
+#include <QtTest>
+#include <QBuffer>
+#include <QTextStream>
+
+#include <iostream>
+
+using namespace std;
+
+class TestSparseModelDelimited : public QObject
+{
+    Q_OBJECT
+
+    static QString row(const TimeValuePoint &p) {
+        return p.toDelimitedDataString(",", DataExportDefaults, 44100) + "\n";
+    }
+
+    // Points at 300, 310, 700 and 1000, at resolution 100
+    static void fill(SparseTimeValueModel &model) {
+        model.addPoint(TimeValuePoint(300, 1.f, "a"));
+        model.addPoint(TimeValuePoint(310, 2.f, "b"));
+        model.addPoint(TimeValuePoint(700, 3.f, "c"));
+        model.addPoint(TimeValuePoint(1000, 4.f, "d"));
+    }
+
+    static QString stream(const SparseTimeValueModel &model,
+                          DataExportOptions opts,
+                          sv_frame_t f0, sv_frame_t f1) {
+        QBuffer buffer;
+        buffer.open(QIODevice::WriteOnly);
+        QTextStream out(&buffer);
+        model.writeDelimitedDataSubset(out, ",", opts, f0, f1);
+        out.flush();
+        return QString::fromUtf8(buffer.data());
+    }
+
+private slots:
+    void subset() {
+        SparseTimeValueModel model(44100, 100, false);
+        fill(model);
+        QString expected =
+            row(TimeValuePoint(310, 2.f, "b")) +
+            row(TimeValuePoint(700, 3.f, "c"));
+        QCOMPARE(model.toDelimitedDataStringSubset(",", 305, 1000), expected);
+        QCOMPARE(stream(model, DataExportDefaults, 305, 1000), expected);
+    }
+
+    void filledSubset() {
+        SparseTimeValueModel model(44100, 100, false);
+        fill(model);
+        // Steps start in line with the first point in range, and
+        // continue a resolution step after each point written
+        QString expected =
+            row(TimeValuePoint(100)) +
+            row(TimeValuePoint(200)) +
+            row(TimeValuePoint(300, 1.f, "a")) +
+            row(TimeValuePoint(310, 2.f, "b")) +
+            row(TimeValuePoint(500)) +
+            row(TimeValuePoint(600)) +
+            row(TimeValuePoint(700, 3.f, "c")) +
+            row(TimeValuePoint(800));
+        QCOMPARE(model.toDelimitedDataStringSubsetWithOptions
+                 (",", DataExportFillGaps, 5, 900), expected);
+        QCOMPARE(stream(model, DataExportFillGaps, 5, 900), expected);
+    }
+
+    void filledEmptyRange() {
+        SparseTimeValueModel model(44100, 100, false);
+        fill(model);
+        QString expected =
+            row(TimeValuePoint(1100)) +
+            row(TimeValuePoint(1200));
+        QCOMPARE(stream(model, DataExportFillGaps, 1100, 1300), expected);
+    }
+
+    void whole() {
+        SparseTimeValueModel model(44100, 100, false);
+        fill(model);
+        QBuffer buffer;
+        buffer.open(QIODevice::WriteOnly);
+        QTextStream out(&buffer);
+        model.writeDelimitedData(out, ",", DataExportDefaults);
+        out.flush();
+        QCOMPARE(QString::fromUtf8(buffer.data()),
+                 model.toDelimitedDataString(","));
+        QCOMPARE(QString::fromUtf8(buffer.data()).count("\n"), 4);
+    }
+
+    void notes() {
+        // A note that starts before the range is not written, even
+        // though it overlaps it
+        NoteModel model(44100, 100, false);
+        model.addPoint(Note(0, 60.f, 1000, 1.f, ""));
+        model.addPoint(Note(500, 62.f, 100, 1.f, ""));
+        QString s = model.toDelimitedDataStringSubset(",", 100, 1000);
+        QCOMPARE(s.count("\n"), 1);
+    }
+};
+
+#endif
@@ -0,0 +1,111 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+
+/*
+    Sonic Visualiser
+    An audio file viewer and annotation editor.
+    Centre for Digital Music, Queen Mary, University of London.
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation; either version 2 of the
+    License, or (at your option) any later version.  See the file
+    COPYING included with this distribution for more information.
+*/
+
+#ifndef TEST_SPARSE_MODEL_ROWS_H
+#define TEST_SPARSE_MODEL_ROWS_H
+
+#include "../SparseTimeValueModel.h"
+#include "../NoteModel.h"
+#include "SparsePoints.h"
+
+#include <QObject>
+#include <QtTest>
+
+#include <iostream>
+#include <vector>
+
+using namespace std;
+
+class TestSparseModelRows : public QObject
+{
+    Q_OBJECT
+
+    TestRandom rnd;
+
+    // Check every row against the points in order, using the label
+    // to identify each point
+    void checkRows(const SparseTimeValueModel &model) {
+        int row = 0;
+        sv_frame_t prevFrame = -1;
+        for (const auto &p : model.getPointsCopy()) {
+            QCOMPARE(model.getFrameForRow(row), p.frame);
+            QCOMPARE(model.getData(row, 3, Qt::DisplayRole).toString(),
+                     p.label);
+            if (p.frame != prevFrame) {
+                // the first row at each frame
+                QCOMPARE(model.getRowForFrame(p.frame), row);
+            }
+            prevFrame = p.frame;
+            ++row;
+        }
+        QCOMPARE(model.getRowCount(), row);
+        QVERIFY(!model.getData(row, 3, Qt::DisplayRole).isValid());
+        QVERIFY(!model.getData(-1, 3, Qt::DisplayRole).isValid());
+    }
+
+private slots:
+    void rowsThroughEdits() {
+        // Rows are looked up between edits, so the index is kept up
+        // to date rather than rebuilt
+        rnd.seed(3);
+        SparseTimeValueModel model(44100, 10, true);
+        vector<TimeValuePoint> present;
+        for (int step = 0; step < 600; ++step) {
+            if (rnd() % 4 == 0 && !present.empty()) {
+                int n = rnd() % int(present.size());
+                model.deletePoint(present[n]);
+                present.erase(present.begin() + n);
+            } else {
+                TimeValuePoint p(sv_frame_t(rnd() % 50) * 10, 0.f,
+                                 QString::number(step));
+                model.addPoint(p);
+                present.push_back(p);
+            }
+            if (step % 50 == 0) checkRows(model);
+        }
+        checkRows(model);
+        model.clear();
+        QCOMPARE(model.getRowCount(), 0);
+        model.addPoint(TimeValuePoint(100, 1.f, "a"));
+        checkRows(model);
+    }
+
+    void rowForFrameBetweenPoints() {
+        SparseTimeValueModel model(44100, 10, true);
+        model.addPoint(TimeValuePoint(100, 1.f, "a"));
+        model.addPoint(TimeValuePoint(200, 1.f, "b"));
+        model.addPoint(TimeValuePoint(200, 1.f, "c"));
+        model.addPoint(TimeValuePoint(300, 1.f, "d"));
+        QCOMPARE(model.getRowForFrame(0), 0);
+        QCOMPARE(model.getRowForFrame(150), 0);
+        QCOMPARE(model.getRowForFrame(200), 1);
+        QCOMPARE(model.getRowForFrame(250), 2);
+        QCOMPARE(model.getRowForFrame(300), 3);
+        QCOMPARE(model.getRowForFrame(1000), 3);
+    }
+
+    void noteRows() {
+        NoteModel model(44100, 10, true);
+        for (int i = 0; i < 2000; ++i) {
+            model.addPoint(Note((1999 - i) * 10, 60.f, 10, 1.f, ""));
+        }
+        QCOMPARE(model.getRowCount(), 2000);
+        QCOMPARE(model.getFrameForRow(1234), sv_frame_t(12340));
+        model.deletePoint(Note(0, 60.f, 10, 1.f, ""));
+        QCOMPARE(model.getFrameForRow(1234), sv_frame_t(12350));
+        QCOMPARE(model.getRowForFrame(12350), 1234);
+    }
+};
+
+#endif
@@ -0,0 +1,176 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+
+/*
+    Sonic Visualiser
+    An audio file viewer and annotation editor.
+    Centre for Digital Music, Queen Mary, University of London.
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation; either version 2 of the
+    License, or (at your option) any later version.  See the file
+    COPYING included with this distribution for more information.
+*/
+
+#ifndef TEST_SPARSE_MODEL_VISIT_H
+#define TEST_SPARSE_MODEL_VISIT_H
+
+#include "../SparseTimeValueModel.h"
+#include "../NoteModel.h"
+#include "base/test/TestRandom.h"
+
+#include <QObject>
+#include <QtTest>
+
+#include <iostream>
+#include <vector>
+
+using namespace std;
+
+class TestSparseModelVisit : public QObject
+{
+    Q_OBJECT
+
+    template <typename M>
+    static vector<sv_frame_t> framesOf(const typename M::PointList &points) {
+        vector<sv_frame_t> frames;
+        for (const auto &p : points) frames.push_back(p.frame);
+        return frames;
+    }
+
+    template <typename M, typename F>
+    static vector<sv_frame_t> visited(F visit) {
+        vector<sv_frame_t> frames;
+        visit([&frames](const typename M::Point &p) {
+                frames.push_back(p.frame);
+            });
+        return frames;
+    }
+
+    static void fill(SparseTimeValueModel &model) {
+        // Some frames have more than one point
+        for (int i = 0; i < 200; ++i) {
+            sv_frame_t frame = (i / 3) * 100 + (i % 3 == 2 ? 50 : 0);
+            model.addPoint(TimeValuePoint(frame, float(i), ""));
+        }
+    }
+
+private slots:
+    void timeValueWithin() {
+        SparseTimeValueModel model(44100, 10, false);
+        fill(model);
+        for (sv_frame_t start : { -100, 0, 150, 1000, 3250, 7000 }) {
+            sv_frame_t end = start + 400;
+            vector<sv_frame_t> v = visited<SparseTimeValueModel>
+                ([&](const SparseTimeValueModel::PointVisitor &f) {
+                    model.visitPointsWithin(start, end, f);
+                });
+            QCOMPARE(v, framesOf<SparseTimeValueModel>
+                     (model.getPoints(start, end)));
+        }
+        vector<sv_frame_t> all = visited<SparseTimeValueModel>
+            ([&](const SparseTimeValueModel::PointVisitor &f) {
+                model.visitAllPoints(f);
+            });
+        QCOMPARE(all, framesOf<SparseTimeValueModel>(model.getPointsCopy()));
+    }
+
+    void timeValuePreviousNext() {
+        SparseTimeValueModel model(44100, 10, false);
+        fill(model);
+        for (sv_frame_t frame : { 0, 1, 100, 149, 150, 151, 6550, 9999 }) {
+            vector<sv_frame_t> prev = visited<SparseTimeValueModel>
+                ([&](const SparseTimeValueModel::PointVisitor &f) {
+                    model.visitPreviousPoints(frame, f);
+                });
+            QCOMPARE(prev, framesOf<SparseTimeValueModel>
+                     (model.getPreviousPoints(frame)));
+            vector<sv_frame_t> next = visited<SparseTimeValueModel>
+                ([&](const SparseTimeValueModel::PointVisitor &f) {
+                    model.visitNextPoints(frame, f);
+                });
+            QCOMPARE(next, framesOf<SparseTimeValueModel>
+                     (model.getNextPoints(frame)));
+        }
+        // Both points at frame 100 precede 150, in order of addition
+        vector<float> values;
+        model.visitPreviousPoints(150, [&values](const TimeValuePoint &p) {
+                values.push_back(p.value);
+            });
+        QCOMPARE(values, vector<float>({ 3.f, 4.f }));
+    }
+
+    void intervalWithin() {
+        NoteModel model(44100, 10, false);
+        model.addPoint(Note(0, 60.f, 10000, 1.f, "long"));
+        for (int i = 0; i < 50; ++i) {
+            model.addPoint(Note(i * 100, 60.f, 50, 1.f, ""));
+        }
+        vector<sv_frame_t> v = visited<NoteModel>
+            ([&](const NoteModel::PointVisitor &f) {
+                model.visitPointsWithin(2020, 2300, f);
+            });
+        // The long note, then those starting from 2000 (which reaches
+        // 2020) to 2300 inclusive
+        QCOMPARE(v, vector<sv_frame_t>({ 0, 2000, 2100, 2200, 2300 }));
+        QCOMPARE(v, framesOf<NoteModel>(model.getPoints(2020, 2300)));
+
+        vector<sv_frame_t> at = visited<NoteModel>
+            ([&](const NoteModel::PointVisitor &f) {
+                model.visitPointsAt(3025, f);
+            });
+        QCOMPARE(at, framesOf<NoteModel>(model.getPoints(3025)));
+        QCOMPARE(at, vector<sv_frame_t>({ 0, 3000 }));
+    }
+
+    void intervalIndexThroughEdits() {
+        // Compare against a plain scan, while adding and deleting
+        // notes of which a few are long
+        NoteModel model(44100, 10, false);
+        vector<Note> present;
+        TestRandom rnd(17);
+        for (int step = 0; step < 3000; ++step) {
+            if (rnd() % 4 == 0 && !present.empty()) {
+                int n = rnd() % int(present.size());
+                model.deletePoint(present[n]);
+                present.erase(present.begin() + n);
+            } else {
+                sv_frame_t duration = (rnd() % 20 == 0) ?
+                    rnd() % 20000 : rnd() % 500;
+                Note note(rnd() % 100000, float(rnd() % 100), duration,
+                          1.f, QString::number(step));
+                model.addPoint(note);
+                present.push_back(note);
+            }
+            if (step % 10 != 0) continue;
+            sv_frame_t start = rnd() % 100000, end = start + rnd() % 2000;
+            vector<sv_frame_t> expected;
+            for (const auto &p : model.getPointsCopy()) {
+                if (p.frame <= end && p.frame + p.duration >= start) {
+                    expected.push_back(p.frame);
+                }
+            }
+            QCOMPARE(framesOf<NoteModel>(model.getPoints(start, end)),
+                     expected);
+        }
+        model.clear();
+        model.addPoint(Note(100, 60.f, 1000, 1.f, ""));
+        QCOMPARE(framesOf<NoteModel>(model.getPoints(500, 600)),
+                 vector<sv_frame_t>({ 100 }));
+    }
+
+    void delimited() {
+        SparseTimeValueModel model(44100, 100, false);
+        model.addPoint(TimeValuePoint(0, 1.f, ""));
+        model.addPoint(TimeValuePoint(200, 2.f, ""));
+        model.addPoint(TimeValuePoint(500, 3.f, ""));
+        QString s = model.toDelimitedDataStringSubset(",", 100, 600);
+        QCOMPARE(s.count("\n"), 2);
+        QString filled = model.toDelimitedDataStringSubsetWithOptions
+            (",", DataExportFillGaps, 0, 600);
+        // one line for each resolution step from 0 to 500
+        QCOMPARE(filled.count("\n"), 6);
+    }
+};
+
+#endif
@@ -0,0 +1,72 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+
+/*
+    Sonic Visualiser
+    An audio file viewer and annotation editor.
+    Centre for Digital Music, Queen Mary, University of London.
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation; either version 2 of the
+    License, or (at your option) any later version.  See the file
+    COPYING included with this distribution for more information.
+*/
+
+#ifndef TEST_SPARSE_TIME_VALUE_SUMMARIES_H
+#define TEST_SPARSE_TIME_VALUE_SUMMARIES_H
+
+#include "../SparseTimeValueModel.h"
+
+#include <QObject>
+#include <QtTest>
+
+#include <iostream>
+#include <vector>
+
+using namespace std;
+
+class TestSparseTimeValueSummaries : public QObject
+{
+    Q_OBJECT
+
+    typedef SparseTimeValueModel::Summary Summary;
+
+    static float value(int i) {
+        return float((i * 37) % 101) - 50.f;
+    }
+
+    static void compare(const vector<Summary> &a, const vector<Summary> &b) {
+        QCOMPARE(a.size(), b.size());
+        for (size_t i = 0; i < a.size(); ++i) {
+            QCOMPARE(a[i].frame, b[i].frame);
+            QCOMPARE(a[i].count, b[i].count);
+            QCOMPARE(a[i].min, b[i].min);
+            QCOMPARE(a[i].max, b[i].max);
+            QCOMPARE(a[i].sum, b[i].sum);
+        }
+    }
+
+private slots:
+    void evicted() {
+        SparseTimeValueModel model(44100, 10, false);
+        for (int i = 0; i < 2000; ++i) {
+            model.addPoint(TimeValuePoint(i * 10, value(i), ""));
+        }
+        vector<Summary> before = model.getSummaries(0, 20000, 640);
+        QVERIFY(!before.empty());
+
+        size_t size = model.getEvictableSize();
+        QVERIFY(size > 0);
+        QCOMPARE(model.evict(size), size);
+        QVERIFY(model.getEvictableSize() < size);
+
+        // Points changed while the summaries are gone are included
+        // when they are rebuilt
+        model.deletePoint(TimeValuePoint(0, value(0), ""));
+        model.addPoint(TimeValuePoint(0, value(0), ""));
+
+        compare(model.getSummaries(0, 20000, 640), before);
+    }
+};
+
+#endif
@@ -1,7 +1,24 @@
 TEST_HEADERS += \
 	Compares.h \
 	MockWaveModel.h \
-	TestFFTModel.h
+	SparsePoints.h \
+	TestDenseColumnStore.h \
+	TestDenseCompression.h \
+	TestDenseAppend.h \
+	TestDense3DModelPeakCache.h \
+	TestDenseXml.h \
+	TestSparseModelVisit.h \
+	TestSparseModelRows.h \
+	TestSparseModelAddPoints.h \
+	TestSparseModelBatchEdit.h \
+	TestSparseModelConcurrency.h \
+	TestSparseModelDelimited.h \
+	TestAlignmentModel.h \
+	TestModelChangeCoalescer.h \
+	TestModelMemoryReport.h \
+	TestSparseTimeValueSummaries.h \
+	TestFFTModel.h \
+	TestLogMagnitudeFFTModel.h
 	
 TEST_SOURCES += \
 	MockWaveModel.cpp \
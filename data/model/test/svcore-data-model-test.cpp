@@ -12,6 +12,22 @@
 */
 
 #include "TestFFTModel.h"
+#include "TestLogMagnitudeFFTModel.h"
+#include "TestDenseColumnStore.h"
+#include "TestDenseCompression.h"
+#include "TestDenseAppend.h"
+#include "TestDense3DModelPeakCache.h"
+#include "TestDenseXml.h"
+#include "TestSparseModelVisit.h"
+#include "TestSparseModelRows.h"
+#include "TestSparseModelAddPoints.h"
+#include "TestSparseModelBatchEdit.h"
+#include "TestSparseModelConcurrency.h"
+#include "TestSparseModelDelimited.h"
+#include "TestAlignmentModel.h"
+#include "TestModelChangeCoalescer.h"
+#include "TestModelMemoryReport.h"
+#include "TestSparseTimeValueSummaries.h"
 
 #include <QtTest>
 
@@ -32,6 +48,86 @@ int main(int argc, char *argv[])
 	if (QTest::qExec(&t, argc, argv) == 0) ++good;
 	else ++bad;
     }
+    {
+	TestLogMagnitudeFFTModel t;
+	if (QTest::qExec(&t, argc, argv) == 0) ++good;
+	else ++bad;
+    }
+    {
+	TestDenseColumnStore t;
+	if (QTest::qExec(&t, argc, argv) == 0) ++good;
+	else ++bad;
+    }
+    {
+	TestDenseCompression t;
+	if (QTest::qExec(&t, argc, argv) == 0) ++good;
+	else ++bad;
+    }
+    {
+	TestDenseAppend t;
+	if (QTest::qExec(&t, argc, argv) == 0) ++good;
+	else ++bad;
+    }
+    {
+	TestDense3DModelPeakCache t;
+	if (QTest::qExec(&t, argc, argv) == 0) ++good;
+	else ++bad;
+    }
+    {
+	TestDenseXml t;
+	if (QTest::qExec(&t, argc, argv) == 0) ++good;
+	else ++bad;
+    }
+    {
+	TestSparseModelVisit t;
+	if (QTest::qExec(&t, argc, argv) == 0) ++good;
+	else ++bad;
+    }
+    {
+	TestSparseModelRows t;
+	if (QTest::qExec(&t, argc, argv) == 0) ++good;
+	else ++bad;
+    }
+    {
+	TestSparseModelAddPoints t;
+	if (QTest::qExec(&t, argc, argv) == 0) ++good;
+	else ++bad;
+    }
+    {
+	TestSparseModelBatchEdit t;
+	if (QTest::qExec(&t, argc, argv) == 0) ++good;
+	else ++bad;
+    }
+    {
+	TestSparseModelConcurrency t;
+	if (QTest::qExec(&t, argc, argv) == 0) ++good;
+	else ++bad;
+    }
+    {
+	TestSparseModelDelimited t;
+	if (QTest::qExec(&t, argc, argv) == 0) ++good;
+	else ++bad;
+    }
+    {
+	TestAlignmentModel t;
+	if (QTest::qExec(&t, argc, argv) == 0) ++good;
+	else ++bad;
+    }
+    {
+	TestModelChangeCoalescer t;
+	if (QTest::qExec(&t, argc, argv) == 0) ++good;
+	else ++bad;
+    }
+    {
+	TestModelMemoryReport t;
+	if (QTest::qExec(&t, argc, argv) == 0) ++good;
+	else ++bad;
+    }
+    {
+	TestSparseTimeValueSummaries t;
+	if (QTest::qExec(&t, argc, argv) == 0) ++good;
+	else ++bad;
+    }
 
     if (bad > 0) {
 	cerr << "\n********* " << bad << " test suite(s) failed!\n" << endl;
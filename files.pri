@@ -3,6 +3,8 @@ SVCORE_HEADERS = \
            base/AudioPlaySource.h \
            base/AudioRecordTarget.h \
            base/BaseTypes.h \
+           base/CacheBudget.h \
+           base/ChunkedMultiset.h \
            base/Clipboard.h \
            base/ColumnOp.h \
            base/Command.h \
@@ -10,6 +12,7 @@ SVCORE_HEADERS = \
            base/Exceptions.h \
            base/HelperExecPath.h \
            base/HitCount.h \
+           base/IntervalTree.h \
            base/LogRange.h \
            base/MagnitudeRange.h \
            base/Pitch.h \
@@ -28,11 +31,14 @@ SVCORE_HEADERS = \
            base/RingBuffer.h \
            base/ScaleTickIntervals.h \
            base/Scavenger.h \
+           base/SegmentedArray.h \
            base/Selection.h \
            base/Serialiser.h \
+           base/SlidingPercentile.h \
            base/StorageAdviser.h \
            base/StringBits.h \
            base/Strings.h \
+           base/SummaryPyramid.h \
            base/TempDirectory.h \
            base/TempWriteFile.h \
            base/TextMatcher.h \
@@ -71,15 +77,22 @@ SVCORE_HEADERS = \
            data/model/AggregateWaveModel.h \
            data/model/AlignmentModel.h \
            data/model/Dense3DModelPeakCache.h \
+           data/model/DenseColumnStore.h \
            data/model/DenseThreeDimensionalModel.h \
            data/model/DenseTimeValueModel.h \
            data/model/EditableDenseThreeDimensionalModel.h \
+           data/model/EncodedColumnStore.h \
            data/model/FFTModel.h \
            data/model/ImageModel.h \
            data/model/IntervalModel.h \
+           data/model/LogMagnitudeFFTModel.h \
            data/model/Labeller.h \
+           data/model/MappedChunkFile.h \
            data/model/Model.h \
+           data/model/ModelChangeCoalescer.h \
            data/model/ModelDataTableModel.h \
+           data/model/ModelMemoryReport.h \
+           data/model/MultiChannelFFT.h \
            data/model/NoteModel.h \
            data/model/FlexiNoteModel.h \
            data/model/PathModel.h \
@@ -140,6 +153,7 @@ SVCORE_HEADERS = \
 	   
 SVCORE_SOURCES = \
            base/AudioLevel.cpp \
+           base/CacheBudget.cpp \
            base/Clipboard.cpp \
            base/ColumnOp.cpp \
            base/Command.cpp \
@@ -197,11 +211,18 @@ SVCORE_SOURCES = \
            data/model/AggregateWaveModel.cpp \
            data/model/AlignmentModel.cpp \
            data/model/Dense3DModelPeakCache.cpp \
+           data/model/DenseColumnStore.cpp \
            data/model/DenseTimeValueModel.cpp \
            data/model/EditableDenseThreeDimensionalModel.cpp \
+           data/model/EncodedColumnStore.cpp \
            data/model/FFTModel.cpp \
+           data/model/LogMagnitudeFFTModel.cpp \
+           data/model/MappedChunkFile.cpp \
            data/model/Model.cpp \
+           data/model/ModelChangeCoalescer.cpp \
            data/model/ModelDataTableModel.cpp \
+           data/model/ModelMemoryReport.cpp \
+           data/model/MultiChannelFFT.cpp \
            data/model/PowerOfSqrtTwoZoomConstraint.cpp \
            data/model/PowerOfTwoZoomConstraint.cpp \
            data/model/RangeSummarisableTimeValueModel.cpp \
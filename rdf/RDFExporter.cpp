@@ -85,16 +85,14 @@ RDFExporter::write()
         if (m) {
             f.hasTimestamp = true;
             f.hasDuration = true;
-            const RegionModel::PointList &pl(m->getPoints());
-            for (RegionModel::PointList::const_iterator i = pl.begin(); 
-                 i != pl.end(); ++i) {
-                f.timestamp = RealTime::frame2RealTime(i->frame, sr).toVampRealTime();
-                f.duration = RealTime::frame2RealTime(i->duration, sr).toVampRealTime();
-                f.values.clear();
-                f.values.push_back(i->value);
-                f.label = i->label.toStdString();
-                m_fw->write(trackId, transform, output, features, summaryType);
-            }
+            m->visitAllPoints([&](const RegionModel::Point &p) {
+                    f.timestamp = RealTime::frame2RealTime(p.frame, sr).toVampRealTime();
+                    f.duration = RealTime::frame2RealTime(p.duration, sr).toVampRealTime();
+                    f.values.clear();
+                    f.values.push_back(p.value);
+                    f.label = p.label.toStdString();
+                    m_fw->write(trackId, transform, output, features, summaryType);
+                });
             return;
         }
     }
@@ -103,17 +101,15 @@ RDFExporter::write()
         if (m) {
             f.hasTimestamp = true;
             f.hasDuration = true;
-            const NoteModel::PointList &pl(m->getPoints());
-            for (NoteModel::PointList::const_iterator i = pl.begin(); 
-                 i != pl.end(); ++i) {
-                f.timestamp = RealTime::frame2RealTime(i->frame, sr).toVampRealTime();
-                f.duration = RealTime::frame2RealTime(i->duration, sr).toVampRealTime();
-                f.values.clear();
-                f.values.push_back(i->value);
-                f.values.push_back(i->level);
-                f.label = i->label.toStdString();
-                m_fw->write(trackId, transform, output, features, summaryType);
-            }
+            m->visitAllPoints([&](const NoteModel::Point &p) {
+                    f.timestamp = RealTime::frame2RealTime(p.frame, sr).toVampRealTime();
+                    f.duration = RealTime::frame2RealTime(p.duration, sr).toVampRealTime();
+                    f.values.clear();
+                    f.values.push_back(p.value);
+                    f.values.push_back(p.level);
+                    f.label = p.label.toStdString();
+                    m_fw->write(trackId, transform, output, features, summaryType);
+                });
             return;
         }
     }
@@ -122,14 +118,12 @@ RDFExporter::write()
         if (m) {
             f.hasTimestamp = true;
             f.hasDuration = false;
-            const SparseOneDimensionalModel::PointList &pl(m->getPoints());
-            for (SparseOneDimensionalModel::PointList::const_iterator i = pl.begin(); 
-                 i != pl.end(); ++i) {
-                f.timestamp = RealTime::frame2RealTime(i->frame, sr).toVampRealTime();
-                f.values.clear();
-                f.label = i->label.toStdString();
-                m_fw->write(trackId, transform, output, features, summaryType);
-            }
+            m->visitAllPoints([&](const SparseOneDimensionalModel::Point &p) {
+                    f.timestamp = RealTime::frame2RealTime(p.frame, sr).toVampRealTime();
+                    f.values.clear();
+                    f.label = p.label.toStdString();
+                    m_fw->write(trackId, transform, output, features, summaryType);
+                });
             return;
         }
     }
@@ -138,15 +132,13 @@ RDFExporter::write()
         if (m) {
             f.hasTimestamp = true;
             f.hasDuration = false;
-            const SparseTimeValueModel::PointList &pl(m->getPoints());
-            for (SparseTimeValueModel::PointList::const_iterator i = pl.begin(); 
-                 i != pl.end(); ++i) {
-                f.timestamp = RealTime::frame2RealTime(i->frame, sr).toVampRealTime();
-                f.values.clear();
-                f.values.push_back(i->value);
-                f.label = i->label.toStdString();
-                m_fw->write(trackId, transform, output, features, summaryType);
-            }
+            m->visitAllPoints([&](const SparseTimeValueModel::Point &p) {
+                    f.timestamp = RealTime::frame2RealTime(p.frame, sr).toVampRealTime();
+                    f.values.clear();
+                    f.values.push_back(p.value);
+                    f.label = p.label.toStdString();
+                    m_fw->write(trackId, transform, output, features, summaryType);
+                });
             return;
         }
     }
@@ -155,16 +147,14 @@ RDFExporter::write()
         if (m) {
             f.hasTimestamp = true;
             f.hasDuration = false;
-            const TextModel::PointList &pl(m->getPoints());
             m_fw->setFixedEventTypeURI("af:Text");
-            for (TextModel::PointList::const_iterator i = pl.begin(); 
-                 i != pl.end(); ++i) {
-                f.timestamp = RealTime::frame2RealTime(i->frame, sr).toVampRealTime();
-                f.values.clear();
-                f.values.push_back(i->height);
-                f.label = i->label.toStdString();
-                m_fw->write(trackId, transform, output, features, summaryType);
-            }
+            m->visitAllPoints([&](const TextModel::Point &p) {
+                    f.timestamp = RealTime::frame2RealTime(p.frame, sr).toVampRealTime();
+                    f.values.clear();
+                    f.values.push_back(p.height);
+                    f.label = p.label.toStdString();
+                    m_fw->write(trackId, transform, output, features, summaryType);
+                });
             return;
         }
     }
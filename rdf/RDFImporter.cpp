@@ -122,7 +122,9 @@ RDFImporter::getErrorString() const
 std::vector<Model *>
 RDFImporter::getDataModels(ProgressReporter *r)
 {
-    return m_d->getDataModels(r);
+    std::vector<Model *> models = m_d->getDataModels(r);
+    for (Model *m : models) Model::registerModel(m);
+    return models;
 }
 
 RDFImporterImpl::RDFImporterImpl(QString uri, sv_samplerate_t sampleRate) :
@@ -345,11 +347,13 @@ RDFImporterImpl::getDataModelsDense(std::vector<Model *> &models,
             SparseTimeValueModel *m = new SparseTimeValueModel
                 (sampleRate, hopSize, false);
 
+            std::vector<SparseTimeValueModel::Point> points;
+            points.reserve(values.size());
             for (int j = 0; j < values.size(); ++j) {
                 float f = values[j].toFloat();
-                SparseTimeValueModel::Point point(j * hopSize, f, "");
-                m->addPoint(point);
+                points.push_back(SparseTimeValueModel::Point(j * hopSize, f, ""));
             }
+            m->addPoints(points);
 
             getDenseModelTitle(m, feature, type);
         
@@ -30,6 +30,7 @@
 #ifdef __APPLE__
 #include <sys/param.h>
 #include <sys/sysctl.h>
+#include <mach/mach.h>
 #endif
 
 #include <limits.h>
@@ -120,6 +121,23 @@ typedef struct
     DWORDLONG ullAvailExtendedVirtual;
 } lMEMORYSTATUSEX;
 typedef BOOL (WINAPI *PFN_MS_EX) (lMEMORYSTATUSEX*);
+
+/*  Likewise PROCESS_MEMORY_COUNTERS, from psapi.h, which we look up
+    at run time rather than linking against */
+typedef struct
+{
+    DWORD cb;
+    DWORD PageFaultCount;
+    SIZE_T PeakWorkingSetSize;
+    SIZE_T WorkingSetSize;
+    SIZE_T QuotaPeakPagedPoolUsage;
+    SIZE_T QuotaPagedPoolUsage;
+    SIZE_T QuotaPeakNonPagedPoolUsage;
+    SIZE_T QuotaNonPagedPoolUsage;
+    SIZE_T PagefileUsage;
+    SIZE_T PeakPagefileUsage;
+} lPROCESS_MEMORY_COUNTERS;
+typedef BOOL (WINAPI *PFN_PMI) (HANDLE, lPROCESS_MEMORY_COUNTERS*, DWORD);
 #endif
 
 void
@@ -246,6 +264,62 @@ GetRealMemoryMBAvailable(ssize_t &available, ssize_t &total)
 #endif
 }
 
+ssize_t
+GetProcessMemoryMBUsed()
+{
+#ifdef _WIN32
+
+    static bool checked = false;
+    static PFN_PMI pmi = 0;
+
+    if (!checked) {
+        HMODULE h = GetModuleHandleA("kernel32.dll");
+        if (h) {
+            pmi = (PFN_PMI)GetProcAddress(h, "K32GetProcessMemoryInfo");
+        }
+        if (!pmi) {
+            h = LoadLibraryA("psapi.dll");
+            if (h) pmi = (PFN_PMI)GetProcAddress(h, "GetProcessMemoryInfo");
+        }
+        checked = true;
+    }
+
+    if (!pmi) return -1;
+
+    lPROCESS_MEMORY_COUNTERS pmc;
+    pmc.cb = sizeof(pmc);
+    if (!pmi(GetCurrentProcess(), &pmc, sizeof(pmc))) return -1;
+    return ssize_t(pmc.WorkingSetSize / 1048576);
+
+#else
+#ifdef __APPLE__
+
+    mach_task_basic_info_data_t info;
+    mach_msg_type_number_t count = MACH_TASK_BASIC_INFO_COUNT;
+    if (task_info(mach_task_self(), MACH_TASK_BASIC_INFO,
+                  (task_info_t)&info, &count) != KERN_SUCCESS) {
+        return -1;
+    }
+    return ssize_t(info.resident_size / 1048576);
+
+#else
+
+    FILE *statm = fopen("/proc/self/statm", "r");
+    if (!statm) return -1;
+
+    long size = 0, resident = 0;
+    int n = fscanf(statm, "%ld %ld", &size, &resident);
+    fclose(statm);
+    if (n != 2) return -1;
+
+    long pageSize = sysconf(_SC_PAGESIZE);
+    if (pageSize <= 0) return -1;
+    return ssize_t((uint64_t(resident) * uint64_t(pageSize)) / 1048576);
+
+#endif
+#endif
+}
+
 ssize_t
 GetDiscSpaceMBAvailable(const char *path)
 {
@@ -158,6 +158,10 @@ extern ProcessStatus GetProcessStatus(int pid);
 // is actually addressable, e.g. for a 32-bit process on a 64-bit system.
 extern void GetRealMemoryMBAvailable(ssize_t &available, ssize_t &total);
 
+// Return the number of megabytes of real memory in use by this process
+// (its resident set size). Return -1 if unknown.
+extern ssize_t GetProcessMemoryMBUsed();
+
 // Return a vague approximation to the number of free megabytes of
 // disc space on the partition containing the given path.  Return -1
 // if unknown. (Hence signed return type)
@@ -30,13 +30,14 @@
 #include "data/model/NoteModel.h"
 #include "data/model/FlexiNoteModel.h"
 #include "data/model/RegionModel.h"
-#include "data/model/FFTModel.h"
+#include "data/model/MultiChannelFFT.h"
 #include "data/model/WaveFileModel.h"
 #include "rdf/PluginRDFDescription.h"
 
 #include "TransformFactory.h"
 
 #include <iostream>
+#include <cmath>
 
 #include <QSettings>
 
@@ -70,6 +71,34 @@ areTransformsSimilar(const Transform &t1, const Transform &t2)
     return t1 == t2o;
 }
 
+static EditableDenseThreeDimensionalModel::CompressionType
+getDenseCompressionType(const Vamp::Plugin::OutputDescriptor &d)
+{
+    // Dense outputs are stored losslessly, with columns coded against
+    // their neighbours. Half precision is lossy -- it keeps about
+    // three significant figures and loses small values entirely -- so
+    // it is only used if asked for, and then only for outputs with
+    // many bins and declared extents within the range of a
+    // half-precision float, which are typically spectral or similar
+    // grids produced mostly for display. Quantized outputs, whose
+    // values must be reproduced exactly, are never stored that way
+
+    QSettings settings;
+    settings.beginGroup("Transformer");
+    bool half = settings.value("use-half-precision-dense-outputs",
+                               false).toBool();
+    settings.endGroup();
+
+    if (half && !d.isQuantized &&
+        d.hasFixedBinCount && d.binCount >= 64 &&
+        d.hasKnownExtents &&
+        fabsf(d.minValue) <= 65504.f && fabsf(d.maxValue) <= 65504.f) {
+        return EditableDenseThreeDimensionalModel::HalfPrecisionCompression;
+    }
+
+    return EditableDenseThreeDimensionalModel::DeltaBlockCompression;
+}
+
 bool
 FeatureExtractionModelTransformer::initialise()
 {
@@ -513,9 +542,13 @@ FeatureExtractionModelTransformer::createOutputModels(int n)
         EditableDenseThreeDimensionalModel *model =
             new EditableDenseThreeDimensionalModel
             (modelRate, modelResolution, binCount,
-             EditableDenseThreeDimensionalModel::BasicMultirateCompression,
+             getDenseCompressionType(*m_descriptors[n]),
              false);
 
+        // We are the only writer, and write in order, until run()
+        // ends (see endAppendOnly)
+        model->setAppendOnly(true);
+
 	if (!m_descriptors[n]->binNames.empty()) {
 	    std::vector<QString> names;
 	    for (int i = 0; i < (int)m_descriptors[n]->binNames.size(); ++i) {
@@ -551,6 +584,11 @@ FeatureExtractionModelTransformer::~FeatureExtractionModelTransformer()
     // Parent class dtor set the abandoned flag and waited for the run
     // thread to exit; the run thread owns the plugin, and should have
     // destroyed it before exiting (via a call to deinitialise)
+
+    for (PendingPointMap::iterator i = m_pendingPoints.begin();
+         i != m_pendingPoints.end(); ++i) {
+        delete i->second;
+    }
 }
 
 FeatureExtractionModelTransformer::Models
@@ -630,6 +668,32 @@ FeatureExtractionModelTransformer::getConformingInput()
 
 void
 FeatureExtractionModelTransformer::run()
+{
+    try {
+        extract();
+    } catch (...) {
+        endAppendOnly();
+        throw;
+    }
+    endAppendOnly();
+}
+
+void
+FeatureExtractionModelTransformer::endAppendOnly()
+{
+    // Dense outputs are written in append-only mode while we run
+    // (see createOutputModels). Leave it once we're done, however we
+    // got here, so that their readers go back to taking the lock and
+    // any chunks paged out meanwhile are released
+    for (int j = 0; j < (int)m_outputs.size(); ++j) {
+        EditableDenseThreeDimensionalModel *model =
+            dynamic_cast<EditableDenseThreeDimensionalModel *>(m_outputs[j]);
+        if (model) model->setAppendOnly(false);
+    }
+}
+
+void
+FeatureExtractionModelTransformer::extract()
 {
     try {
         if (!initialise()) {
@@ -678,28 +742,26 @@ FeatureExtractionModelTransformer::run()
 
     bool frequencyDomain = (m_plugin->getInputDomain() ==
                             Vamp::Plugin::FrequencyDomain);
-    std::vector<FFTModel *> fftModels;
+
+    // A single multi-channel FFT reads each block of input once for
+    // all channels and writes straight into the plugin input buffers
+    MultiChannelFFT *fft = 0;
 
     if (frequencyDomain) {
-        for (int ch = 0; ch < channelCount; ++ch) {
-            FFTModel *model = new FFTModel
-                                  (getConformingInput(),
-                                   channelCount == 1 ? m_input.getChannel() : ch,
-                                   primaryTransform.getWindowType(),
-                                   blockSize,
-                                   stepSize,
-                                   blockSize);
-            if (!model->isOK() || model->getError() != "") {
-                QString err = model->getError();
-                delete model;
-                for (int j = 0; j < (int)m_outputNos.size(); ++j) {
-                    setCompletion(j, 100);
-                }
-                //!!! need a better way to handle this -- previously we were using a QMessageBox but that isn't an appropriate thing to do here either
-                throw AllocationFailed("Failed to create the FFT model for this feature extraction model transformer: error is: " + err);
+        try {
+            fft = new MultiChannelFFT(getConformingInput(),
+                                      m_input.getChannel(),
+                                      channelCount,
+                                      primaryTransform.getWindowType(),
+                                      blockSize,
+                                      stepSize,
+                                      blockSize);
+        } catch (const std::exception &e) {
+            for (int j = 0; j < (int)m_outputNos.size(); ++j) {
+                setCompletion(j, 100);
             }
-            fftModels.push_back(model);
-            cerr << "created model for channel " << ch << endl;
+            //!!! need a better way to handle this -- previously we were using a QMessageBox but that isn't an appropriate thing to do here either
+            throw AllocationFailed(QString("Failed to create the FFT for this feature extraction model transformer: error is: %1").arg(e.what()));
         }
     }
 
@@ -734,15 +796,6 @@ FeatureExtractionModelTransformer::run()
         setCompletion(j, 0);
     }
 
-    float *reals = 0;
-    float *imaginaries = 0;
-    if (frequencyDomain) {
-        reals = new float[blockSize/2 + 1];
-        imaginaries = new float[blockSize/2 + 1];
-    }
-
-    QString error = "";
-
     try {
         while (!m_abandoned) {
 
@@ -765,26 +818,12 @@ FeatureExtractionModelTransformer::run()
             // channelCount is either m_input.getModel()->channelCount or 1
 
             if (frequencyDomain) {
-                for (int ch = 0; ch < channelCount; ++ch) {
-                    int column = int((blockFrame - startFrame) / stepSize);
-                    if (fftModels[ch]->getValuesAt(column, reals, imaginaries)) {
-                        for (int i = 0; i <= blockSize/2; ++i) {
-                            buffers[ch][i*2] = reals[i];
-                            buffers[ch][i*2+1] = imaginaries[i];
-                        }
-                    } else {
-                        for (int i = 0; i <= blockSize/2; ++i) {
-                            buffers[ch][i*2] = 0.f;
-                            buffers[ch][i*2+1] = 0.f;
-                        }
-                    }                    
-                    error = fftModels[ch]->getError();
-                    if (error != "") {
-                        SVCERR << "FeatureExtractionModelTransformer::run: Abandoning, error is " << error << endl;
-                        m_abandoned = true;
-                        m_message = error;
-                        break;
-                    }
+                int column = int((blockFrame - startFrame) / stepSize);
+                if (!fft->getInterleavedColumn(column, buffers)) {
+                    m_message = tr("Input model for feature extraction plugin is no longer available");
+                    SVCERR << "FeatureExtractionModelTransformer::run: Abandoning, error is " << m_message << endl;
+                    m_abandoned = true;
+                    break;
                 }
             } else {
                 getFrames(channelCount, blockFrame, blockSize, buffers);
@@ -836,13 +875,7 @@ FeatureExtractionModelTransformer::run()
         setCompletion(j, 100);
     }
 
-    if (frequencyDomain) {
-        for (int ch = 0; ch < channelCount; ++ch) {
-            delete fftModels[ch];
-        }
-        delete[] reals;
-        delete[] imaginaries;
-    }
+    delete fft;
 
     for (int ch = 0; ch < channelCount; ++ch) {
         delete[] buffers[ch];
@@ -911,6 +944,56 @@ FeatureExtractionModelTransformer::getFrames(int channelCount,
     }
 }
 
+template <typename ModelClass>
+class FeatureExtractionModelTransformer::PendingPointsFor :
+    public FeatureExtractionModelTransformer::PendingPoints
+{
+public:
+    PendingPointsFor(ModelClass *model) : m_model(model) { }
+
+    void add(const typename ModelClass::Point &point) {
+        m_points.push_back(point);
+    }
+
+    virtual void flush() {
+        if (m_points.empty()) return;
+        m_model->addPoints(m_points);
+        m_points.clear();
+    }
+
+private:
+    ModelClass *m_model;
+    std::vector<typename ModelClass::Point> m_points;
+};
+
+template <typename ModelClass>
+void
+FeatureExtractionModelTransformer::addPointLater(ModelClass *model,
+                                                 const typename ModelClass::Point &point)
+{
+    PendingPointsFor<ModelClass> *pending = 0;
+
+    PendingPointMap::iterator i = m_pendingPoints.find(model);
+    if (i == m_pendingPoints.end()) {
+        pending = new PendingPointsFor<ModelClass>(model);
+        m_pendingPoints[model] = pending;
+    } else {
+        // each model only ever has pending points of its own class
+        pending = static_cast<PendingPointsFor<ModelClass> *>(i->second);
+    }
+
+    pending->add(point);
+}
+
+void
+FeatureExtractionModelTransformer::flushPendingPoints()
+{
+    for (PendingPointMap::iterator i = m_pendingPoints.begin();
+         i != m_pendingPoints.end(); ++i) {
+        i->second->flush();
+    }
+}
+
 void
 FeatureExtractionModelTransformer::addFeature(int n,
                                               sv_frame_t blockFrame,
@@ -986,8 +1069,8 @@ FeatureExtractionModelTransformer::addFeature(int n,
             getConformingOutput<SparseOneDimensionalModel>(n);
 	if (!model) return;
 
-        model->addPoint(SparseOneDimensionalModel::Point
-                       (frame, feature.label.c_str()));
+        addPointLater(model, SparseOneDimensionalModel::Point
+                      (frame, feature.label.c_str()));
 	
     } else if (isOutput<SparseTimeValueModel>(n)) {
 
@@ -1013,8 +1096,8 @@ FeatureExtractionModelTransformer::addFeature(int n,
 //                          << " for output " << n << " bin " << i << std::endl;
             }
 
-            targetModel->addPoint
-                (SparseTimeValueModel::Point(frame, value, label));
+            addPointLater(targetModel,
+                          SparseTimeValueModel::Point(frame, value, label));
         }
 
     } else if (isOutput<FlexiNoteModel>(n) || isOutput<NoteModel>(n) || isOutput<RegionModel>(n)) { //GF: Added Note Model
@@ -1046,11 +1129,11 @@ FeatureExtractionModelTransformer::addFeature(int n,
 
             FlexiNoteModel *model = getConformingOutput<FlexiNoteModel>(n);
             if (!model) return;
-            model->addPoint(FlexiNoteModel::Point(frame,
-                                                  value, // value is pitch
-                                                  duration,
-                                                  velocity / 127.f,
-                                                  feature.label.c_str()));
+            addPointLater(model, FlexiNoteModel::Point(frame,
+                                                       value, // value is pitch
+                                                       duration,
+                                                       velocity / 127.f,
+                                                       feature.label.c_str()));
 			// GF: end -- added for flexi note model
         } else  if (isOutput<NoteModel>(n)) {
 
@@ -1063,10 +1146,10 @@ FeatureExtractionModelTransformer::addFeature(int n,
 
             NoteModel *model = getConformingOutput<NoteModel>(n);
             if (!model) return;
-            model->addPoint(NoteModel::Point(frame, value, // value is pitch
-                                             duration,
-                                             velocity / 127.f,
-                                             feature.label.c_str()));
+            addPointLater(model, NoteModel::Point(frame, value, // value is pitch
+                                                  duration,
+                                                  velocity / 127.f,
+                                                  feature.label.c_str()));
         } else {
 
             RegionModel *model = getConformingOutput<RegionModel>(n);
@@ -1083,17 +1166,17 @@ FeatureExtractionModelTransformer::addFeature(int n,
                         label = QString("[%1] %2").arg(i+1).arg(label);
                     }
 
-                    model->addPoint(RegionModel::Point(frame,
-                                                       value,
-                                                       duration,
-                                                       label));
+                    addPointLater(model, RegionModel::Point(frame,
+                                                            value,
+                                                            duration,
+                                                            label));
                 }
             } else {
             
-                model->addPoint(RegionModel::Point(frame,
-                                                   value,
-                                                   duration,
-                                                   feature.label.c_str()));
+                addPointLater(model, RegionModel::Point(frame,
+                                                        value,
+                                                        duration,
+                                                        feature.label.c_str()));
             }
         }
 	
@@ -1125,6 +1208,9 @@ FeatureExtractionModelTransformer::setCompletion(int n, int completion)
 //    SVDEBUG << "FeatureExtractionModelTransformer::setCompletion("
 //              << completion << ")" << endl;
 
+    // Add points before announcing them
+    flushPendingPoints();
+
     if (isOutput<SparseOneDimensionalModel>(n)) {
 
 	SparseOneDimensionalModel *model =
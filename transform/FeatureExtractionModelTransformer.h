@@ -55,6 +55,8 @@ protected:
     void deinitialise();
 
     virtual void run();
+    void extract(); // the body of run()
+    void endAppendOnly();
 
     Vamp::Plugin *m_plugin;
     std::vector<Vamp::Plugin::OutputDescriptor *> m_descriptors; // per transform
@@ -74,6 +76,24 @@ protected:
 
     void setCompletion(int, int);
 
+    // Points for sparse output models are collected here as features
+    // arrive, and added to their models in one batch per model each
+    // time completion is reported, so that each model is locked and
+    // notified once per batch rather than once per feature
+    class PendingPoints {
+    public:
+        virtual ~PendingPoints() { }
+        virtual void flush() = 0;
+    };
+    template <typename ModelClass> class PendingPointsFor;
+    typedef std::map<Model *, PendingPoints *> PendingPointMap;
+    PendingPointMap m_pendingPoints;
+
+    template <typename ModelClass>
+    void addPointLater(ModelClass *model,
+                       const typename ModelClass::Point &point);
+    void flushPendingPoints();
+
     void getFrames(int channelCount, sv_frame_t startFrame, sv_frame_t size,
                    float **buffer);
 
@@ -102,6 +102,7 @@ public:
     Models detachOutputModels() {
         awaitOutputModels();
         m_detached = true; 
+        for (Model *m : m_outputs) Model::registerModel(m);
         return m_outputs;
     }
 
@@ -127,7 +128,9 @@ public:
      */
     virtual Models detachAdditionalOutputModels() { 
         m_detachedAdd = true;
-        return getAdditionalOutputModels();
+        Models models = getAdditionalOutputModels();
+        for (Model *m : models) Model::registerModel(m);
+        return models;
     }
 
     /**